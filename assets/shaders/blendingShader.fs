@@ -1,11 +1,32 @@
 #version 330 core
 
+#ifdef WEIGHTED_BLENDED
+/* Weighted blended order-independent transparency (McGuire and Bavoil):
+ * both targets are summed up, so the order surfaces are drawn in doesn't
+ * matter, and `transparencyComposite.fs` resolves them over the scene. */
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+
+in float fragViewDepth;
+#else
 out vec4 FragColor;
+#endif
 
 in vec2 fragTexCoord;
 
 uniform sampler2D texture0;
 
 void main() {
-  FragColor = texture(texture0, fragTexCoord);
+  vec4 color = texture(texture0, fragTexCoord);
+#ifdef WEIGHTED_BLENDED
+  /* Nearer and more opaque surfaces dominate the average color. */
+  float weight = color.a * clamp(0.03 / (1e-5 + pow(fragViewDepth / 200.0, 4.0)), 1e-2, 3e3);
+  accumulation = vec4(color.rgb * color.a, color.a) * weight;
+  /* How much of the scene shows through is the product of every surface's
+   * 1 - alpha. Only additive blending works for both targets at once, so it
+   * is summed as logarithms and the composite takes the exponential. */
+  revealage = -log(1.0 - min(color.a, 0.999));
+#else
+  FragColor = color;
+#endif
 }
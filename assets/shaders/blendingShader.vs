@@ -4,12 +4,26 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 
 out vec2 fragTexCoord;
+#ifdef WEIGHTED_BLENDED
+out float fragViewDepth;
+#endif
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "common/FrameData.glsl"
+#ifdef INSTANCED
+#include "common/InstanceTransform.glsl"
+#else
+#include "common/ObjectData.glsl"
+#endif
 
 void main() {
-  gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+#ifdef INSTANCED
+  vec4 worldPos = vec4(instanceTransform(aPos), 1.0);
+#else
+  vec4 worldPos = modelMatrix * vec4(aPos, 1.0);
+#endif
+  gl_Position = viewProjectionMatrix * worldPos;
   fragTexCoord = aTexCoord;
+#ifdef WEIGHTED_BLENDED
+  fragViewDepth = -(viewMatrix * worldPos).z;
+#endif
 }
@@ -0,0 +1,45 @@
+/* Shading with the lights `LightGrid` assigned to the fragment's cluster.
+ * The block must match `LightGridData` in src/UniformBlocks.h, and the
+ * samplers are bound by `ShaderProgram::create`. */
+
+#include "FrameData.glsl"
+
+layout (std140) uniform LightGrid {
+  vec2 tileScale;
+  float sliceScale;
+  float sliceBias;
+  uvec3 clusterCount;
+  uint lightCount;
+};
+
+/* Two texels per light: position and radius, then color and intensity. */
+uniform samplerBuffer lightData;
+/* Per cluster: where its list starts in `lightIndices`, and its length. */
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+
+/* Diffuse light arriving at a surface from the cluster's lights. */
+vec3 clusteredLighting(vec3 worldPosition, vec3 normal) {
+  float depth = -(viewMatrix * vec4(worldPosition, 1.0)).z;
+  uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * tileScale), uint(max(log(depth) * sliceScale - sliceBias, 0.0)));
+  cluster = min(cluster, clusterCount - 1u);
+  int clusterIndex = int(cluster.x + clusterCount.x * (cluster.y + clusterCount.y * cluster.z));
+  uvec2 range = texelFetch(lightClusters, clusterIndex).xy;
+
+  vec3 light = vec3(0.0);
+  for (uint i = 0u; i < range.y; ++i) {
+    int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+    vec4 positionRadius = texelFetch(lightData, 2 * index);
+    vec4 colorIntensity = texelFetch(lightData, 2 * index + 1);
+
+    vec3 toLight = positionRadius.xyz - worldPosition;
+    float distanceSquared = dot(toLight, toLight);
+    /* Inverse square, windowed to reach zero at the radius so that lights
+     * end where their clusters do. */
+    float window = clamp(1.0 - pow(distanceSquared / (positionRadius.w * positionRadius.w), 2.0), 0.0, 1.0);
+    float attenuation = window * window / (distanceSquared + 1.0);
+    float lambert = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+    light += colorIntensity.rgb * colorIntensity.a * attenuation * lambert;
+  }
+  return light;
+}
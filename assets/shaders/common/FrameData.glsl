@@ -0,0 +1,9 @@
+/* Camera data shared by every program, uploaded once per frame. Must match
+ * `FrameData` in src/UniformBlocks.h. */
+layout (std140) uniform FrameData {
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  mat4 viewProjectionMatrix;
+  vec3 cameraPosition;
+  float time;
+};
@@ -0,0 +1,14 @@
+/* Per-instance placement, an `InstanceTRS` after a vertex of two fields (see
+ * `Mesh::setInstances`): translation and uniform scale, then a unit
+ * quaternion. */
+layout (location = 2) in vec4 aTranslationScale;
+layout (location = 3) in vec4 aRotation;
+
+vec3 rotate(vec4 q, vec3 v) {
+  return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+/* Where a vertex of the instance ends up in the world. */
+vec3 instanceTransform(vec3 position) {
+  return rotate(aRotation, position * aTranslationScale.w) + aTranslationScale.xyz;
+}
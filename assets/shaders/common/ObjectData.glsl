@@ -0,0 +1,6 @@
+/* Per-draw data, bound as a range of one buffer shared by the whole queue.
+ * Must match `ObjectData` in src/UniformBlocks.h. */
+layout (std140) uniform ObjectData {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+};
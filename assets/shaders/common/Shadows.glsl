@@ -0,0 +1,53 @@
+/* Light from the directional light of `CascadedShadowMap`, shadowed. The
+ * block must match `ShadowData` in src/UniformBlocks.h, and the sampler is
+ * bound by `ShaderProgram::create`. */
+
+#include "FrameData.glsl"
+
+layout (std140) uniform ShadowData {
+  mat4 shadowMatrices[4];
+  vec4 splitDepths;
+  vec4 texelSizes;
+  vec3 lightDirection;
+  uint cascadeCount;
+  vec3 lightColor;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+/* 1 where the light reaches `worldPosition`, 0 where it is blocked. */
+float shadowFactor(vec3 worldPosition, vec3 normal) {
+  float depth = -(viewMatrix * vec4(worldPosition, 1.0)).z;
+  int cascade = 0;
+  while (cascade < int(cascadeCount) && depth > splitDepths[cascade]) {
+    ++cascade;
+  }
+  if (cascade == int(cascadeCount)) {
+    return 1.0;
+  }
+
+  /* Looked up a little off the surface, so that it doesn't shadow itself
+   * where it slopes away from the light. */
+  vec3 position = worldPosition + normal * (1.5 * texelSizes[cascade]);
+  vec3 coords = (shadowMatrices[cascade] * vec4(position, 1.0)).xyz;
+
+  /* Four bilinear taps a texel apart, filtering a 3x3 footprint. */
+  vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+  float lit = 0.0;
+  for (int y = 0; y < 2; ++y) {
+    for (int x = 0; x < 2; ++x) {
+      vec2 offset = (vec2(x, y) - 0.5) * texel;
+      lit += texture(shadowMap, vec4(coords.xy + offset, float(cascade), coords.z));
+    }
+  }
+  return 0.25 * lit;
+}
+
+/* Diffuse light arriving at a surface from the directional light. */
+vec3 directionalLighting(vec3 worldPosition, vec3 normal) {
+  float lambert = max(dot(normal, -lightDirection), 0.0);
+  if (lambert == 0.0) {
+    return vec3(0.0);
+  }
+  return lightColor * lambert * shadowFactor(worldPosition, normal);
+}
@@ -47,9 +47,11 @@ struct Material {
   float shininess;
 };
 
-uniform vec3 viewPos;
+#include "common/FrameData.glsl"
 
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 4
+#endif
 
 uniform DirectionalLight directionalLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
@@ -95,7 +97,7 @@ vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDir) {
 
 void main() {
   vec3 normal = normalize(fragNormal);
-  vec3 viewDir = normalize(viewPos - fragPos);
+  vec3 viewDir = normalize(cameraPosition - fragPos);
 
   vec3 result = calcDirectionalLight(directionalLight, normal, viewDir);
   for (int i = 0; i < NR_POINT_LIGHTS; i++) {
@@ -8,15 +8,12 @@ out vec3 fragPos;
 out vec3 fragNormal;
 out vec2 fragTexCoord;
 
-uniform mat3 normalMatrix;
-
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "common/FrameData.glsl"
+#include "common/ObjectData.glsl"
 
 void main() {
-  gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+  gl_Position = viewProjectionMatrix * modelMatrix * vec4(aPos, 1.0);
   fragPos = vec3(modelMatrix * vec4(aPos, 1.0));
-  fragNormal = normalMatrix * aNormal;
+  fragNormal = mat3(normalMatrix) * aNormal;
   fragTexCoord = aTexCoord;
 }
@@ -6,6 +6,35 @@ in vec2 fragTexCoord;
 
 uniform sampler2D texture0;
 
+/* The lighting below needs it too, but a file is only expanded where it is
+ * first included, which may be inside a disabled `#ifdef`. */
+#include "common/FrameData.glsl"
+
+#ifdef CLUSTERED_LIGHTING
+#include "common/ClusteredLighting.glsl"
+#endif
+#ifdef SHADOWS
+#include "common/Shadows.glsl"
+#endif
+
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+in vec3 fragWorldPosition;
+
+const float AMBIENT = 0.15;
+#endif
+
 void main() {
   FragColor = texture(texture0, fragTexCoord);
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+  /* The meshes drawn with this have no normals, so take the face's. */
+  vec3 normal = normalize(cross(dFdx(fragWorldPosition), dFdy(fragWorldPosition)));
+  vec3 light = vec3(AMBIENT);
+#ifdef CLUSTERED_LIGHTING
+  light += clusteredLighting(fragWorldPosition, normal);
+#endif
+#ifdef SHADOWS
+  light += directionalLighting(fragWorldPosition, normal);
+#endif
+  FragColor.rgb *= light;
+#endif
 }
@@ -4,12 +4,18 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 
 out vec2 fragTexCoord;
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+out vec3 fragWorldPosition;
+#endif
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "common/FrameData.glsl"
+#include "common/ObjectData.glsl"
 
 void main() {
-  gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+  vec4 worldPosition = modelMatrix * vec4(aPos, 1.0);
+  gl_Position = viewProjectionMatrix * worldPosition;
   fragTexCoord = aTexCoord;
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+  fragWorldPosition = worldPosition.xyz;
+#endif
 }
@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 fragTexCoord;
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+out vec3 fragWorldPosition;
+#endif
+
+#include "common/FrameData.glsl"
+#include "common/InstanceTransform.glsl"
+
+void main() {
+  vec3 worldPos = instanceTransform(aPos);
+  gl_Position = viewProjectionMatrix * vec4(worldPos, 1.0);
+  fragTexCoord = aTexCoord;
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+  fragWorldPosition = worldPos;
+#endif
+}
@@ -10,10 +10,40 @@ struct Material {
 
 uniform Material material;
 
+/* The lighting below needs it too, but a file is only expanded where it is
+ * first included, which may be inside a disabled `#ifdef`. */
+#include "common/FrameData.glsl"
+
+#ifdef CLUSTERED_LIGHTING
+#include "common/ClusteredLighting.glsl"
+#endif
+#ifdef SHADOWS
+#include "common/Shadows.glsl"
+#endif
+
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+in vec3 fragWorldPosition;
+
+const float AMBIENT = 0.15;
+#endif
+
 void main() {
   vec4 texColor = texture(material.diffuse0, fragTexCoord);
   if (texColor.a < 0.1) {
     discard;
   }
   FragColor = texColor;
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+  /* Blades are lit like the ground they cover, which hides that they are
+   * flat cards. */
+  vec3 normal = vec3(0.0, 1.0, 0.0);
+  vec3 light = vec3(AMBIENT);
+#ifdef CLUSTERED_LIGHTING
+  light += clusteredLighting(fragWorldPosition, normal);
+#endif
+#ifdef SHADOWS
+  light += directionalLighting(fragWorldPosition, normal);
+#endif
+  FragColor.rgb *= light;
+#endif
 }
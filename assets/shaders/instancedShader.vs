@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+/* Per instance; occupies locations 2 to 5. */
+layout (location = 2) in mat4 aModelMatrix;
+
+out vec2 fragTexCoord;
+
+#include "common/FrameData.glsl"
+
+void main() {
+  gl_Position = viewProjectionMatrix * aModelMatrix * vec4(aPos, 1.0);
+  fragTexCoord = aTexCoord;
+}
@@ -6,11 +6,10 @@ layout (location = 2) in vec2 aTexCoord;
 
 out vec2 fragTexCoord;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "common/FrameData.glsl"
+#include "common/ObjectData.glsl"
 
 void main() {
-  gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+  gl_Position = viewProjectionMatrix * modelMatrix * vec4(aPos, 1.0);
   fragTexCoord = aTexCoord;
 }
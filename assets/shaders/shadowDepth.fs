@@ -0,0 +1,22 @@
+#version 330 core
+
+/* Only depth is written. Cut-out materials discard where they are
+ * transparent, as they do when shaded. */
+
+#ifdef ALPHA_TEST
+in vec2 fragTexCoord;
+
+struct Material {
+  sampler2D diffuse0;
+};
+
+uniform Material material;
+#endif
+
+void main() {
+#ifdef ALPHA_TEST
+  if (texture(material.diffuse0, fragTexCoord).a < 0.1) {
+    discard;
+  }
+#endif
+}
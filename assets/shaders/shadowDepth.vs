@@ -0,0 +1,32 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+#ifdef ALPHA_TEST
+out vec2 fragTexCoord;
+#endif
+
+#ifdef INSTANCED
+#include "common/InstanceTransform.glsl"
+#else
+#include "common/ObjectData.glsl"
+#endif
+
+/* The cascade being drawn. Must match `ShadowCascadeData` in
+ * src/UniformBlocks.h. */
+layout (std140) uniform ShadowCascade {
+  mat4 lightViewProjectionMatrix;
+};
+
+void main() {
+#ifdef INSTANCED
+  vec3 worldPosition = instanceTransform(aPos);
+#else
+  vec3 worldPosition = (modelMatrix * vec4(aPos, 1.0)).xyz;
+#endif
+  gl_Position = lightViewProjectionMatrix * vec4(worldPosition, 1.0);
+#ifdef ALPHA_TEST
+  fragTexCoord = aTexCoord;
+#endif
+}
@@ -4,8 +4,7 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 fragTexCoord;
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+#include "common/FrameData.glsl"
 
 void main() {
   /* We want the skybox to be centered around the player so that no matter how
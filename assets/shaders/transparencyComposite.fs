@@ -0,0 +1,20 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 fragTexCoord;
+
+uniform sampler2D sceneTexture;
+uniform sampler2D accumulationTexture;
+uniform sampler2D revealageTexture;
+
+/* Resolves the sums `blendingShader.fs` accumulates with `WEIGHTED_BLENDED`
+ * over the opaque scene. */
+void main() {
+  vec3 scene = texture(sceneTexture, fragTexCoord).rgb;
+  vec4 accumulation = texture(accumulationTexture, fragTexCoord);
+  float revealage = exp(-texture(revealageTexture, fragTexCoord).r);
+
+  vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+  FragColor = vec4(mix(average, scene, revealage), 1.0);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+/* Runs `f` `runs` times and returns the fastest run, in milliseconds. */
+template <typename F>
+double bestOf(int runs, F&& f) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
@@ -0,0 +1,57 @@
+/* Measures frustum culling throughput on one million random boxes, comparing
+ * the SIMD kernel against the one-box-at-a-time reference.
+ *
+ * Usage: culling_benchmark [box count] */
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchUtil.h"
+#include "FrustumCuller.h"
+
+int main(int argc, char* argv[]) {
+  size_t boxCount = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1000000;
+
+  /* Boxes scattered around the camera, so that roughly a fifth are visible. */
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+  std::uniform_real_distribution<float> size(0.1f, 4.0f);
+  BoundingBoxList boxes;
+  for (size_t i = 0; i < boxCount; ++i) {
+    glm::vec3 center(position(random), position(random) * 0.1f, position(random));
+    glm::vec3 extents(size(random), size(random), size(random));
+    boxes.add({ center - extents, center + extents });
+  }
+
+  glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum = Frustum::fromMatrix(projection * view);
+
+  std::vector<uint32_t> visible, visibleScalar;
+  visible.reserve(boxCount);
+  visibleScalar.reserve(boxCount);
+
+  double scalarTime = bestOf(10, [&](void) {
+    visibleScalar.clear();
+    FrustumCuller::cullScalar(frustum, boxes, visibleScalar);
+  });
+  double simdTime = bestOf(10, [&](void) {
+    visible.clear();
+    FrustumCuller::cull(frustum, boxes, visible);
+  });
+
+  if (visible != visibleScalar) {
+    std::cerr << "SIMD and scalar culling disagree" << std::endl;
+    return 1;
+  }
+
+  std::cout << boxCount << " boxes, " << visible.size() << " visible" << std::endl;
+  std::cout << "scalar: " << scalarTime << " ms" << std::endl;
+  std::cout << "SIMD:   " << simdTime << " ms (" << scalarTime / simdTime << "x)" << std::endl;
+  return 0;
+}
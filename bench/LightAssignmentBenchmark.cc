@@ -0,0 +1,143 @@
+/* Measures clustered light assignment for 1k to 10k lights moving through a
+ * scene, on the calling thread alone and with the default number of
+ * workers. Also checks that every light reaching a sample point is in the
+ * list of the point's cluster, as the shaders rely on.
+ *
+ * Usage: light_assignment_benchmark [frames per light count] */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "LightGrid.h"
+#include "ThreadPool.h"
+
+namespace {
+
+constexpr float NEAR_PLANE = 0.1f;
+constexpr float FAR_PLANE = 100.0f;
+
+struct Timing {
+  double mean;
+  double best;
+};
+
+/* Lights orbiting in a field around the camera, advanced one step per
+ * frame. */
+void moveLights(std::vector<PointLight>& lights, const std::vector<glm::vec4>& orbits, float time) {
+  for (size_t i = 0; i < lights.size(); ++i) {
+    float angle = orbits[i].w + time;
+    lights[i].position = glm::vec3(orbits[i]) + 2.0f * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+  }
+}
+
+Timing measure(LightGrid& grid, std::vector<PointLight>& lights, const std::vector<glm::vec4>& orbits,
+               const glm::mat4& view, const glm::mat4& projection, int frames) {
+  double total = 0.0, best = 1e30;
+  for (int frame = 0; frame < frames; ++frame) {
+    moveLights(lights, orbits, frame / 60.0f);
+    auto start = std::chrono::steady_clock::now();
+    grid.assign(lights, view, projection, NEAR_PLANE, FAR_PLANE);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    total += elapsed.count();
+    best = std::min(best, elapsed.count());
+  }
+  return { total / frames, best };
+}
+
+/* Samples points in the frustum and returns how many lights reaching one
+ * are missing from its cluster's list. */
+size_t countMissingLights(const LightGrid& grid, const std::vector<PointLight>& lights, const glm::mat4& view,
+                          const glm::mat4& projection) {
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> ndc(-0.999f, 0.999f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  glm::mat4 inverseView = glm::inverse(view);
+  size_t missing = 0;
+  for (int sample = 0; sample < 20000; ++sample) {
+    float x = ndc(random), y = ndc(random);
+    /* Spread evenly over the slices, like the grid itself. */
+    float depth = NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, unit(random) * 0.999f);
+    glm::vec3 viewPosition(x * depth / projection[0][0], y * depth / projection[1][1], -depth);
+    glm::vec3 worldPosition = glm::vec3(inverseView * glm::vec4(viewPosition, 1.0f));
+
+    uint32_t tileX = static_cast<uint32_t>((x * 0.5f + 0.5f) * LightGrid::CLUSTERS_X);
+    uint32_t tileY = static_cast<uint32_t>((y * 0.5f + 0.5f) * LightGrid::CLUSTERS_Y);
+    uint32_t slice = static_cast<uint32_t>(std::log(depth / NEAR_PLANE) * LightGrid::CLUSTERS_Z / std::log(FAR_PLANE / NEAR_PLANE));
+    uint32_t cluster = tileX + LightGrid::CLUSTERS_X * (tileY + LightGrid::CLUSTERS_Y * slice);
+    const uint16_t* clusterLights = grid.getClusterLights(cluster);
+    const uint16_t* clusterEnd = clusterLights + grid.getClusterLightCount(cluster);
+
+    for (size_t i = 0; i < lights.size(); ++i) {
+      if (glm::length(lights[i].position - worldPosition) < lights[i].radius
+          && std::find(clusterLights, clusterEnd, static_cast<uint16_t>(i)) == clusterEnd) {
+        ++missing;
+      }
+    }
+  }
+  return missing;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? std::atoi(argv[1]) : 100;
+  if (frames <= 0) {
+    std::cerr << "Usage: light_assignment_benchmark [frames per light count]" << std::endl;
+    return 1;
+  }
+
+  glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, NEAR_PLANE, FAR_PLANE);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 0.0f), glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  LightGrid serialGrid(0);
+  LightGrid parallelGrid;
+  std::cout << "Clusters: " << LightGrid::CLUSTERS_X << "x" << LightGrid::CLUSTERS_Y << "x" << LightGrid::CLUSTERS_Z
+            << ", workers: " << ThreadPool::defaultThreadCount() << std::endl;
+
+  for (size_t lightCount : { 1000, 2000, 5000, 10000 }) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<PointLight> lights(lightCount);
+    std::vector<glm::vec4> orbits(lightCount);
+    for (size_t i = 0; i < lightCount; ++i) {
+      orbits[i] = glm::vec4(position(random), 4.0f * unit(random), position(random), glm::two_pi<float>() * unit(random));
+      lights[i] = { glm::vec3(0.0f), 1.0f + 3.0f * unit(random), glm::vec3(1.0f), 1.0f };
+    }
+
+    Timing serial = measure(serialGrid, lights, orbits, view, projection, frames);
+    Timing parallel = measure(parallelGrid, lights, orbits, view, projection, frames);
+
+    for (uint32_t cluster = 0; cluster < LightGrid::CLUSTER_COUNT; ++cluster) {
+      size_t count = serialGrid.getClusterLightCount(cluster);
+      if (count != parallelGrid.getClusterLightCount(cluster)
+          || !std::equal(serialGrid.getClusterLights(cluster), serialGrid.getClusterLights(cluster) + count,
+                         parallelGrid.getClusterLights(cluster))) {
+        std::cerr << "Serial and parallel assignment disagree" << std::endl;
+        return 1;
+      }
+    }
+    size_t missing = countMissingLights(parallelGrid, lights, view, projection);
+    if (missing > 0) {
+      std::cerr << missing << " lights missing from the clusters they reach" << std::endl;
+      return 1;
+    }
+
+    const LightGrid::Statistics& statistics = parallelGrid.getStatistics();
+    std::cout << lightCount << " lights, " << statistics.visibleLights << " visible, " << statistics.lightIndices
+              << " list entries" << std::endl;
+    std::cout << "  serial:   " << serial.mean << " ms mean, " << serial.best << " ms best" << std::endl;
+    std::cout << "  parallel: " << parallel.mean << " ms mean, " << parallel.best << " ms best ("
+              << serial.mean / parallel.mean << "x)" << std::endl;
+  }
+  return 0;
+}
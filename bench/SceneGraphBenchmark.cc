@@ -0,0 +1,239 @@
+/* Measures a frame of a large, mostly static scene: a few nodes move, world
+ * transforms are brought up to date, and the scene is culled and picked.
+ * Compares the scene graph, which only touches dirty subtrees and walks its
+ * bounding volume hierarchy, against recomputing every node and testing
+ * every box. Also times enqueueing the visible nodes with levels of detail,
+ * and checks the levels `LodSelector` picks as an object moves away from the
+ * camera and back.
+ *
+ * Usage: scene_graph_benchmark [node count] [moving nodes per frame] */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchUtil.h"
+#include "Camera.h"
+#include "FrustumCuller.h"
+#include "LodSelector.h"
+#include "SceneGraph.h"
+
+namespace {
+
+/* Each level may be off by four times as much as the one before, so a unit
+ * box at 1080p drops a level every four times farther out, from a few units
+ * away to a few dozen. */
+constexpr uint32_t LOD_COUNT = 4;
+const int lodMeshes[LOD_COUNT] = {};
+const LodLevel lodLevels[LOD_COUNT] = {
+  { &lodMeshes[0], 0.0f, 12 },
+  { &lodMeshes[1], 0.002f, 6 },
+  { &lodMeshes[2], 0.008f, 4 },
+  { &lodMeshes[3], 0.032f, 2 },
+};
+
+void drawNothing(const void* object, const ShaderProgram& shaderProgram) {
+  (void)object;
+  (void)shaderProgram;
+}
+
+/* Walks an object from right in front of the camera out to the far plane
+ * and back. Its level must only get coarser on the way out and finer on the
+ * way back, go through every level, and, for the hysteresis, switch back
+ * closer than it switched out. */
+bool checkLodSweep(const LodSelector& lodSelector) {
+  constexpr int STEPS = 3000;
+  float switchOut[LOD_COUNT] = {}, switchIn[LOD_COUNT] = {};
+  uint32_t level = 0;
+  for (int step = 0; step <= 2 * STEPS; ++step) {
+    bool outward = step <= STEPS;
+    float distance = 0.5f + 300.0f * (outward ? step : 2 * STEPS - step) / STEPS;
+    uint32_t next = lodSelector.select(lodLevels, LOD_COUNT, distance, 1.0f, level);
+    if (outward ? next < level : next > level) {
+      std::cerr << "Level of detail went " << (outward ? "finer" : "coarser") << " at distance " << distance << std::endl;
+      return false;
+    }
+    for (uint32_t k = level + 1; k <= next; ++k) {
+      switchOut[k] = distance;
+    }
+    for (uint32_t k = next + 1; k <= level; ++k) {
+      switchIn[k] = distance;
+    }
+    level = next;
+    if (step == STEPS && level != LOD_COUNT - 1) {
+      std::cerr << "Level of detail " << level << " at the far plane" << std::endl;
+      return false;
+    }
+  }
+  if (level != 0) {
+    std::cerr << "Level of detail " << level << " back in front of the camera" << std::endl;
+    return false;
+  }
+
+  std::cout << "LOD switches (out/in):";
+  for (uint32_t k = 1; k < LOD_COUNT; ++k) {
+    if (switchIn[k] >= switchOut[k]) {
+      std::cerr << "Level of detail " << k << " switches back no closer than it switched out" << std::endl;
+      return false;
+    }
+    std::cout << " " << switchOut[k] << "/" << switchIn[k];
+  }
+  std::cout << std::endl;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t nodeCount = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 100000;
+  size_t movingCount = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 16;
+
+  /* Groups of 100 nodes: a root scattered around the camera, each with
+   * bounded children around it. */
+  constexpr size_t GROUP_SIZE = 100;
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+  std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+  const BoundingBox unitBox = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+  const SceneGraph::Drawable drawable = { RenderLayer::SOLID, nullptr, 0, drawNothing, &lodMeshes[0], lodLevels, LOD_COUNT, nullptr };
+
+  SceneGraph scene;
+  std::vector<SceneGraph::Node> leaves;
+  SceneGraph::Node group = SceneGraph::NO_NODE;
+  for (size_t i = 0; i < nodeCount; ++i) {
+    if (i % GROUP_SIZE == 0) {
+      glm::vec3 center(position(random), position(random) * 0.1f, position(random));
+      group = scene.addNode(SceneGraph::NO_NODE, glm::translate(glm::mat4(1.0f), center));
+    } else {
+      glm::vec3 local(offset(random), offset(random), offset(random));
+      leaves.push_back(scene.addNode(group, glm::translate(glm::mat4(1.0f), local), unitBox, drawable));
+    }
+  }
+  scene.update();
+
+  /* At the origin, looking down -z. */
+  Camera camera(glm::vec3(0.0f));
+  glm::mat4 projection = camera.getProjectionMatrix(16.0f / 9.0f, 0.1f, 300.0f);
+  glm::mat4 view = camera.getViewMatrix();
+  LodSelector lodSelector(camera.getFovy(), 1080.0f);
+  if (!checkLodSweep(lodSelector)) {
+    return 1;
+  }
+  Frustum frustum = Frustum::fromMatrix(projection * view);
+  const glm::vec3 rayOrigin(0.0f);
+  const glm::vec3 rayDirection(0.1f, -0.02f, -1.0f);
+
+  /* The flat alternative: every world matrix and box recomputed every frame,
+   * then every box tested. */
+  std::vector<SceneGraph::Node> parents(scene.size());
+  std::vector<glm::mat4> localTransforms(scene.size());
+  for (SceneGraph::Node node = 0; node < scene.size(); ++node) {
+    parents[node] = scene.getParent(node);
+    localTransforms[node] = scene.getLocalTransform(node);
+  }
+  std::vector<glm::mat4> worldTransforms(scene.size());
+  BoundingBoxList boxes;
+  std::vector<uint32_t> boxNodes;
+
+  auto move = [&](size_t frame) {
+    for (size_t i = 0; i < movingCount; ++i) {
+      SceneGraph::Node node = leaves[(frame * 7919 + i * 104729) % leaves.size()];
+      glm::mat4 transform = glm::translate(scene.getLocalTransform(node), glm::vec3(0.01f, 0.0f, 0.0f));
+      scene.setLocalTransform(node, transform);
+      localTransforms[node] = transform;
+    }
+  };
+
+  std::vector<uint32_t> visibleFlat, visibleScene;
+  float pickedFlat = 0.0f, pickedScene = 0.0f;
+
+  auto flatFrame = [&](void) {
+    boxes.clear();
+    boxNodes.clear();
+    for (SceneGraph::Node node = 0; node < parents.size(); ++node) {
+      SceneGraph::Node parent = parents[node];
+      worldTransforms[node] = parent == SceneGraph::NO_NODE ? localTransforms[node] : worldTransforms[parent] * localTransforms[node];
+      if (parent != SceneGraph::NO_NODE) {
+        boxes.add(transform(unitBox, worldTransforms[node]));
+        boxNodes.push_back(node);
+      }
+    }
+
+    visibleFlat.clear();
+    FrustumCuller::cull(frustum, boxes, visibleFlat);
+    for (uint32_t& index : visibleFlat) {
+      index = boxNodes[index];
+    }
+
+    pickedFlat = std::numeric_limits<float>::infinity();
+    glm::vec3 inverseDirection = 1.0f / rayDirection;
+    for (uint32_t node : boxNodes) {
+      BoundingBox box = transform(unitBox, worldTransforms[node]);
+      glm::vec3 t0 = (box.min - rayOrigin) * inverseDirection;
+      glm::vec3 t1 = (box.max - rayOrigin) * inverseDirection;
+      glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+      float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+      float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+      if (enter <= exit) {
+        pickedFlat = std::min(pickedFlat, enter);
+      }
+    }
+  };
+
+  auto sceneFrame = [&](void) {
+    scene.update();
+    visibleScene.clear();
+    scene.cull(frustum, visibleScene);
+    pickedScene = std::numeric_limits<float>::infinity();
+    scene.pick(rayOrigin, rayDirection, &pickedScene);
+  };
+
+  RenderQueue queue;
+  auto lodFrame = [&](void) {
+    scene.update();
+    queue.clear();
+    scene.enqueue(queue, frustum, view, lodSelector);
+  };
+
+  size_t frame = 0;
+  double flatTime = bestOf(20, [&](void) {
+    move(frame++);
+    flatFrame();
+  });
+  double sceneTime = bestOf(20, [&](void) {
+    move(frame++);
+    sceneFrame();
+  });
+  double lodTime = bestOf(20, [&](void) {
+    move(frame++);
+    lodFrame();
+  });
+
+  /* `move` changes both copies of the transforms, so a final frame of each
+   * must agree. */
+  flatFrame();
+  sceneFrame();
+  std::sort(visibleFlat.begin(), visibleFlat.end());
+  std::sort(visibleScene.begin(), visibleScene.end());
+  if (visibleFlat != visibleScene || pickedFlat != pickedScene) {
+    std::cerr << "Scene graph and flat results disagree" << std::endl;
+    return 1;
+  }
+  lodFrame();
+  if (queue.size() != visibleScene.size()) {
+    std::cerr << "Enqueued " << queue.size() << " of " << visibleScene.size() << " visible nodes" << std::endl;
+    return 1;
+  }
+
+  std::cout << scene.size() << " nodes, " << movingCount << " moving, " << visibleScene.size() << " visible" << std::endl;
+  std::cout << "flat:        " << flatTime << " ms per frame" << std::endl;
+  std::cout << "scene graph: " << sceneTime << " ms per frame (" << flatTime / sceneTime << "x)" << std::endl;
+  std::cout << "enqueue:     " << lodTime << " ms per frame, with level of detail selection" << std::endl;
+  return 0;
+}
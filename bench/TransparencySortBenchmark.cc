@@ -0,0 +1,142 @@
+/* Measures back-to-front sorting of 100k transparent quads as the camera
+ * moves: incrementally, from the last frame's order, and with a radix sort
+ * from scratch every frame. The camera walks straight through the field,
+ * then walks while turning, then teleports every frame. With this many quads
+ * even a slow turn moves each one several places, enough for the
+ * incremental sort to fall back to the radix sort. Checks that every frame
+ * comes out back to front.
+ *
+ * Usage: transparency_sort_benchmark [frames] [quads] */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TransparentInstances.h"
+
+namespace {
+
+constexpr float FIELD_SIZE = 200.0f;
+
+enum class Motion { WALKING, TURNING, TELEPORTING };
+
+struct Timing {
+  double mean;
+  double best;
+  size_t fullSorts;
+};
+
+/* At 60 frames a second, walking at 3 m/s. */
+glm::mat4 cameraView(int frame, Motion motion) {
+  float time = frame / 60.0f;
+  float yaw = 0.0f;
+  glm::vec3 position(0.0f, 2.0f, 60.0f - 3.0f * time);
+  switch (motion) {
+  case Motion::WALKING:
+    break;
+  case Motion::TURNING:
+    yaw = 0.5f * time;
+    break;
+  case Motion::TELEPORTING:
+    yaw = frame * 2.39f;
+    position = glm::vec3(std::fmod(frame * 37.1f, FIELD_SIZE) - 0.5f * FIELD_SIZE, 2.0f,
+                         std::fmod(frame * 71.3f, FIELD_SIZE) - 0.5f * FIELD_SIZE);
+    break;
+  }
+  glm::vec3 forward(-std::sin(yaw), -0.1f, -std::cos(yaw));
+  return glm::lookAt(position, position + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+bool isBackToFront(const std::vector<InstanceTRS>& sorted, const glm::mat4& view) {
+  float previous = INFINITY;
+  for (const auto& instance : sorted) {
+    float depth = std::max(-(view * glm::vec4(glm::vec3(instance.translationScale), 1.0f)).z, 0.0f);
+    if (depth > previous) {
+      return false;
+    }
+    previous = depth;
+  }
+  return true;
+}
+
+/* The first frame is left out, as it sorts from the order the instances
+ * were added in. */
+bool measure(TransparentInstances& instances, bool incremental, Motion motion, int frames, Timing& timing) {
+  double total = 0.0;
+  timing = { 0.0, 1e30, 0 };
+  for (int frame = 0; frame <= frames; ++frame) {
+    glm::mat4 view = cameraView(frame, motion);
+    if (incremental) {
+      instances.sort(view);
+    } else {
+      instances.sortFromScratch(view);
+    }
+
+    if (!isBackToFront(instances.getInstances(), view)) {
+      std::cerr << "Frame " << frame << " is not sorted back to front" << std::endl;
+      return false;
+    }
+    if (frame == 0) {
+      continue;
+    }
+
+    const TransparentInstances::Statistics& statistics = instances.getStatistics();
+    total += statistics.sortTime;
+    timing.best = std::min(timing.best, statistics.sortTime);
+    timing.fullSorts += statistics.fullSort ? 1 : 0;
+  }
+  timing.mean = total / frames;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+  int quadCount = argc > 2 ? std::atoi(argv[2]) : 100000;
+  if (frames <= 0 || quadCount <= 0) {
+    std::cerr << "Usage: transparency_sort_benchmark [frames] [quads]" << std::endl;
+    return 1;
+  }
+
+  /* Every run sorts the same quads. */
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-0.5f * FIELD_SIZE, 0.5f * FIELD_SIZE);
+  std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+  std::vector<InstanceTRS> quads(quadCount);
+  for (auto& quad : quads) {
+    float yaw = angle(random);
+    quad = { glm::vec4(position(random), 1.0f, position(random), 1.0f),
+             glm::vec4(0.0f, std::sin(0.5f * yaw), 0.0f, std::cos(0.5f * yaw)) };
+  }
+  std::cout << quadCount << " quads, " << frames << " frames" << std::endl;
+
+  const char* motionNames[] = { "Walking", "Turning", "Teleporting" };
+  for (Motion motion : { Motion::WALKING, Motion::TURNING, Motion::TELEPORTING }) {
+    Timing timings[2];
+    for (bool incremental : { false, true }) {
+      TransparentInstances instances;
+      for (const auto& quad : quads) {
+        instances.add(quad);
+      }
+      if (!measure(instances, incremental, motion, frames, timings[incremental])) {
+        return 1;
+      }
+    }
+
+    const Timing& scratch = timings[0];
+    const Timing& incremental = timings[1];
+    std::cout << motionNames[static_cast<int>(motion)] << std::endl;
+    std::cout << "  radix sort:  " << scratch.mean << " ms mean, " << scratch.best << " ms best" << std::endl;
+    std::cout << "  incremental: " << incremental.mean << " ms mean, " << incremental.best << " ms best ("
+              << scratch.mean / incremental.mean << "x), " << incremental.fullSorts << " radix fallbacks" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* Measures finding the location of a uniform the way a draw does, for the
+ * uniforms of the lit cube shader. Compares the former string-keyed cache,
+ * which builds a `std::string` from the literal and hashes it on every call,
+ * against the uniform table probed with a precomputed hash, and against a
+ * handle kept from an earlier lookup.
+ *
+ * Usage: uniform_lookup_benchmark [lookups] */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "UniformTable.h"
+
+/* What `glGetActiveUniform` reports for cubeShader, less the blocks. */
+static const char* const UNIFORM_NAMES[] = {
+  "directionalLight.direction", "directionalLight.ambient", "directionalLight.diffuse", "directionalLight.specular",
+  "pointLights[0].position", "pointLights[0].ambient", "pointLights[0].diffuse", "pointLights[0].specular",
+  "pointLights[0].constant", "pointLights[0].linear", "pointLights[0].quadratic",
+  "pointLights[1].position", "pointLights[1].ambient", "pointLights[1].diffuse", "pointLights[1].specular",
+  "pointLights[1].constant", "pointLights[1].linear", "pointLights[1].quadratic",
+  "pointLights[2].position", "pointLights[2].ambient", "pointLights[2].diffuse", "pointLights[2].specular",
+  "pointLights[2].constant", "pointLights[2].linear", "pointLights[2].quadratic",
+  "pointLights[3].position", "pointLights[3].ambient", "pointLights[3].diffuse", "pointLights[3].specular",
+  "pointLights[3].constant", "pointLights[3].linear", "pointLights[3].quadratic",
+  "spotLight.position", "spotLight.direction", "spotLight.cutOff", "spotLight.outerCutOff",
+  "material.diffuse", "material.specular", "material.shininess",
+};
+
+int main(int argc, char* argv[]) {
+  size_t lookupCount = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 10000000;
+
+  std::unordered_map<std::string, GLint> locationCache;
+  UniformTable table;
+  GLint location = 0;
+  for (const char* name : UNIFORM_NAMES) {
+    locationCache[name] = location;
+    table.add(name, location, GL_FLOAT);
+    ++location;
+  }
+
+  /* A draw sets a handful of these, by literal. */
+  constexpr UniformName SPECULAR = "material.specular";
+  constexpr UniformName SHININESS = "material.shininess";
+  constexpr UniformName CUT_OFF = "spotLight.cutOff";
+  constexpr UniformName QUADRATIC = "pointLights[3].quadratic";
+  UniformHandle<GLfloat> handles[] = { table.find<GLfloat>(SPECULAR), table.find<GLfloat>(SHININESS),
+                                       table.find<GLfloat>(CUT_OFF), table.find<GLfloat>(QUADRATIC) };
+
+  const size_t rounds = lookupCount / 4;
+  long long stringSum = 0, nameSum = 0, handleSum = 0;
+
+  double stringTime = bestOf(5, [&](void) {
+    auto find = [&](const std::string& name) { return locationCache.find(name)->second; };
+    stringSum = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+      stringSum += find("material.specular") + find("material.shininess") + find("spotLight.cutOff") + find("pointLights[3].quadratic");
+    }
+  });
+  double nameTime = bestOf(5, [&](void) {
+    auto find = [&](UniformName name) { return table.getLocation(table.find<GLfloat>(name)); };
+    nameSum = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+      nameSum += find(SPECULAR) + find(SHININESS) + find(CUT_OFF) + find(QUADRATIC);
+    }
+  });
+  double handleTime = bestOf(5, [&](void) {
+    handleSum = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+      for (UniformHandle<GLfloat> handle : handles) {
+        handleSum += table.getLocation(handle);
+      }
+    }
+  });
+
+  if (stringSum != nameSum || nameSum != handleSum) {
+    std::cerr << "Lookups disagree" << std::endl;
+    return 1;
+  }
+
+  double lookups = static_cast<double>(rounds * 4);
+  std::cout << rounds * 4 << " lookups among " << table.size() << " uniforms" << std::endl;
+  std::cout << "string cache: " << stringTime * 1e6 / lookups << " ns per lookup" << std::endl;
+  std::cout << "hashed name:  " << nameTime * 1e6 / lookups << " ns per lookup (" << stringTime / nameTime << "x)" << std::endl;
+  std::cout << "handle:       " << handleTime * 1e6 / lookups << " ns per lookup (" << stringTime / handleTime << "x)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,264 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+uint16_t packRGB565(const float rgb[3]) {
+  int r = static_cast<int>(std::lround(std::clamp(rgb[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+  int g = static_cast<int>(std::lround(std::clamp(rgb[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+  int b = static_cast<int>(std::lround(std::clamp(rgb[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t color, int rgb[3]) {
+  int r = (color >> 11) & 31;
+  int g = (color >> 5) & 63;
+  int b = color & 31;
+  /* Replicate the high bits into the low ones, like the hardware does. */
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+/* Fits the two endpoints along the principal axis of the block's colours,
+ * then picks the closest of the four palette entries for every texel. */
+void encodeColorBlock(const unsigned char* rgba, unsigned char* out) {
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      mean[c] += rgba[i * 4 + c];
+    }
+  }
+  for (int c = 0; c < 3; ++c) {
+    mean[c] /= 16.0f;
+  }
+
+  float covariance[6] = {}; /* xx, xy, xz, yy, yz, zz */
+  for (int i = 0; i < 16; ++i) {
+    float d[3] = { rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2] };
+    covariance[0] += d[0] * d[0];
+    covariance[1] += d[0] * d[1];
+    covariance[2] += d[0] * d[2];
+    covariance[3] += d[1] * d[1];
+    covariance[4] += d[1] * d[2];
+    covariance[5] += d[2] * d[2];
+  }
+
+  /* A few rounds of power iteration are plenty for a 3x3 matrix. */
+  float axis[3] = { 1.0f, 1.0f, 1.0f };
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    float next[3] = {
+      covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+      covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+      covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+    };
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f) {
+      break;
+    }
+    for (int c = 0; c < 3; ++c) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  float minT = 0.0f, maxT = 0.0f;
+  for (int i = 0; i < 16; ++i) {
+    float t = (rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] + (rgba[i * 4 + 2] - mean[2]) * axis[2];
+    minT = std::min(minT, t);
+    maxT = std::max(maxT, t);
+  }
+
+  float endpoint0[3], endpoint1[3];
+  for (int c = 0; c < 3; ++c) {
+    endpoint0[c] = mean[c] + axis[c] * maxT;
+    endpoint1[c] = mean[c] + axis[c] * minT;
+  }
+
+  uint16_t color0 = packRGB565(endpoint0);
+  uint16_t color1 = packRGB565(endpoint1);
+  /* `color0 > color1` selects the four-colour mode. */
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  out[0] = static_cast<unsigned char>(color0 & 0xff);
+  out[1] = static_cast<unsigned char>(color0 >> 8);
+  out[2] = static_cast<unsigned char>(color1 & 0xff);
+  out[3] = static_cast<unsigned char>(color1 >> 8);
+
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    int palette[4][3];
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+      int bestIndex = 0;
+      int bestError = INT32_MAX;
+      for (int p = 0; p < 4; ++p) {
+        int dr = rgba[i * 4] - palette[p][0];
+        int dg = rgba[i * 4 + 1] - palette[p][1];
+        int db = rgba[i * 4 + 2] - palette[p][2];
+        int error = dr * dr + dg * dg + db * db;
+        if (error < bestError) {
+          bestError = error;
+          bestIndex = p;
+        }
+      }
+      indices |= static_cast<uint32_t>(bestIndex) << (2 * i);
+    }
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+  }
+}
+
+} // namespace
+
+size_t blockFormatBlockSize(BlockFormat format) {
+  switch (format) {
+  case BlockFormat::BC1:
+  case BlockFormat::BC4:
+    return 8;
+  case BlockFormat::BC3:
+  case BlockFormat::BC5:
+    return 16;
+  }
+  return 0;
+}
+
+size_t blockFormatImageSize(BlockFormat format, uint32_t width, uint32_t height) {
+  size_t blocksX = (width + 3) / 4;
+  size_t blocksY = (height + 3) / 4;
+  return blocksX * blocksY * blockFormatBlockSize(format);
+}
+
+const char* blockFormatName(BlockFormat format) {
+  switch (format) {
+  case BlockFormat::BC1:
+    return "BC1";
+  case BlockFormat::BC3:
+    return "BC3";
+  case BlockFormat::BC4:
+    return "BC4";
+  case BlockFormat::BC5:
+    return "BC5";
+  }
+  return "unknown";
+}
+
+void encodeBC1Block(const unsigned char* rgba, unsigned char* out) {
+  encodeColorBlock(rgba, out);
+}
+
+void encodeBC3Block(const unsigned char* rgba, unsigned char* out) {
+  unsigned char alpha[16];
+  for (int i = 0; i < 16; ++i) {
+    alpha[i] = rgba[i * 4 + 3];
+  }
+  encodeBC4Block(alpha, out);
+  encodeColorBlock(rgba, out + 8);
+}
+
+void encodeBC4Block(const unsigned char* values, unsigned char* out) {
+  unsigned char minValue = *std::min_element(values, values + 16);
+  unsigned char maxValue = *std::max_element(values, values + 16);
+
+  /* `value0 > value1` selects the eight-value mode. */
+  out[0] = maxValue;
+  out[1] = minValue;
+
+  uint64_t indices = 0;
+  if (maxValue != minValue) {
+    int palette[8];
+    palette[0] = maxValue;
+    palette[1] = minValue;
+    for (int i = 2; i < 8; ++i) {
+      palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+      int bestIndex = 0;
+      int bestError = INT32_MAX;
+      for (int p = 0; p < 8; ++p) {
+        int error = std::abs(values[i] - palette[p]);
+        if (error < bestError) {
+          bestError = error;
+          bestIndex = p;
+        }
+      }
+      indices |= static_cast<uint64_t>(bestIndex) << (3 * i);
+    }
+  }
+
+  for (int i = 0; i < 6; ++i) {
+    out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+  }
+}
+
+void encodeBC5Block(const unsigned char* rg, unsigned char* out) {
+  unsigned char red[16], green[16];
+  for (int i = 0; i < 16; ++i) {
+    red[i] = rg[i * 2];
+    green[i] = rg[i * 2 + 1];
+  }
+  encodeBC4Block(red, out);
+  encodeBC4Block(green, out + 8);
+}
+
+std::vector<unsigned char> compressImage(const unsigned char* rgba, uint32_t width, uint32_t height, BlockFormat format) {
+  std::vector<unsigned char> result(blockFormatImageSize(format, width, height));
+  size_t blockSize = blockFormatBlockSize(format);
+  unsigned char* out = result.data();
+
+  for (uint32_t by = 0; by < height; by += 4) {
+    for (uint32_t bx = 0; bx < width; bx += 4) {
+      unsigned char block[16 * 4];
+      for (uint32_t y = 0; y < 4; ++y) {
+        for (uint32_t x = 0; x < 4; ++x) {
+          uint32_t sx = std::min(bx + x, width - 1);
+          uint32_t sy = std::min(by + y, height - 1);
+          const unsigned char* texel = rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+          std::copy(texel, texel + 4, block + (y * 4 + x) * 4);
+        }
+      }
+
+      switch (format) {
+      case BlockFormat::BC1:
+        encodeBC1Block(block, out);
+        break;
+      case BlockFormat::BC3:
+        encodeBC3Block(block, out);
+        break;
+      case BlockFormat::BC4: {
+        unsigned char red[16];
+        for (int i = 0; i < 16; ++i) {
+          red[i] = block[i * 4];
+        }
+        encodeBC4Block(red, out);
+        break;
+      }
+      case BlockFormat::BC5: {
+        unsigned char rg[16 * 2];
+        for (int i = 0; i < 16; ++i) {
+          rg[i * 2] = block[i * 4];
+          rg[i * 2 + 1] = block[i * 4 + 1];
+        }
+        encodeBC5Block(rg, out);
+        break;
+      }
+      }
+      out += blockSize;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* The block-compressed formats we can encode. Every format stores 4x4 texel
+ * blocks; the numeric values are the ones written to cooked texture files. */
+enum class BlockFormat : uint32_t {
+  BC1 = 1, /* RGB, 8 bytes per block */
+  BC3 = 3, /* RGBA, 16 bytes per block */
+  BC4 = 4, /* R, 8 bytes per block */
+  BC5 = 5, /* RG, 16 bytes per block */
+};
+
+size_t blockFormatBlockSize(BlockFormat format);
+
+/* Size in bytes of a `width` x `height` image in the given format. */
+size_t blockFormatImageSize(BlockFormat format, uint32_t width, uint32_t height);
+
+const char* blockFormatName(BlockFormat format);
+
+/* Encodes one block of 16 RGBA8 texels, row by row. */
+void encodeBC1Block(const unsigned char* rgba, unsigned char* out);
+void encodeBC3Block(const unsigned char* rgba, unsigned char* out);
+
+/* Encodes one block of 16 single-channel values. */
+void encodeBC4Block(const unsigned char* values, unsigned char* out);
+
+/* Encodes one block of 16 RG8 texels. */
+void encodeBC5Block(const unsigned char* rg, unsigned char* out);
+
+/* Compresses a whole RGBA8 image. Partial blocks at the right and bottom
+ * edges are padded by repeating the last column/row. */
+std::vector<unsigned char> compressImage(const unsigned char* rgba, uint32_t width, uint32_t height, BlockFormat format);
@@ -0,0 +1,262 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "Frustum.h"
+
+namespace {
+
+/* Small leaves keep the tree shallow without testing many boxes per leaf. */
+constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+/* Slab test. `outDistance` is where the ray enters the box, or 0 if it
+ * starts inside. */
+bool intersectRay(const BoundingBox& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float& outDistance) {
+  glm::vec3 t0 = (box.min - origin) * inverseDirection;
+  glm::vec3 t1 = (box.max - origin) * inverseDirection;
+  glm::vec3 tNear = glm::min(t0, t1);
+  glm::vec3 tFar = glm::max(t0, t1);
+  float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+  float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+  outDistance = enter;
+  return enter <= exit;
+}
+
+bool operator==(const BoundingBox& lhs, const BoundingBox& rhs) {
+  return lhs.min == rhs.min && lhs.max == rhs.max;
+}
+
+} // namespace
+
+void BoundingVolumeHierarchy::build(const BoundingBox* boxes, const uint32_t* ids, size_t count) {
+  clear();
+  if (count == 0) {
+    return;
+  }
+
+  std::vector<glm::vec3> centers(count);
+  for (size_t i = 0; i < count; ++i) {
+    centers[i] = boxes[i].getCenter();
+  }
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+
+  /* Top-down, splitting each range at the median centre along its widest
+   * axis. Not as tight as a surface area heuristic, but O(n log n) and
+   * always balanced. */
+  struct Task {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+  };
+  std::vector<Task> tasks = { { 0, 0, static_cast<uint32_t>(count) } };
+  nodes.reserve(2 * (count / MAX_LEAF_SIZE + 1));
+  nodes.push_back({});
+  parents.push_back(NO_PRIMITIVE);
+
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    BoundingBox box = BoundingBox::empty();
+    BoundingBox centerBox = BoundingBox::empty();
+    for (uint32_t i = task.begin; i < task.end; ++i) {
+      grow(box, boxes[order[i]]);
+      grow(centerBox, centers[order[i]]);
+    }
+    nodes[task.node].box = box;
+
+    uint32_t primitiveCount = task.end - task.begin;
+    if (primitiveCount <= MAX_LEAF_SIZE) {
+      nodes[task.node].first = task.begin;
+      nodes[task.node].count = primitiveCount;
+      continue;
+    }
+
+    glm::vec3 extents = centerBox.max - centerBox.min;
+    int axis = 0;
+    if (extents.y > extents[axis]) {
+      axis = 1;
+    }
+    if (extents.z > extents[axis]) {
+      axis = 2;
+    }
+
+    uint32_t middle = task.begin + primitiveCount / 2;
+    std::nth_element(order.begin() + task.begin, order.begin() + middle, order.begin() + task.end,
+                     [&centers, axis](uint32_t lhs, uint32_t rhs) { return centers[lhs][axis] < centers[rhs][axis]; });
+
+    uint32_t left = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({});
+    nodes.push_back({});
+    parents.push_back(task.node);
+    parents.push_back(task.node);
+    nodes[task.node].first = left;
+    nodes[task.node].count = 0;
+
+    tasks.push_back({ left + 1, middle, task.end });
+    tasks.push_back({ left, task.begin, middle });
+  }
+
+  /* Store the primitives in leaf order, so each leaf reads a contiguous run. */
+  primitiveBoxes.resize(count);
+  primitiveIds.resize(count);
+  primitiveLeaves.resize(count);
+  uint32_t maxId = 0;
+  for (size_t i = 0; i < count; ++i) {
+    primitiveBoxes[i] = boxes[order[i]];
+    primitiveIds[i] = ids[order[i]];
+    maxId = std::max(maxId, primitiveIds[i]);
+  }
+  for (uint32_t n = 0; n < nodes.size(); ++n) {
+    for (uint32_t i = 0; i < nodes[n].count; ++i) {
+      primitiveLeaves[nodes[n].first + i] = n;
+    }
+  }
+  slots.assign(static_cast<size_t>(maxId) + 1, NO_PRIMITIVE);
+  for (size_t i = 0; i < count; ++i) {
+    slots[primitiveIds[i]] = static_cast<uint32_t>(i);
+  }
+}
+
+void BoundingVolumeHierarchy::clear(void) {
+  nodes.clear();
+  parents.clear();
+  primitiveBoxes.clear();
+  primitiveIds.clear();
+  primitiveLeaves.clear();
+  slots.clear();
+}
+
+void BoundingVolumeHierarchy::refit(uint32_t id, const BoundingBox& box) {
+  if (id >= slots.size() || slots[id] == NO_PRIMITIVE) {
+    return;
+  }
+  uint32_t slot = slots[id];
+  primitiveBoxes[slot] = box;
+
+  /* Walk up until a box comes out unchanged; everything above it is then
+   * unchanged too. */
+  uint32_t n = primitiveLeaves[slot];
+  while (n != NO_PRIMITIVE) {
+    Node& node = nodes[n];
+    BoundingBox newBox = BoundingBox::empty();
+    if (node.count > 0) {
+      for (uint32_t i = 0; i < node.count; ++i) {
+        grow(newBox, primitiveBoxes[node.first + i]);
+      }
+    } else {
+      newBox = nodes[node.first].box;
+      grow(newBox, nodes[node.first + 1].box);
+    }
+    if (newBox == node.box) {
+      return;
+    }
+    node.box = newBox;
+    n = parents[n];
+  }
+}
+
+void BoundingVolumeHierarchy::query(const Frustum& frustum, std::vector<uint32_t>& outIds) const {
+  if (nodes.empty()) {
+    return;
+  }
+
+  stack.clear();
+  stack.push_back(0);
+  while (!stack.empty()) {
+    const Node& node = nodes[stack.back()];
+    uint32_t n = stack.back();
+    stack.pop_back();
+
+    if (!frustum.intersects(node.box)) {
+      continue;
+    }
+    if (frustum.contains(node.box)) {
+      collect(n, outIds);
+      continue;
+    }
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        if (frustum.intersects(primitiveBoxes[i])) {
+          outIds.push_back(primitiveIds[i]);
+        }
+      }
+    } else {
+      stack.push_back(node.first + 1);
+      stack.push_back(node.first);
+    }
+  }
+}
+
+void BoundingVolumeHierarchy::collect(uint32_t node, std::vector<uint32_t>& outIds) const {
+  /* The primitives of a subtree are contiguous, from the first of its
+   * leftmost leaf to the last of its rightmost one. */
+  uint32_t leftmost = node;
+  while (nodes[leftmost].count == 0) {
+    leftmost = nodes[leftmost].first;
+  }
+  uint32_t rightmost = node;
+  while (nodes[rightmost].count == 0) {
+    rightmost = nodes[rightmost].first + 1;
+  }
+  outIds.insert(outIds.end(), primitiveIds.begin() + nodes[leftmost].first,
+                primitiveIds.begin() + nodes[rightmost].first + nodes[rightmost].count);
+}
+
+uint32_t BoundingVolumeHierarchy::raycast(const glm::vec3& origin, const glm::vec3& direction, float* outDistance) const {
+  uint32_t closestId = NO_PRIMITIVE;
+  float closestDistance = std::numeric_limits<float>::infinity();
+  if (nodes.empty()) {
+    return closestId;
+  }
+
+  glm::vec3 inverseDirection = 1.0f / direction;
+
+  stack.clear();
+  stack.push_back(0);
+  while (!stack.empty()) {
+    const Node& node = nodes[stack.back()];
+    stack.pop_back();
+
+    /* Skip subtrees that start behind the closest hit so far. */
+    float distance;
+    if (!intersectRay(node.box, origin, inverseDirection, distance) || distance >= closestDistance) {
+      continue;
+    }
+
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        if (intersectRay(primitiveBoxes[i], origin, inverseDirection, distance) && distance < closestDistance) {
+          closestDistance = distance;
+          closestId = primitiveIds[i];
+        }
+      }
+    } else {
+      /* Visit the nearer child first, so the farther one is more likely to
+       * be skipped. */
+      float leftDistance, rightDistance;
+      bool hitLeft = intersectRay(nodes[node.first].box, origin, inverseDirection, leftDistance);
+      bool hitRight = intersectRay(nodes[node.first + 1].box, origin, inverseDirection, rightDistance);
+      uint32_t nearChild = node.first, farChild = node.first + 1;
+      if (hitLeft && hitRight && rightDistance < leftDistance) {
+        std::swap(nearChild, farChild);
+      }
+      if (hitLeft && hitRight) {
+        stack.push_back(farChild);
+        stack.push_back(nearChild);
+      } else if (hitLeft) {
+        stack.push_back(node.first);
+      } else if (hitRight) {
+        stack.push_back(node.first + 1);
+      }
+    }
+  }
+
+  if (outDistance && closestId != NO_PRIMITIVE) {
+    *outDistance = closestDistance;
+  }
+  return closestId;
+}
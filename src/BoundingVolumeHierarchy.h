@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+class Frustum;
+
+/* A binary tree of axis-aligned boxes over a set of primitive boxes, each
+ * identified by a caller-chosen id. Culling and picking descend only into
+ * the subtrees that can contain a result, so they take logarithmic rather
+ * than linear time in the number of primitives.
+ *
+ * Nodes live in one array, with the two children of a node next to each
+ * other, and the primitives of each leaf are contiguous. */
+class BoundingVolumeHierarchy {
+public:
+  static constexpr uint32_t NO_PRIMITIVE = ~0u;
+
+  /* Replaces the tree with one over `boxes[i]`, identified by `ids[i]`. Ids
+   * should be small integers, as they index a lookup table. */
+  void build(const BoundingBox* boxes, const uint32_t* ids, size_t count);
+
+  void clear(void);
+
+  /* Moves one primitive, enlarging or shrinking only the boxes of its
+   * ancestors. Cheap, but the tree degrades if primitives move far; rebuild
+   * it once they have. */
+  void refit(uint32_t id, const BoundingBox& box);
+
+  /* Appends the ids of the primitives whose boxes intersect `frustum`.
+   * Subtrees entirely inside are appended without testing their contents. */
+  void query(const Frustum& frustum, std::vector<uint32_t>& outIds) const;
+
+  /* The id of the primitive whose box the ray hits first, or `NO_PRIMITIVE`.
+   * `direction` need not be normalised; distances are in multiples of it. */
+  uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float* outDistance = nullptr) const;
+
+  size_t size(void) const {
+    return primitiveIds.size();
+  }
+
+  /* Around everything, or empty. */
+  BoundingBox getBounds(void) const {
+    return nodes.empty() ? BoundingBox::empty() : nodes.front().box;
+  }
+
+private:
+  /* A leaf if `count` is non-zero, in which case its primitives are
+   * `first .. first + count - 1`; otherwise its children are `first` and
+   * `first + 1`. */
+  struct Node {
+    BoundingBox box;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  /* Appends every primitive below `node`. */
+  void collect(uint32_t node, std::vector<uint32_t>& outIds) const;
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> parents;
+
+  /* Per primitive slot, in leaf order. */
+  std::vector<BoundingBox> primitiveBoxes;
+  std::vector<uint32_t> primitiveIds;
+  std::vector<uint32_t> primitiveLeaves;
+
+  /* Per id: its slot, or `NO_PRIMITIVE`. */
+  std::vector<uint32_t> slots;
+
+  /* Scratch space for `query` and `raycast`. */
+  mutable std::vector<uint32_t> stack;
+};
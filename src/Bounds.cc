@@ -0,0 +1,64 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+void grow(BoundingSphere& sphere, const BoundingSphere& other) {
+  glm::vec3 offset = other.center - sphere.center;
+  float distance = glm::length(offset);
+  if (distance + other.radius <= sphere.radius) {
+    return;
+  }
+  if (distance + sphere.radius <= other.radius) {
+    sphere = other;
+    return;
+  }
+  float radius = 0.5f * (distance + sphere.radius + other.radius);
+  sphere.center += offset * ((radius - sphere.radius) / distance);
+  sphere.radius = radius;
+}
+
+BoundingBox transform(const BoundingBox& box, const glm::mat4& matrix) {
+  if (box.isEmpty()) {
+    return box;
+  }
+
+  glm::vec3 center = glm::vec3(matrix * glm::vec4(box.getCenter(), 1.0f));
+  glm::vec3 extents = box.getExtents();
+  glm::vec3 newExtents(0.0f);
+  for (int column = 0; column < 3; ++column) {
+    newExtents += glm::abs(glm::vec3(matrix[column])) * extents[column];
+  }
+  return { center - newExtents, center + newExtents };
+}
+
+BoundingSphere transform(const BoundingSphere& sphere, const glm::mat4& matrix) {
+  float scale = std::max({ glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) });
+  return { glm::vec3(matrix * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale };
+}
+
+Bounds computeBounds(const glm::vec3* positions, size_t count, size_t stride) {
+  auto at = [positions, stride](size_t i) -> const glm::vec3& {
+    return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const char*>(positions) + i * stride);
+  };
+
+  Bounds bounds;
+  bounds.box = BoundingBox::empty();
+  for (size_t i = 0; i < count; ++i) {
+    grow(bounds.box, at(i));
+  }
+
+  if (count == 0) {
+    bounds.sphere = { glm::vec3(0.0f), 0.0f };
+    return bounds;
+  }
+
+  bounds.sphere.center = bounds.box.getCenter();
+  float radiusSquared = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 offset = at(i) - bounds.sphere.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  bounds.sphere.radius = std::sqrt(radiusSquared);
+  return bounds;
+}
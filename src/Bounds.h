@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <boost/pfr.hpp>
+#include <glm/glm.hpp>
+
+#include "VertexAttribute.h"
+
+struct BoundingBox {
+  glm::vec3 min;
+  glm::vec3 max;
+
+  glm::vec3 getCenter(void) const {
+    return 0.5f * (min + max);
+  }
+
+  glm::vec3 getExtents(void) const {
+    return 0.5f * (max - min);
+  }
+
+  bool isEmpty(void) const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  /* An inverted box that any point or box grows. */
+  static BoundingBox empty(void) {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return { glm::vec3(inf), glm::vec3(-inf) };
+  }
+};
+
+struct BoundingSphere {
+  glm::vec3 center;
+  float radius;
+};
+
+struct Bounds {
+  BoundingBox box;
+  BoundingSphere sphere;
+};
+
+inline void grow(BoundingBox& box, const glm::vec3& point) {
+  box.min = glm::min(box.min, point);
+  box.max = glm::max(box.max, point);
+}
+
+inline void grow(BoundingBox& box, const BoundingBox& other) {
+  box.min = glm::min(box.min, other.min);
+  box.max = glm::max(box.max, other.max);
+}
+
+/* Grows `sphere` to the smallest sphere enclosing both. */
+void grow(BoundingSphere& sphere, const BoundingSphere& other);
+
+/* The box around `box` after transforming it by `matrix` (Arvo, "Transforming
+ * Axis-Aligned Bounding Boxes", Graphics Gems, 1990). */
+BoundingBox transform(const BoundingBox& box, const glm::mat4& matrix);
+
+/* The sphere around `sphere` after transforming it by `matrix`, which may
+ * scale non-uniformly. */
+BoundingSphere transform(const BoundingSphere& sphere, const glm::mat4& matrix);
+
+/* A box and a sphere around `positions`. The sphere is centred on the box, and
+ * only as large as the farthest point requires. */
+Bounds computeBounds(const glm::vec3* positions, size_t count, size_t stride = sizeof(glm::vec3));
+
+/* Vertex positions are the first field of a vertex, in any of the formats
+ * below. */
+inline glm::vec3 toPosition(const glm::vec2& position) {
+  return glm::vec3(position, 0.0f);
+}
+
+inline glm::vec3 toPosition(const glm::vec3& position) {
+  return position;
+}
+
+inline glm::vec3 toPosition(const glm::vec4& position) {
+  return glm::vec3(position);
+}
+
+inline glm::vec3 toPosition(const Half4& position) {
+  return glm::vec3(toVec4(position));
+}
+
+template <typename VertexType>
+Bounds computeVertexBounds(const void* vertices, size_t count) {
+  const VertexType* typed = static_cast<const VertexType*>(vertices);
+  using PositionType = boost::pfr::tuple_element_t<0, VertexType>;
+  if constexpr (std::is_same_v<PositionType, glm::vec3>) {
+    return computeBounds(&boost::pfr::get<0>(typed[0]), count, sizeof(VertexType));
+  } else {
+    std::vector<glm::vec3> positions(count);
+    for (size_t i = 0; i < count; ++i) {
+      positions[i] = toPosition(boost::pfr::get<0>(typed[i]));
+    }
+    return computeBounds(positions.data(), count);
+  }
+}
@@ -54,6 +54,13 @@ void Camera::processMouseScroll(float yoffset) {
   fovy = glm::clamp(fovy - yoffset, 1.0f, 90.0f);
 }
 
+void Camera::setPose(const glm::vec3& position, float yaw, float pitch) {
+  this->position = position;
+  this->yaw = yaw;
+  this->pitch = pitch;
+  updateCameraVectors();
+}
+
 void Camera::updateCameraVectors(void) {
   /* Calculate the new front vector. */
   front.x = std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch));
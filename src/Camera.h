@@ -22,6 +22,10 @@ public:
 
   void processMouseScroll(float yoffset);
 
+  /* Places the camera directly, e.g. along a scripted path. Angles are in
+   * degrees, as for the constructor. */
+  void setPose(const glm::vec3& position, float yaw, float pitch);
+
   void setMovementSpeed(float speed) {
     movementSpeed = glm::max(speed, 0.0f);
   }
@@ -38,6 +42,11 @@ public:
     return front;
   }
 
+  /* Vertical field of view in degrees, as zoomed by `processMouseScroll`. */
+  float getFovy(void) const {
+    return fovy;
+  }
+
 private:
   void updateCameraVectors(void);
 
@@ -0,0 +1,46 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+#include "Camera.h"
+
+void CameraPath::apply(float time, Camera& camera) const {
+  if (keyframes.empty()) {
+    return;
+  }
+  if (time <= keyframes.front().time) {
+    camera.setPose(keyframes.front().position, keyframes.front().yaw, keyframes.front().pitch);
+    return;
+  }
+  if (time >= keyframes.back().time) {
+    camera.setPose(keyframes.back().position, keyframes.back().yaw, keyframes.back().pitch);
+    return;
+  }
+
+  /* The first keyframe after `time`; the one before it exists, since `time`
+   * is past the first. */
+  auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                               [](float t, const Keyframe& keyframe) { return t < keyframe.time; });
+  const Keyframe& a = *std::prev(next);
+  const Keyframe& b = *next;
+  float t = (time - a.time) / (b.time - a.time);
+  camera.setPose(glm::mix(a.position, b.position, t), glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t));
+}
+
+CameraPath CameraPath::orbit(const glm::vec3& center, float radius, float height, float duration) {
+  /* Fine enough that the chords stay close to the circle. */
+  constexpr int STEPS = 64;
+
+  CameraPath path;
+  float pitch = -glm::degrees(std::atan2(height, radius));
+  for (int i = 0; i <= STEPS; ++i) {
+    float angle = glm::two_pi<float>() * i / STEPS;
+    glm::vec3 position = center + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+    /* Facing back along the radius. */
+    path.addKeyframe({ duration * i / STEPS, position, glm::degrees(angle) + 180.0f, pitch });
+  }
+  return path;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class Camera;
+
+/* A scripted camera flight: poses at given times, interpolated linearly in
+ * between, so that every run sees exactly the same sequence of views. */
+class CameraPath {
+public:
+  struct Keyframe {
+    float time;
+    glm::vec3 position;
+    /* In degrees, as for `Camera`. Not wrapped, so a path can turn past a
+     * full circle. */
+    float yaw;
+    float pitch;
+  };
+
+  /* Keyframes must come in increasing order of time. */
+  void addKeyframe(const Keyframe& keyframe) {
+    keyframes.push_back(keyframe);
+  }
+
+  /* Poses `camera` at `time`, held at the first or last keyframe outside
+   * the path. */
+  void apply(float time, Camera& camera) const;
+
+  float getDuration(void) const {
+    return keyframes.empty() ? 0.0f : keyframes.back().time;
+  }
+
+  /* Once around `center` in `duration` seconds, `radius` away and `height`
+   * above it, always looking at it. */
+  static CameraPath orbit(const glm::vec3& center, float radius, float height, float duration);
+
+private:
+  std::vector<Keyframe> keyframes;
+};
@@ -0,0 +1,290 @@
+#include "CascadedShadowMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Camera.h"
+#include "Frustum.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+static_assert(sizeof(ShadowData::shadowMatrices) / sizeof(glm::mat4) == CascadedShadowMap::MAX_CASCADES,
+              "ShadowData must have room for every cascade");
+
+/* How far the splits lean towards a logarithmic distribution, which keeps
+ * texels the same size on screen, from a uniform one, which doesn't spend
+ * nearly all of them right in front of the camera. */
+constexpr float SPLIT_LOGARITHMIC_WEIGHT = 0.75f;
+
+/* Cascades cover this much more than their slice's sphere, so the camera can
+ * move a little before one has to follow it and be drawn again. */
+constexpr float GUARD_BAND = 1.25f;
+
+/* Slack around the casters' depth range, as a fraction of it, so a caster
+ * moving along the light doesn't refit every cascade. */
+constexpr float DEPTH_MARGIN = 0.1f;
+
+/* Depth bias of the shadow pass, against surfaces shadowing themselves. */
+constexpr float POLYGON_OFFSET_FACTOR = 1.5f;
+constexpr float POLYGON_OFFSET_UNITS = 4.0f;
+
+/* Looks along `direction` from the origin. Only the orientation matters;
+ * cascades place themselves within it. */
+glm::mat4 lightViewMatrix(const glm::vec3& direction) {
+  glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  return glm::lookAt(glm::vec3(0.0f), direction, up);
+}
+
+} // namespace
+
+std::unique_ptr<CascadedShadowMap> CascadedShadowMap::create(int resolution, uint32_t cascadeCount) {
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  if (resolution <= 0 || resolution > maxSize || cascadeCount == 0 || cascadeCount > MAX_CASCADES) {
+    std::cerr << "Unsupported shadow map: " << cascadeCount << " cascades of " << resolution << "x" << resolution
+              << std::endl;
+    return nullptr;
+  }
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  GLState::bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+               GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+  /* Compared as they are sampled, and the results filtered bilinearly. */
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  /* Past the edge of a cascade nothing casts a shadow. */
+  const GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+  glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+  std::unique_ptr<CascadedShadowMap> shadowMap(new CascadedShadowMap(texture, resolution, cascadeCount));
+  for (uint32_t i = 0; i < cascadeCount; ++i) {
+    Cascade& cascade = shadowMap->cascades[i];
+    glGenFramebuffers(1, &cascade.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, cascade.framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, static_cast<GLint>(i));
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      std::cerr << "Framebuffer of shadow cascade " << i << " is incomplete: 0x" << std::hex << status << std::dec
+                << std::endl;
+      return nullptr;
+    }
+  }
+  return shadowMap;
+}
+
+CascadedShadowMap::CascadedShadowMap(GLuint texture, int resolution, uint32_t cascadeCount)
+  : texture(texture)
+  , resolution(resolution)
+  , cascadeCount(cascadeCount)
+  , cascadeBuffer(UniformBuffer::create(SHADOW_CASCADE_BINDING, sizeof(ShadowCascadeData)))
+  , shadowDataBuffer(UniformBuffer::create(SHADOW_DATA_BINDING, sizeof(ShadowData))) {
+  glGenQueries(2 * QUERY_LATENCY, queries);
+}
+
+CascadedShadowMap::~CascadedShadowMap(void) {
+  for (const Cascade& cascade : cascades) {
+    if (cascade.framebuffer != 0) {
+      glDeleteFramebuffers(1, &cascade.framebuffer);
+    }
+  }
+  GLState::deleteTexture(texture);
+  glDeleteQueries(2 * QUERY_LATENCY, queries);
+}
+
+void CascadedShadowMap::setLightDirection(const glm::vec3& direction) {
+  glm::vec3 normalized = glm::normalize(direction);
+  if (normalized != lightDirection) {
+    lightDirection = normalized;
+    lightChanged = true;
+  }
+}
+
+CascadedShadowMap::Caster CascadedShadowMap::addCaster(const BoundingBox& worldBounds, const DrawPacket& packet,
+                                                       bool dynamic) {
+  Caster caster = casterBounds.add(worldBounds);
+  /* `render` counts the frame up before drawing, so this is the next one. */
+  casters.push_back({ worldBounds, packet, dynamic, frame + 1 });
+  casterBoundsChanged = true;
+  return caster;
+}
+
+void CascadedShadowMap::setCasterBounds(Caster caster, const BoundingBox& worldBounds) {
+  casterBounds.set(caster, worldBounds);
+  casters[caster].bounds = worldBounds;
+  casters[caster].changedFrame = frame + 1;
+  casterBoundsChanged = true;
+}
+
+void CascadedShadowMap::render(const Camera& camera, float aspect, float near, float far) {
+  ProfileScope profileScope("Shadow maps");
+  GpuProfileScope gpuProfileScope("Shadow maps");
+  auto start = std::chrono::steady_clock::now();
+
+  /* The timestamps about to be reused went out `QUERY_LATENCY` frames
+   * ago. */
+  size_t slot = frame % QUERY_LATENCY;
+  if (frame >= QUERY_LATENCY) {
+    collectGpuTime(slot);
+  }
+  glQueryCounter(queries[2 * slot], GL_TIMESTAMP);
+  ++frame;
+
+  statistics.cascades = cascadeCount;
+  statistics.renderedCascades = 0;
+  statistics.cachedCascades = 0;
+  statistics.draws = 0;
+
+  glm::mat4 lightView = lightViewMatrix(lightDirection);
+  if (casterBoundsChanged || lightChanged) {
+    lightSpaceBounds = BoundingBox::empty();
+    for (const CasterInfo& caster : casters) {
+      grow(lightSpaceBounds, transform(caster.bounds, lightView));
+    }
+    casterBoundsChanged = false;
+  }
+
+  /* The corners of the view frustum at depth d are (±d tanX, ±d tanY, -d).
+   * The smallest sphere through the corners of a slice from d0 to d1 is
+   * centred on the view axis, where the near and far corners are equally
+   * far away, unless that is beyond the slice. */
+  glm::mat4 inverseView = glm::inverse(camera.getViewMatrix());
+  float tanY = std::tan(0.5f * glm::radians(camera.getFovy()));
+  float tanX = tanY * aspect;
+  float tanSquared = tanX * tanX + tanY * tanY;
+
+  /* From clip space to texture coordinates and depth in [0, 1]. */
+  glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+
+  ShadowData data = {};
+  float sliceStart = near;
+  for (uint32_t i = 0; i < cascadeCount; ++i) {
+    Cascade& cascade = cascades[i];
+    float t = static_cast<float>(i + 1) / cascadeCount;
+    float sliceEnd = i + 1 == cascadeCount
+                       ? far
+                       : glm::mix(near + (far - near) * t, near * std::pow(far / near, t), SPLIT_LOGARITHMIC_WEIGHT);
+
+    float centerDepth = std::min(0.5f * (sliceStart + sliceEnd) * (1.0f + tanSquared), sliceEnd);
+    float radius = std::sqrt((sliceEnd - centerDepth) * (sliceEnd - centerDepth) + sliceEnd * sliceEnd * tanSquared);
+    glm::vec3 center = glm::vec3(lightView * inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+    bool moved = fitCascade(cascade, center, radius, lightView);
+
+    cascade.casters.clear();
+    FrustumCuller::cull(Frustum::fromMatrix(cascade.viewProjectionMatrix), casterBounds, cascade.casters, false);
+    bool stale = moved || !cascade.valid || cascade.casters != cascade.renderedCasters;
+    for (uint32_t caster : cascade.casters) {
+      stale = stale || casters[caster].dynamic || casters[caster].changedFrame > cascade.renderedFrame;
+    }
+    if (stale) {
+      renderCascade(cascade, lightView);
+      ++statistics.renderedCascades;
+    } else {
+      ++statistics.cachedCascades;
+    }
+
+    data.shadowMatrices[i] = bias * cascade.viewProjectionMatrix;
+    data.splitDepths[i] = sliceEnd;
+    data.texelSizes[i] = 2.0f * cascade.halfExtent / resolution;
+    sliceStart = sliceEnd;
+  }
+  lightChanged = false;
+
+  data.lightDirection = lightDirection;
+  data.cascadeCount = cascadeCount;
+  data.lightColor = lightColor;
+  shadowDataBuffer->update(&data, sizeof data);
+  GLState::bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+
+  glQueryCounter(queries[2 * slot + 1], GL_TIMESTAMP);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  statistics.cpuTime = elapsed.count();
+}
+
+bool CascadedShadowMap::fitCascade(Cascade& cascade, const glm::vec3& center, float radius,
+                                   const glm::mat4& lightViewMatrix) {
+  /* The light looks down -z. */
+  float nearDepth = lightSpaceBounds.isEmpty() ? 0.0f : -lightSpaceBounds.max.z;
+  float farDepth = lightSpaceBounds.isEmpty() ? 1.0f : -lightSpaceBounds.min.z;
+
+  glm::vec2 offset = glm::abs(glm::vec2(center) - cascade.center);
+  bool fits = cascade.valid && !lightChanged
+              && radius <= cascade.halfExtent && cascade.halfExtent <= radius * GUARD_BAND * GUARD_BAND
+              && std::max(offset.x, offset.y) + radius <= cascade.halfExtent
+              && nearDepth >= cascade.nearDepth && farDepth <= cascade.farDepth;
+  if (fits) {
+    return false;
+  }
+
+  /* Snapped to whole texels, so that static casters cover the same texels
+   * wherever the cascade moves. */
+  cascade.halfExtent = radius * GUARD_BAND;
+  float texelSize = 2.0f * cascade.halfExtent / resolution;
+  cascade.center = glm::round(glm::vec2(center) / texelSize) * texelSize;
+  float margin = DEPTH_MARGIN * (farDepth - nearDepth);
+  cascade.nearDepth = nearDepth - margin;
+  cascade.farDepth = farDepth + margin;
+
+  glm::mat4 projection = glm::ortho(cascade.center.x - cascade.halfExtent, cascade.center.x + cascade.halfExtent,
+                                    cascade.center.y - cascade.halfExtent, cascade.center.y + cascade.halfExtent,
+                                    cascade.nearDepth, cascade.farDepth);
+  cascade.viewProjectionMatrix = projection * lightViewMatrix;
+  cascade.valid = false;
+  return true;
+}
+
+void CascadedShadowMap::renderCascade(Cascade& cascade, const glm::mat4& lightViewMatrix) {
+  ProfileScope profileScope("Shadow cascade");
+  GpuProfileScope gpuProfileScope("Shadow cascade");
+
+  ShadowCascadeData data = { cascade.viewProjectionMatrix };
+  cascadeBuffer->update(&data, sizeof data);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, cascade.framebuffer);
+  glViewport(0, 0, resolution, resolution);
+  GLState::setDepthMask(true);
+  glClear(GL_DEPTH_BUFFER_BIT);
+
+  /* Front to back as seen from the light. */
+  queue.clear();
+  for (uint32_t caster : cascade.casters) {
+    DrawPacket packet = casters[caster].packet;
+    packet.layer = RenderLayer::SOLID;
+    packet.depth = -(lightViewMatrix * glm::vec4(casters[caster].bounds.getCenter(), 1.0f)).z - cascade.nearDepth;
+    queue.push(packet);
+  }
+  queue.sort();
+
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS);
+  queue.submit();
+  glDisable(GL_POLYGON_OFFSET_FILL);
+
+  statistics.draws += cascade.casters.size();
+  cascade.renderedCasters = cascade.casters;
+  cascade.renderedFrame = frame;
+  cascade.valid = true;
+}
+
+void CascadedShadowMap::collectGpuTime(size_t slot) {
+  GLuint64 begin = 0, end = 0;
+  glGetQueryObjectui64v(queries[2 * slot], GL_QUERY_RESULT, &begin);
+  glGetQueryObjectui64v(queries[2 * slot + 1], GL_QUERY_RESULT, &end);
+  statistics.gpuTime = (end - begin) / 1e6;
+}
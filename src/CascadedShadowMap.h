@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+
+class Camera;
+class UniformBuffer;
+
+/* Shadows of a directional light, in cascades: the camera's depth range is
+ * split into slices, near ones short and far ones long, and each slice gets
+ * its own layer of a depth texture array, so texels stay about the same size
+ * on screen from the camera's feet to its far plane.
+ *
+ * Each cascade covers a square around its slice's bounding sphere, which is
+ * the same size however the camera turns, and the square only moves in whole
+ * texels, so shadow edges don't shimmer. The square is larger than the
+ * sphere, and stays put until the slice leaves it. A cascade whose square
+ * didn't move and whose casters didn't change keeps last frame's depth;
+ * only cascades that hold a dynamic caster are drawn every frame.
+ *
+ * Shaders read the result through `assets/shaders/common/Shadows.glsl`. */
+class CascadedShadowMap {
+public:
+  static constexpr uint32_t MAX_CASCADES = 4;
+
+  using Caster = uint32_t;
+
+  struct Statistics {
+    size_t cascades;
+    /* Cascades drawn this frame, and ones kept from an earlier frame. */
+    size_t renderedCascades;
+    size_t cachedCascades;
+    /* Casters drawn across all cascades this frame, one draw call each. */
+    size_t draws;
+    /* Time `render` took, in milliseconds: on the CPU this frame, and on the
+     * GPU `QUERY_LATENCY` frames ago. */
+    double cpuTime;
+    double gpuTime;
+  };
+
+  /* `resolution` is the width and height of every cascade. */
+  static std::unique_ptr<CascadedShadowMap> create(int resolution, uint32_t cascadeCount = MAX_CASCADES);
+
+  CascadedShadowMap(const CascadedShadowMap&) = delete;
+  CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+  ~CascadedShadowMap(void);
+
+  /* The direction the light shines in. Changing it redraws every cascade. */
+  void setLightDirection(const glm::vec3& direction);
+  void setLightColor(const glm::vec3& color) {
+    lightColor = color;
+  }
+
+  /* `packet` draws the caster with a depth-only program that reads the
+   * `ShadowCascade` block; its layer and depth are ignored. Whatever it
+   * points at must live as long as the caster. Static casters should rarely
+   * move, dynamic ones may move every frame. */
+  Caster addCaster(const BoundingBox& worldBounds, const DrawPacket& packet, bool dynamic);
+
+  /* Redraws the cascades the caster leaves or enters, and, if it is static,
+   * the ones it stays in. */
+  void setCasterBounds(Caster caster, const BoundingBox& worldBounds);
+
+  /* Fits the cascades to the camera's view between `near` and `far`, draws
+   * the ones that are out of date and uploads what the shaders need. Leaves
+   * a framebuffer of its own bound. */
+  void render(const Camera& camera, float aspect, float near, float far);
+
+  GLuint getTexture(void) const {
+    return texture;
+  }
+
+  const Statistics& getStatistics(void) const {
+    return statistics;
+  }
+
+private:
+  /* Frames between issuing the timestamps and reading them back. */
+  static constexpr size_t QUERY_LATENCY = 4;
+
+  struct CasterInfo {
+    BoundingBox bounds;
+    DrawPacket packet;
+    bool dynamic;
+    /* The frame it last moved in. */
+    uint64_t changedFrame;
+  };
+
+  struct Cascade {
+    GLuint framebuffer = 0;
+    /* The square the cascade covers, in light space, and a depth range
+     * around every caster. */
+    glm::vec2 center = glm::vec2(0.0f);
+    float halfExtent = 0.0f;
+    float nearDepth = 0.0f;
+    float farDepth = 0.0f;
+    glm::mat4 viewProjectionMatrix = glm::mat4(1.0f);
+    /* Whether the layer holds anything drawn with the current matrix. */
+    bool valid = false;
+    uint64_t renderedFrame = 0;
+    std::vector<uint32_t> casters;
+    std::vector<uint32_t> renderedCasters;
+  };
+
+  CascadedShadowMap(GLuint texture, int resolution, uint32_t cascadeCount);
+
+  /* Moves the cascade if the slice's sphere, given in light space, no
+   * longer fits into it; true if it moved. */
+  bool fitCascade(Cascade& cascade, const glm::vec3& center, float radius, const glm::mat4& lightViewMatrix);
+  void renderCascade(Cascade& cascade, const glm::mat4& lightViewMatrix);
+  void collectGpuTime(size_t slot);
+
+  GLuint texture;
+  int resolution;
+  uint32_t cascadeCount;
+  Cascade cascades[MAX_CASCADES];
+
+  glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+  glm::vec3 lightColor = glm::vec3(1.0f);
+  bool lightChanged = true;
+
+  std::vector<CasterInfo> casters;
+  BoundingBoxList casterBounds;
+  /* Light-space bounds of all casters, as of the last `render`. */
+  BoundingBox lightSpaceBounds = BoundingBox::empty();
+  bool casterBoundsChanged = true;
+
+  uint64_t frame = 0;
+  RenderQueue queue;
+  std::unique_ptr<UniformBuffer> cascadeBuffer;
+  std::unique_ptr<UniformBuffer> shadowDataBuffer;
+
+  /* A begin and an end timestamp per frame in flight. */
+  GLuint queries[2 * QUERY_LATENCY];
+
+  Statistics statistics = {};
+};
@@ -0,0 +1,155 @@
+#include "CookedTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "MappedFile.h"
+
+namespace {
+
+/* Bump this whenever the file layout changes. */
+constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+constexpr char COOKED_TEXTURE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'C', 'T', 'E', 'X' };
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t reserved;
+};
+
+struct LevelHeader {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+} // namespace
+
+CookedTexture::CookedTexture(std::unique_ptr<MappedFile> file)
+  : file(std::move(file))
+  , format(BlockFormat::BC1) {}
+
+CookedTexture::~CookedTexture(void) = default;
+
+std::unique_ptr<CookedTexture> CookedTexture::openFor(const std::string& sourcePath) {
+  std::string cookedPath = pathFor(sourcePath);
+
+  std::error_code ec;
+  auto cookedTime = std::filesystem::last_write_time(cookedPath, ec);
+  if (ec) {
+    return nullptr;
+  }
+  /* A source newer than its cooked version means the cooker needs to be
+   * re-run; fall back to the source until then. */
+  auto sourceTime = std::filesystem::last_write_time(sourcePath, ec);
+  if (!ec && sourceTime > cookedTime) {
+    std::cerr << "Cooked texture is out of date: " << cookedPath << std::endl;
+    return nullptr;
+  }
+
+  return open(cookedPath);
+}
+
+std::unique_ptr<CookedTexture> CookedTexture::open(const std::string& path) {
+  std::unique_ptr<MappedFile> file = MappedFile::open(path);
+  if (!file) {
+    return nullptr;
+  }
+
+  std::unique_ptr<CookedTexture> texture(new CookedTexture(std::move(file)));
+  if (!texture->parse()) {
+    std::cerr << "Invalid cooked texture: " << path << std::endl;
+    return nullptr;
+  }
+  return texture;
+}
+
+bool CookedTexture::write(const std::string& path, BlockFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels) {
+  FileHeader header = {};
+  std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof header.magic);
+  header.version = COOKED_TEXTURE_VERSION;
+  header.format = static_cast<uint32_t>(format);
+  header.width = width;
+  header.height = height;
+  header.levelCount = static_cast<uint32_t>(levels.size());
+
+  std::vector<LevelHeader> levelHeaders(levels.size());
+  uint64_t offset = sizeof(FileHeader) + levels.size() * sizeof(LevelHeader);
+  for (size_t i = 0; i < levels.size(); ++i) {
+    levelHeaders[i].offset = offset;
+    levelHeaders[i].size = levels[i].size();
+    levelHeaders[i].width = std::max(width >> i, 1u);
+    levelHeaders[i].height = std::max(height >> i, 1u);
+    offset += levels[i].size();
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof header);
+  out.write(reinterpret_cast<const char*>(levelHeaders.data()), levelHeaders.size() * sizeof(LevelHeader));
+  for (const auto& level : levels) {
+    out.write(reinterpret_cast<const char*>(level.data()), level.size());
+  }
+  return static_cast<bool>(out);
+}
+
+size_t CookedTexture::getSize(void) const {
+  size_t size = 0;
+  for (const auto& level : levels) {
+    size += level.size;
+  }
+  return size;
+}
+
+bool CookedTexture::parse(void) {
+  const unsigned char* base = file->data();
+  size_t size = file->size();
+
+  if (size < sizeof(FileHeader)) {
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, base, sizeof header);
+  if (std::memcmp(header.magic, COOKED_TEXTURE_MAGIC, sizeof header.magic) != 0 || header.version != COOKED_TEXTURE_VERSION) {
+    return false;
+  }
+
+  switch (static_cast<BlockFormat>(header.format)) {
+  case BlockFormat::BC1:
+  case BlockFormat::BC3:
+  case BlockFormat::BC4:
+  case BlockFormat::BC5:
+    format = static_cast<BlockFormat>(header.format);
+    break;
+  default:
+    return false;
+  }
+
+  if (header.levelCount == 0 || header.levelCount > (size - sizeof(FileHeader)) / sizeof(LevelHeader)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < header.levelCount; ++i) {
+    LevelHeader levelHeader;
+    std::memcpy(&levelHeader, base + sizeof(FileHeader) + i * sizeof(LevelHeader), sizeof levelHeader);
+    if (levelHeader.offset > size || levelHeader.size > size - levelHeader.offset
+        || levelHeader.size != blockFormatImageSize(format, levelHeader.width, levelHeader.height)) {
+      return false;
+    }
+    levels.push_back({ levelHeader.width, levelHeader.height, base + levelHeader.offset, static_cast<size_t>(levelHeader.size) });
+  }
+
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+
+class MappedFile;
+
+/* A texture cooked offline by `texture_cooker`: a full mip chain of
+ * block-compressed data that can be handed to `glCompressedTexImage2D` as is.
+ * The file is memory-mapped and the levels are views into the mapping. */
+class CookedTexture {
+public:
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    const unsigned char* data;
+    size_t size;
+  };
+
+  CookedTexture(const CookedTexture&) = delete;
+  CookedTexture& operator=(const CookedTexture&) = delete;
+
+  ~CookedTexture(void);
+
+  /* Cooked textures live next to their source image. */
+  static std::string pathFor(const std::string& sourcePath) {
+    return sourcePath + ".ctex";
+  }
+
+  /* Opens the cooked version of `sourcePath`, unless there is none or it is
+   * older than the source. */
+  static std::unique_ptr<CookedTexture> openFor(const std::string& sourcePath);
+
+  static std::unique_ptr<CookedTexture> open(const std::string& path);
+
+  /* `levels[0]` is the base level; each following level halves the size. */
+  static bool write(const std::string& path, BlockFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels);
+
+  BlockFormat getFormat(void) const {
+    return format;
+  }
+
+  const std::vector<Level>& getLevels(void) const {
+    return levels;
+  }
+
+  /* Total size of the compressed mip chain. */
+  size_t getSize(void) const;
+
+private:
+  explicit CookedTexture(std::unique_ptr<MappedFile> file);
+
+  bool parse(void);
+
+  std::unique_ptr<MappedFile> file;
+  BlockFormat format;
+  std::vector<Level> levels;
+};
@@ -0,0 +1,124 @@
+#include "FrameBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+/* Nearest rank, on sorted values. */
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+void writeSummary(std::ostream& out, const char* name, std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  double mean = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+  out << "  \"" << name << "\": { \"mean\": " << mean
+      << ", \"p50\": " << percentile(values, 50.0)
+      << ", \"p95\": " << percentile(values, 95.0)
+      << ", \"p99\": " << percentile(values, 99.0)
+      << ", \"max\": " << (values.empty() ? 0.0 : values.back()) << " }";
+}
+
+std::string escapeJson(const std::string& text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+} // namespace
+
+FrameBenchmark::FrameBenchmark(void) {
+  glGenQueries(QUERY_LATENCY, queries);
+}
+
+FrameBenchmark::~FrameBenchmark(void) {
+  glDeleteQueries(QUERY_LATENCY, queries);
+}
+
+void FrameBenchmark::beginFrame(void) {
+  /* The query about to be reused went out `QUERY_LATENCY` frames ago. */
+  size_t slot = frameCount % QUERY_LATENCY;
+  if (frameCount >= QUERY_LATENCY) {
+    collectGpuTime(slot);
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+  frameStart = std::chrono::steady_clock::now();
+}
+
+void FrameBenchmark::endFrame(size_t frameDrawCalls, size_t frameTriangles) {
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+  glEndQuery(GL_TIME_ELAPSED);
+  ++frameCount;
+
+  cpuTimes.push_back(elapsed.count());
+  drawCalls.push_back(static_cast<double>(frameDrawCalls));
+  triangles.push_back(static_cast<double>(frameTriangles));
+}
+
+void FrameBenchmark::record(const char* name, double value) {
+  for (auto& series : extraSeries) {
+    if (std::strcmp(series.first, name) == 0) {
+      series.second.push_back(value);
+      return;
+    }
+  }
+  extraSeries.emplace_back(name, std::vector<double>{ value });
+}
+
+void FrameBenchmark::finish(void) {
+  while (collectedCount < frameCount) {
+    collectGpuTime(collectedCount % QUERY_LATENCY);
+  }
+}
+
+void FrameBenchmark::reset(void) {
+  finish();
+  frameCount = 0;
+  collectedCount = 0;
+  cpuTimes.clear();
+  gpuTimes.clear();
+  drawCalls.clear();
+  triangles.clear();
+  extraSeries.clear();
+}
+
+void FrameBenchmark::collectGpuTime(size_t slot) {
+  GLuint64 nanoseconds = 0;
+  glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+  gpuTimes.push_back(nanoseconds / 1e6);
+  ++collectedCount;
+}
+
+void FrameBenchmark::writeJson(std::ostream& out, const std::string& renderer, int width, int height) const {
+  out << "{\n"
+      << "  \"renderer\": \"" << escapeJson(renderer) << "\",\n"
+      << "  \"width\": " << width << ",\n"
+      << "  \"height\": " << height << ",\n"
+      << "  \"frames\": " << frameCount << ",\n";
+  writeSummary(out, "cpuFrameTimeMs", cpuTimes);
+  out << ",\n";
+  writeSummary(out, "gpuFrameTimeMs", gpuTimes);
+  out << ",\n";
+  writeSummary(out, "drawCalls", drawCalls);
+  out << ",\n";
+  writeSummary(out, "triangles", triangles);
+  for (const auto& series : extraSeries) {
+    out << ",\n";
+    writeSummary(out, series.first, series.second);
+  }
+  out << "\n}" << std::endl;
+}
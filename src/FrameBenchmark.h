@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+/* Records the CPU and GPU time and the draw calls of every frame between
+ * `beginFrame` and `endFrame`, and summarises them as percentiles.
+ *
+ * GPU times come from timer queries that are read back a few frames late,
+ * by which time they are normally available, so measuring doesn't stall the
+ * pipeline it measures. */
+class FrameBenchmark {
+public:
+  FrameBenchmark(const FrameBenchmark&) = delete;
+  FrameBenchmark& operator=(const FrameBenchmark&) = delete;
+
+  /* Needs a current context. */
+  FrameBenchmark(void);
+  ~FrameBenchmark(void);
+
+  void beginFrame(void);
+  void endFrame(size_t frameDrawCalls, size_t frameTriangles);
+
+  /* Adds this frame's value to a series of the caller's, reported after the
+   * built-in ones. `name` must outlive the benchmark. */
+  void record(const char* name, double value);
+
+  /* Collects the GPU times still in flight. Call after the last frame. */
+  void finish(void);
+
+  /* Drops everything recorded so far, e.g. after warming up. Some drivers
+   * report nonsense for their very first timer query, so warm-up frames
+   * should be measured and dropped rather than not measured. */
+  void reset(void);
+
+  /* One object, with the mean, p50, p95, p99 and maximum of each series. */
+  void writeJson(std::ostream& out, const std::string& renderer, int width, int height) const;
+
+private:
+  /* Frames between issuing a query and reading it back. */
+  static constexpr size_t QUERY_LATENCY = 4;
+
+  void collectGpuTime(size_t slot);
+
+  GLuint queries[QUERY_LATENCY];
+  size_t frameCount = 0;
+  size_t collectedCount = 0;
+  std::chrono::steady_clock::time_point frameStart;
+
+  std::vector<double> cpuTimes;
+  std::vector<double> gpuTimes;
+  std::vector<double> drawCalls;
+  std::vector<double> triangles;
+  std::vector<std::pair<const char*, std::vector<double>>> extraSeries;
+};
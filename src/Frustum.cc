@@ -0,0 +1,60 @@
+#include "Frustum.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& matrix) {
+  /* glm matrices are column-major, so row `i` is `matrix[*][i]`. */
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+  }
+
+  Frustum frustum;
+  frustum.planes[PLANE_LEFT] = rows[3] + rows[0];
+  frustum.planes[PLANE_RIGHT] = rows[3] - rows[0];
+  frustum.planes[PLANE_BOTTOM] = rows[3] + rows[1];
+  frustum.planes[PLANE_TOP] = rows[3] - rows[1];
+  frustum.planes[PLANE_NEAR] = rows[3] + rows[2];
+  frustum.planes[PLANE_FAR] = rows[3] - rows[2];
+
+  /* Normalised planes give true distances, which sphere tests need. */
+  for (auto& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+  glm::vec3 center = box.getCenter();
+  glm::vec3 extents = box.getExtents();
+  for (const auto& plane : planes) {
+    glm::vec3 normal(plane);
+    /* The box is outside if even its corner farthest along the normal is
+     * behind the plane. */
+    if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extents) < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::contains(const BoundingBox& box) const {
+  glm::vec3 center = box.getCenter();
+  glm::vec3 extents = box.getExtents();
+  for (const auto& plane : planes) {
+    glm::vec3 normal(plane);
+    /* Inside only if even the corner farthest against the normal is in
+     * front of every plane. */
+    if (glm::dot(normal, center) + plane.w - glm::dot(glm::abs(normal), extents) < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+  for (const auto& plane : planes) {
+    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+/* The six planes of a view volume, pointing inwards, stored as
+ * (normal, distance) so that `dot(plane, vec4(point, 1)) >= 0` holds for
+ * points inside. */
+class Frustum {
+public:
+  enum Plane {
+    PLANE_LEFT,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR,
+  };
+
+  /* Extracts the planes from a combined projection * view (* model) matrix
+   * (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+   * World-View-Projection Matrix", 2001). The planes are in the space the
+   * matrix transforms from. */
+  static Frustum fromMatrix(const glm::mat4& matrix);
+
+  /* Conservative: boxes and spheres straddling a corner of the frustum may
+   * pass although they are outside. */
+  bool intersects(const BoundingBox& box) const;
+  bool intersects(const BoundingSphere& sphere) const;
+
+  /* Exact: whether `box` lies entirely inside, so that nothing within it
+   * needs testing. */
+  bool contains(const BoundingBox& box) const;
+
+  const std::array<glm::vec4, 6>& getPlanes(void) const {
+    return planes;
+  }
+
+private:
+  std::array<glm::vec4, 6> planes;
+};
@@ -0,0 +1,138 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#include "Profiler.h"
+#include "SimdLanes.h"
+
+namespace {
+
+constexpr size_t BOX_LIST_PADDING = 8;
+
+FrustumCuller::Statistics currentFrame = { 0, 0 };
+FrustumCuller::Statistics lastFrame = { 0, 0 };
+
+} // namespace
+
+uint32_t BoundingBoxList::add(const BoundingBox& box) {
+  uint32_t index = static_cast<uint32_t>(count++);
+  size_t paddedCount = (count + BOX_LIST_PADDING - 1) / BOX_LIST_PADDING * BOX_LIST_PADDING;
+  if (paddedCount > centerX.size()) {
+    for (auto* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+      component->resize(paddedCount, 0.0f);
+    }
+  }
+  set(index, box);
+  return index;
+}
+
+void BoundingBoxList::set(uint32_t index, const BoundingBox& box) {
+  glm::vec3 center = box.getCenter();
+  glm::vec3 extents = box.getExtents();
+  centerX[index] = center.x;
+  centerY[index] = center.y;
+  centerZ[index] = center.z;
+  extentX[index] = extents.x;
+  extentY[index] = extents.y;
+  extentZ[index] = extents.z;
+}
+
+void BoundingBoxList::clear(void) {
+  count = 0;
+  for (auto* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+    component->clear();
+  }
+}
+
+void FrustumCuller::cull(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& outVisible,
+                         bool counted) {
+  ProfileScope profileScope("Frustum culling");
+#if defined(SIMD_LANES)
+  const auto& planes = frustum.getPlanes();
+
+  /* Splat each plane, and its absolute normal, across the lanes once. */
+  Lanes planeX[6], planeY[6], planeZ[6], planeW[6];
+  Lanes absX[6], absY[6], absZ[6];
+  for (int p = 0; p < 6; ++p) {
+    planeX[p] = Lanes::splat(planes[p].x);
+    planeY[p] = Lanes::splat(planes[p].y);
+    planeZ[p] = Lanes::splat(planes[p].z);
+    planeW[p] = Lanes::splat(planes[p].w);
+    absX[p] = Lanes::splat(std::abs(planes[p].x));
+    absY[p] = Lanes::splat(std::abs(planes[p].y));
+    absZ[p] = Lanes::splat(std::abs(planes[p].z));
+  }
+
+  size_t count = boxes.size();
+  size_t visible = 0;
+  for (size_t i = 0; i < count; i += Lanes::WIDTH) {
+    Lanes cx = Lanes::load(&boxes.centerX[i]);
+    Lanes cy = Lanes::load(&boxes.centerY[i]);
+    Lanes cz = Lanes::load(&boxes.centerZ[i]);
+    Lanes ex = Lanes::load(&boxes.extentX[i]);
+    Lanes ey = Lanes::load(&boxes.extentY[i]);
+    Lanes ez = Lanes::load(&boxes.extentZ[i]);
+
+    /* A box is outside if, for any plane, dot(n, c) + d + dot(|n|, e) < 0. */
+    Lanes outside = Lanes::allClear();
+    for (int p = 0; p < 6; ++p) {
+      Lanes distance = planeX[p] * cx + planeY[p] * cy + planeZ[p] * cz + planeW[p];
+      Lanes radius = absX[p] * ex + absY[p] * ey + absZ[p] * ez;
+      outside = outside | lessThanZero(distance + radius);
+    }
+
+    unsigned int visibleMask = ~signMask(outside) & ((1u << Lanes::WIDTH) - 1);
+    for (unsigned int lane = 0; visibleMask != 0; ++lane, visibleMask >>= 1) {
+      /* Padding lanes past the end are dropped here. */
+      if ((visibleMask & 1u) != 0 && i + lane < count) {
+        outVisible.push_back(static_cast<uint32_t>(i + lane));
+        ++visible;
+      }
+    }
+  }
+
+  if (counted) {
+    FrustumCuller::count(visible, count - visible);
+  }
+#else
+  cullScalar(frustum, boxes, outVisible, counted);
+#endif
+}
+
+void FrustumCuller::cullScalar(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& outVisible,
+                               bool counted) {
+  const auto& planes = frustum.getPlanes();
+  size_t visible = 0;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    bool outside = false;
+    for (const auto& plane : planes) {
+      float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+      float radius = std::abs(plane.x) * boxes.extentX[i] + std::abs(plane.y) * boxes.extentY[i] + std::abs(plane.z) * boxes.extentZ[i];
+      if (distance + radius < 0.0f) {
+        outside = true;
+        break;
+      }
+    }
+    if (!outside) {
+      outVisible.push_back(static_cast<uint32_t>(i));
+      ++visible;
+    }
+  }
+  if (counted) {
+    count(visible, boxes.size() - visible);
+  }
+}
+
+void FrustumCuller::count(size_t visible, size_t culled) {
+  currentFrame.visible += visible;
+  currentFrame.culled += culled;
+}
+
+void FrustumCuller::endFrame(void) {
+  lastFrame = currentFrame;
+  currentFrame = { 0, 0 };
+}
+
+const FrustumCuller::Statistics& FrustumCuller::getFrameStatistics(void) {
+  return lastFrame;
+}
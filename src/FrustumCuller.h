@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+/* Axis-aligned boxes stored as centres and half extents, one array per
+ * component, so that `FrustumCuller` can test several boxes per SIMD
+ * instruction. */
+class BoundingBoxList {
+public:
+  uint32_t add(const BoundingBox& box);
+  void set(uint32_t index, const BoundingBox& box);
+
+  void clear(void);
+
+  size_t size(void) const {
+    return count;
+  }
+
+private:
+  friend class FrustumCuller;
+
+  size_t count = 0;
+  /* Padded to a multiple of 8, so the kernels can always load full vectors;
+   * results for the padding are discarded. */
+  std::vector<float> centerX, centerY, centerZ;
+  std::vector<float> extentX, extentY, extentZ;
+};
+
+class FrustumCuller {
+public:
+  struct Statistics {
+    size_t visible;
+    size_t culled;
+  };
+
+  /* Appends the indices of the boxes that intersect `frustum` to
+   * `outVisible`, in increasing order. Uses AVX when compiled for it and
+   * SSE2 otherwise, testing eight or four boxes at a time. Unless `counted`,
+   * the boxes are left out of the frame statistics, which are meant for the
+   * camera's view rather than e.g. shadow passes. */
+  static void cull(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& outVisible,
+                   bool counted = true);
+
+  /* One box at a time, for comparison. Gives the same result as `cull`. */
+  static void cullScalar(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& outVisible,
+                         bool counted = true);
+
+  /* For culling done outside of `cull`, e.g. single objects. */
+  static void count(size_t visible, size_t culled);
+
+  /* Closes the current frame's statistics. */
+  static void endFrame(void);
+
+  /* Boxes that passed and failed during the last completed frame. */
+  static const Statistics& getFrameStatistics(void);
+};
@@ -0,0 +1,59 @@
+#include "GLExtensions.h"
+
+#include <string>
+#include <unordered_set>
+
+bool GLExtensions::isSupported(const char* name) {
+  static const std::unordered_set<std::string> extensions = [](void) {
+    std::unordered_set<std::string> names;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+      const GLubyte* extension = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+      if (extension != NULL) {
+        names.emplace(reinterpret_cast<const char*>(extension));
+      }
+    }
+    return names;
+  }();
+  return extensions.count(name) != 0;
+}
+
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC GLExtensions::multiDrawElementsIndirect = nullptr;
+PFNGLGETPROGRAMBINARYPROC GLExtensions::getProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC GLExtensions::programBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC GLExtensions::programParameteri = nullptr;
+PFNGLTEXSTORAGE2DPROC GLExtensions::texStorage2D = nullptr;
+PFNGLINVALIDATEFRAMEBUFFERPROC GLExtensions::invalidateFramebuffer = nullptr;
+PFNGLPUSHDEBUGGROUPPROC GLExtensions::pushDebugGroup = nullptr;
+PFNGLPOPDEBUGGROUPPROC GLExtensions::popDebugGroup = nullptr;
+
+void GLExtensions::load(GLADloadproc loader) {
+  if (isSupported("GL_ARB_draw_indirect") && isSupported("GL_ARB_multi_draw_indirect")) {
+    multiDrawElementsIndirect = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>(loader("glMultiDrawElementsIndirect"));
+  }
+  if (isSupported("GL_ARB_get_program_binary")) {
+    getProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(loader("glGetProgramBinary"));
+    programBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(loader("glProgramBinary"));
+    programParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(loader("glProgramParameteri"));
+    if (!getProgramBinary || !programBinary || !programParameteri) {
+      getProgramBinary = nullptr;
+      programBinary = nullptr;
+      programParameteri = nullptr;
+    }
+  }
+  if (isSupported("GL_ARB_texture_storage")) {
+    texStorage2D = reinterpret_cast<PFNGLTEXSTORAGE2DPROC>(loader("glTexStorage2D"));
+  }
+  if (isSupported("GL_ARB_invalidate_subdata")) {
+    invalidateFramebuffer = reinterpret_cast<PFNGLINVALIDATEFRAMEBUFFERPROC>(loader("glInvalidateFramebuffer"));
+  }
+  if (isSupported("GL_KHR_debug")) {
+    pushDebugGroup = reinterpret_cast<PFNGLPUSHDEBUGGROUPPROC>(loader("glPushDebugGroup"));
+    popDebugGroup = reinterpret_cast<PFNGLPOPDEBUGGROUPPROC>(loader("glPopDebugGroup"));
+    if (!pushDebugGroup || !popDebugGroup) {
+      pushDebugGroup = nullptr;
+      popDebugGroup = nullptr;
+    }
+  }
+}
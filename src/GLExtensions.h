@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/* Our GLAD loader is generated for the plain OpenGL 3.3 core profile, so
+ * anything beyond that has to be detected (and declared) by hand. */
+
+/* GL_EXT_texture_compression_s3tc */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/* GL_ARB_draw_indirect, GL_ARB_multi_draw_indirect */
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+/* GL_ARB_get_program_binary */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+#endif
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+/* GL_ARB_texture_storage */
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+
+/* GL_KHR_debug */
+#ifndef GL_DEBUG_SOURCE_APPLICATION
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#endif
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+
+/* GL_ARB_invalidate_subdata */
+typedef void (APIENTRYP PFNGLINVALIDATEFRAMEBUFFERPROC)(GLenum target, GLsizei numAttachments, const GLenum* attachments);
+
+/* The layout `glMultiDrawElementsIndirect` reads from the indirect buffer. */
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+class GLExtensions {
+public:
+  /* Whether the current context advertises the named extension. The list is
+   * queried once, on first use. */
+  static bool isSupported(const char* name);
+
+  /* Resolves the entry points below. Call once, right after GLAD has been
+   * initialised; entry points of unsupported extensions are left null. */
+  static void load(GLADloadproc loader);
+
+  static PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect;
+
+  /* All three, or none. Drivers may still offer no binary formats. */
+  static PFNGLGETPROGRAMBINARYPROC getProgramBinary;
+  static PFNGLPROGRAMBINARYPROC programBinary;
+  static PFNGLPROGRAMPARAMETERIPROC programParameteri;
+
+  static PFNGLTEXSTORAGE2DPROC texStorage2D;
+
+  /* Only a hint, so there's nothing to do without it. */
+  static PFNGLINVALIDATEFRAMEBUFFERPROC invalidateFramebuffer;
+
+  /* Both, or neither. Groups show up as labels in GL debuggers. */
+  static PFNGLPUSHDEBUGGROUPPROC pushDebugGroup;
+  static PFNGLPOPDEBUGGROUPPROC popDebugGroup;
+};
@@ -0,0 +1,205 @@
+#include "GLState.h"
+
+namespace {
+
+constexpr GLuint MAX_TEXTURE_UNITS = 32;
+
+/* Texture targets we shadow; bindings to any other target are always
+ * issued. */
+constexpr GLenum TEXTURE_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_BUFFER };
+constexpr size_t TEXTURE_TARGET_COUNT = sizeof TEXTURE_TARGETS / sizeof TEXTURE_TARGETS[0];
+
+/* `UNKNOWN` never matches a real value, so the first call after an
+ * invalidation always goes through. */
+constexpr GLuint UNKNOWN = ~0u;
+
+/* Plain data only, so it is still usable from other static destructors at
+ * exit. */
+struct Shadow {
+  GLuint program;
+  GLuint vertexArray;
+  GLuint activeUnit;
+  GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+  GLuint depthTest;
+  GLuint depthFunc;
+  GLuint depthMask;
+  GLuint blend;
+  GLuint blendSourceFactor;
+  GLuint blendDestinationFactor;
+};
+
+Shadow defaultShadow(void) {
+  Shadow shadow = {};
+  shadow.depthFunc = GL_LESS;
+  shadow.depthMask = GL_TRUE;
+  shadow.blendSourceFactor = GL_ONE;
+  shadow.blendDestinationFactor = GL_ZERO;
+  return shadow;
+}
+
+Shadow shadow = defaultShadow();
+GLState::Statistics currentFrame = { 0, 0, 0, 0 };
+GLState::Statistics lastFrame = { 0, 0, 0, 0 };
+
+/* Updates `value` and returns true if the call has to be issued. */
+bool change(GLuint& value, GLuint newValue) {
+  if (value == newValue) {
+    ++currentFrame.skipped;
+    return false;
+  }
+  value = newValue;
+  ++currentFrame.issued;
+  return true;
+}
+
+int textureTargetIndex(GLenum target) {
+  for (size_t i = 0; i < TEXTURE_TARGET_COUNT; ++i) {
+    if (TEXTURE_TARGETS[i] == target) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void activateUnit(GLuint unit) {
+  if (change(shadow.activeUnit, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void setCapability(GLenum capability, GLuint& value, bool enabled) {
+  if (change(value, enabled ? GL_TRUE : GL_FALSE)) {
+    if (enabled) {
+      glEnable(capability);
+    } else {
+      glDisable(capability);
+    }
+  }
+}
+
+} // namespace
+
+void GLState::useProgram(GLuint program) {
+  if (change(shadow.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+  if (change(shadow.vertexArray, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  int targetIndex = textureTargetIndex(target);
+  if (unit >= MAX_TEXTURE_UNITS || targetIndex < 0) {
+    shadow.activeUnit = UNKNOWN;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    currentFrame.issued += 2;
+    return;
+  }
+
+  /* Always activate the unit, even if the binding is already right: callers
+   * may follow up with texture commands that act on the active unit. */
+  activateUnit(unit);
+  if (change(shadow.textures[unit][targetIndex], texture)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void GLState::setDepthTest(bool enabled) {
+  setCapability(GL_DEPTH_TEST, shadow.depthTest, enabled);
+}
+
+void GLState::setDepthFunc(GLenum func) {
+  if (change(shadow.depthFunc, func)) {
+    glDepthFunc(func);
+  }
+}
+
+void GLState::setDepthMask(bool enabled) {
+  if (change(shadow.depthMask, enabled ? GL_TRUE : GL_FALSE)) {
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void GLState::setBlend(bool enabled) {
+  setCapability(GL_BLEND, shadow.blend, enabled);
+}
+
+void GLState::setBlendFunc(GLenum sourceFactor, GLenum destinationFactor) {
+  if (shadow.blendSourceFactor == sourceFactor && shadow.blendDestinationFactor == destinationFactor) {
+    ++currentFrame.skipped;
+    return;
+  }
+  shadow.blendSourceFactor = sourceFactor;
+  shadow.blendDestinationFactor = destinationFactor;
+  ++currentFrame.issued;
+  glBlendFunc(sourceFactor, destinationFactor);
+}
+
+void GLState::deleteProgram(GLuint program) {
+  glDeleteProgram(program);
+  if (shadow.program == program) {
+    shadow.program = UNKNOWN;
+  }
+}
+
+void GLState::deleteVertexArray(GLuint vertexArray) {
+  glDeleteVertexArrays(1, &vertexArray);
+  if (shadow.vertexArray == vertexArray) {
+    shadow.vertexArray = 0;
+  }
+}
+
+void GLState::deleteTexture(GLuint texture) {
+  glDeleteTextures(1, &texture);
+  for (auto& unit : shadow.textures) {
+    for (auto& binding : unit) {
+      if (binding == texture) {
+        binding = 0;
+      }
+    }
+  }
+}
+
+void GLState::invalidate(void) {
+  shadow.program = UNKNOWN;
+  shadow.vertexArray = UNKNOWN;
+  shadow.activeUnit = UNKNOWN;
+  for (auto& unit : shadow.textures) {
+    for (auto& binding : unit) {
+      binding = UNKNOWN;
+    }
+  }
+  shadow.depthTest = UNKNOWN;
+  shadow.depthFunc = UNKNOWN;
+  shadow.depthMask = UNKNOWN;
+  shadow.blend = UNKNOWN;
+  shadow.blendSourceFactor = UNKNOWN;
+  shadow.blendDestinationFactor = UNKNOWN;
+}
+
+void GLState::countCall(bool skipped) {
+  if (skipped) {
+    ++currentFrame.skipped;
+  } else {
+    ++currentFrame.issued;
+  }
+}
+
+void GLState::countDraw(size_t triangles) {
+  currentFrame.triangles += triangles;
+  ++currentFrame.draws;
+}
+
+void GLState::endFrame(void) {
+  lastFrame = currentFrame;
+  currentFrame = { 0, 0, 0, 0 };
+}
+
+const GLState::Statistics& GLState::getFrameStatistics(void) {
+  return lastFrame;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+/* Shadows the bits of OpenGL state we change per draw and drops calls that
+ * would set them to the value they already have. Every change to this state
+ * must go through here, or the shadow goes stale; code that can't (e.g. a
+ * third-party library) must call `invalidate` afterwards.
+ *
+ * The shadow starts out with the state of a freshly created context. */
+class GLState {
+public:
+  struct Statistics {
+    size_t issued;
+    size_t skipped;
+    size_t triangles;
+    size_t draws;
+  };
+
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vertexArray);
+
+  /* Also leaves `unit` active, so follow-up texture commands affect
+   * `texture`. */
+  static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+  static void setDepthTest(bool enabled);
+  static void setDepthFunc(GLenum func);
+  static void setDepthMask(bool enabled);
+  static void setBlend(bool enabled);
+  static void setBlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+  /* Deleting an object unbinds it, and its name may be handed out again, so
+   * deletions have to update the shadow as well. */
+  static void deleteProgram(GLuint program);
+  static void deleteVertexArray(GLuint vertexArray);
+  static void deleteTexture(GLuint texture);
+
+  /* Forgets everything, so the next call of each kind is issued. */
+  static void invalidate(void);
+
+  /* For state shadowed elsewhere, e.g. uniform values. */
+  static void countCall(bool skipped);
+
+  /* Called by everything that draws, once per call submitted to the driver,
+   * so the totals per frame can be reported. */
+  static void countDraw(size_t triangles);
+
+  /* Closes the current frame's statistics. */
+  static void endFrame(void);
+
+  /* Calls issued and skipped, and triangles and draw calls submitted, during
+   * the last completed frame. */
+  static const Statistics& getFrameStatistics(void);
+};
@@ -0,0 +1,285 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "GLState.h"
+
+namespace {
+
+/* Replaces `buffer` with a new one of `newSize` bytes holding the first
+ * `copySize` bytes of the old one. */
+GLuint reallocateBuffer(GLuint buffer, size_t copySize, size_t newSize) {
+  GLuint newBuffer;
+  glGenBuffers(1, &newBuffer);
+  /* The copy targets don't touch any VAO's state, unlike
+   * `GL_ELEMENT_ARRAY_BUFFER`. */
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+  if (buffer != 0) {
+    if (copySize != 0) {
+      glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copySize);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return newBuffer;
+}
+
+} // namespace
+
+bool GeometryArena::FreeList::allocate(GLuint count, GLuint& outOffset) {
+  for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+    if (it->second < count) {
+      continue;
+    }
+    outOffset = it->first;
+    GLuint remaining = it->second - count;
+    ranges.erase(it);
+    if (remaining != 0) {
+      ranges.emplace(outOffset + count, remaining);
+    }
+    freeCount -= count;
+    return true;
+  }
+  return false;
+}
+
+GLuint GeometryArena::FreeList::extend(GLuint count) {
+  GLuint offset = end;
+  end += count;
+  return offset;
+}
+
+void GeometryArena::FreeList::free(GLuint offset, GLuint count) {
+  if (count == 0) {
+    return;
+  }
+
+  auto next = ranges.lower_bound(offset);
+  if (next != ranges.end() && offset + count == next->first) {
+    count += next->second;
+    freeCount -= next->second;
+    next = ranges.erase(next);
+  }
+  if (next != ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      count += prev->second;
+      freeCount -= prev->second;
+      ranges.erase(prev);
+    }
+  }
+
+  if (offset + count == end) {
+    end = offset;
+  } else {
+    ranges.emplace(offset, count);
+    freeCount += count;
+  }
+}
+
+void GeometryArena::FreeList::clear(GLuint newEnd) {
+  ranges.clear();
+  end = newEnd;
+  freeCount = 0;
+}
+
+GeometryArena::GeometryArena(size_t vertexStride, GLuint (*setupAttributes)(GLuint, GLuint))
+  : vertexStride(vertexStride)
+  , setupAttributes(setupAttributes) {
+  glGenVertexArrays(1, &VAO);
+}
+
+GeometryArena::~GeometryArena(void) {
+  GLState::deleteVertexArray(VAO);
+  if (VBO != 0) {
+    glDeleteBuffers(1, &VBO);
+  }
+  if (EBO != 0) {
+    glDeleteBuffers(1, &EBO);
+  }
+  if (indirectBuffer != 0) {
+    glDeleteBuffers(1, &indirectBuffer);
+  }
+}
+
+GeometryArena::Handle GeometryArena::allocate(const void* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount) {
+  Allocation allocation;
+  allocation.vertexCount = static_cast<GLuint>(vertexCount);
+  allocation.indexCount = static_cast<GLuint>(indexCount);
+
+  GLuint vertexOffset, indexOffset;
+  if (!vertexRanges.allocate(allocation.vertexCount, vertexOffset)) {
+    vertexOffset = vertexRanges.extend(allocation.vertexCount);
+  }
+  if (!indexRanges.allocate(allocation.indexCount, indexOffset)) {
+    indexOffset = indexRanges.extend(allocation.indexCount);
+  }
+  allocation.baseVertex = static_cast<GLint>(vertexOffset);
+  allocation.firstIndex = indexOffset;
+
+  reserve(vertexRanges.getEnd(), indexRanges.getEnd());
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * vertexStride, vertexCount * vertexStride, vertices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(GLuint), indexCount * sizeof(GLuint), indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  Handle handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+    allocations[handle] = allocation;
+    live[handle] = true;
+  } else {
+    handle = static_cast<Handle>(allocations.size());
+    allocations.push_back(allocation);
+    live.push_back(true);
+  }
+  return handle;
+}
+
+void GeometryArena::free(Handle handle) {
+  const Allocation& allocation = allocations[handle];
+  vertexRanges.free(static_cast<GLuint>(allocation.baseVertex), allocation.vertexCount);
+  indexRanges.free(allocation.firstIndex, allocation.indexCount);
+  live[handle] = false;
+  freeHandles.push_back(handle);
+
+  if (vertexRanges.getFreeCount() * 2 > vertexRanges.getEnd() || indexRanges.getFreeCount() * 2 > indexRanges.getEnd()) {
+    compact();
+  }
+}
+
+void GeometryArena::compact(void) {
+  if (vertexRanges.getFreeCount() == 0 && indexRanges.getFreeCount() == 0) {
+    return;
+  }
+
+  /* Copy the live allocations into new buffers that are just big enough,
+   * which also hands the memory of unloaded meshes back to the driver. */
+  size_t vertexCount = vertexRanges.getEnd() - vertexRanges.getFreeCount();
+  size_t indexCount = indexRanges.getEnd() - indexRanges.getFreeCount();
+
+  GLuint newVBO = reallocateBuffer(0, 0, vertexCount * vertexStride);
+  GLuint newEBO = reallocateBuffer(0, 0, indexCount * sizeof(GLuint));
+
+  GLuint vertexOffset = 0;
+  GLuint indexOffset = 0;
+  for (size_t i = 0; i < allocations.size(); ++i) {
+    if (!live[i]) {
+      continue;
+    }
+    Allocation& allocation = allocations[i];
+
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.baseVertex * vertexStride,
+                        vertexOffset * vertexStride, allocation.vertexCount * vertexStride);
+    glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.firstIndex * sizeof(GLuint),
+                        indexOffset * sizeof(GLuint), allocation.indexCount * sizeof(GLuint));
+
+    /* Indices are relative to the base vertex, so they stay as they are. */
+    allocation.baseVertex = static_cast<GLint>(vertexOffset);
+    allocation.firstIndex = indexOffset;
+    vertexOffset += allocation.vertexCount;
+    indexOffset += allocation.indexCount;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  VBO = newVBO;
+  EBO = newEBO;
+  vertexCapacity = vertexCount;
+  indexCapacity = indexCount;
+  vertexRanges.clear(vertexOffset);
+  indexRanges.clear(indexOffset);
+
+  bindVertexArray();
+}
+
+void GeometryArena::draw(const Handle* handles, const IndexRange* ranges, size_t count) const {
+  if (count == 0) {
+    return;
+  }
+
+  GLState::bindVertexArray(VAO);
+
+  auto rangeOf = [this, handles, ranges](size_t i) {
+    const Allocation& allocation = allocations[handles[i]];
+    return ranges ? IndexRange{ allocation.firstIndex + ranges[i].first, ranges[i].count }
+                  : IndexRange{ allocation.firstIndex, allocation.indexCount };
+  };
+
+  size_t indexCount = 0;
+  if (GLExtensions::multiDrawElementsIndirect != nullptr) {
+    drawCommands.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      IndexRange range = rangeOf(i);
+      drawCommands[i] = { range.count, 1, range.first, allocations[handles[i]].baseVertex, 0 };
+      indexCount += range.count;
+    }
+    if (indirectBuffer == 0) {
+      glGenBuffers(1, &indirectBuffer);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    /* Respecifying the whole store lets the driver hand us a fresh one
+     * instead of waiting for last frame's draws to finish reading it. */
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawElementsIndirectCommand), drawCommands.data(), GL_STREAM_DRAW);
+    GLExtensions::multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, static_cast<GLsizei>(count), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  } else {
+    drawCounts.resize(count);
+    drawOffsets.resize(count);
+    drawBaseVertices.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      IndexRange range = rangeOf(i);
+      drawCounts[i] = static_cast<GLsizei>(range.count);
+      drawOffsets[i] = (void*)(range.first * sizeof(GLuint));
+      drawBaseVertices[i] = allocations[handles[i]].baseVertex;
+      indexCount += range.count;
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                  static_cast<GLsizei>(count), drawBaseVertices.data());
+  }
+  GLState::countDraw(indexCount / 3);
+}
+
+void GeometryArena::reserve(size_t vertexCount, size_t indexCount) {
+  bool reallocated = false;
+  if (vertexCount > vertexCapacity || VBO == 0) {
+    size_t newCapacity = std::max(vertexCount, vertexCapacity * 2);
+    VBO = reallocateBuffer(VBO, vertexCapacity * vertexStride, newCapacity * vertexStride);
+    vertexCapacity = newCapacity;
+    reallocated = true;
+  }
+  if (indexCount > indexCapacity || EBO == 0) {
+    size_t newCapacity = std::max(indexCount, indexCapacity * 2);
+    EBO = reallocateBuffer(EBO, indexCapacity * sizeof(GLuint), newCapacity * sizeof(GLuint));
+    indexCapacity = newCapacity;
+    reallocated = true;
+  }
+  if (reallocated) {
+    bindVertexArray();
+  }
+}
+
+void GeometryArena::bindVertexArray(void) {
+  /* Attribute pointers capture the buffer bound at the time they are set, so
+   * they have to be respecified whenever the vertex buffer is replaced. */
+  GLState::bindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  setupAttributes(0, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  GLState::bindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
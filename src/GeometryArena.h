@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "VertexAttribute.h"
+
+/* Sub-allocates the geometry of many meshes that share one vertex format from
+ * a single vertex buffer, a single index buffer and a single VAO. Indices are
+ * stored relative to their mesh, and drawn with a base vertex, so a whole set
+ * of meshes can be submitted with one multi-draw call and no rebinding.
+ *
+ * Allocations are referred to by handles, which stay valid while the arena
+ * grows or compacts and the underlying offsets move. */
+class GeometryArena {
+public:
+  using Handle = uint32_t;
+
+  struct Allocation {
+    GLint baseVertex;
+    GLuint vertexCount;
+    GLuint firstIndex;
+    GLuint indexCount;
+  };
+
+  template <typename VertexType>
+  static std::unique_ptr<GeometryArena> create(void) {
+    return std::unique_ptr<GeometryArena>(new GeometryArena(sizeof(VertexType), &setupVertexAttributes<VertexType>));
+  }
+
+  /* One arena per vertex type, kept alive by whoever currently holds it, so
+   * that the GL objects go away with the last model that uses them. */
+  template <typename VertexType>
+  static std::shared_ptr<GeometryArena> shared(void) {
+    static std::weak_ptr<GeometryArena> instance;
+    std::shared_ptr<GeometryArena> arena = instance.lock();
+    if (!arena) {
+      arena = create<VertexType>();
+      instance = arena;
+    }
+    return arena;
+  }
+
+  GeometryArena(const GeometryArena&) = delete;
+  GeometryArena& operator=(const GeometryArena&) = delete;
+
+  ~GeometryArena(void);
+
+  /* Copies the vertices and indices into the arena, growing it if needed. */
+  Handle allocate(const void* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount);
+
+  void free(Handle handle);
+
+  const Allocation& get(Handle handle) const {
+    return allocations[handle];
+  }
+
+  /* Moves all live allocations to the front of the buffers, closing the holes
+   * left by `free`. Also runs automatically once more than half of the used
+   * space is holes. */
+  void compact(void);
+
+  /* A run of an allocation's indices, relative to its first one, e.g. one
+   * level of detail stored after the others. */
+  struct IndexRange {
+    GLuint first;
+    GLuint count;
+  };
+
+  /* Draws the given allocations as indexed triangles with a single call.
+   * Textures and uniforms must already be set up. */
+  void draw(const Handle* handles, size_t count) const {
+    draw(handles, nullptr, count);
+  }
+
+  /* Draws only `ranges[i]` of each allocation, or all of it if `ranges` is
+   * null. */
+  void draw(const Handle* handles, const IndexRange* ranges, size_t count) const;
+
+  size_t getVertexCapacity(void) const {
+    return vertexCapacity;
+  }
+
+  size_t getIndexCapacity(void) const {
+    return indexCapacity;
+  }
+
+private:
+  /* First-fit allocator over a range of buffer elements. Freed ranges are
+   * merged with their neighbours, and ranges at the end are given back. */
+  class FreeList {
+  public:
+    bool allocate(GLuint count, GLuint& outOffset);
+    GLuint extend(GLuint count);
+    void free(GLuint offset, GLuint count);
+    void clear(GLuint newEnd);
+
+    GLuint getEnd(void) const {
+      return end;
+    }
+
+    GLuint getFreeCount(void) const {
+      return freeCount;
+    }
+
+  private:
+    std::map<GLuint, GLuint> ranges;
+    GLuint end = 0;
+    GLuint freeCount = 0;
+  };
+
+  GeometryArena(size_t vertexStride, GLuint (*setupAttributes)(GLuint, GLuint));
+
+  void reserve(size_t vertexCount, size_t indexCount);
+  void bindVertexArray(void);
+
+  size_t vertexStride;
+  GLuint (*setupAttributes)(GLuint, GLuint);
+
+  GLuint VAO = 0;
+  GLuint VBO = 0, EBO = 0;
+  size_t vertexCapacity = 0;
+  size_t indexCapacity = 0;
+
+  FreeList vertexRanges;
+  FreeList indexRanges;
+
+  std::vector<Allocation> allocations;
+  std::vector<bool> live;
+  std::vector<Handle> freeHandles;
+
+  /* Scratch space for `draw`, kept around to avoid allocating every frame. */
+  mutable std::vector<GLsizei> drawCounts;
+  mutable std::vector<const void*> drawOffsets;
+  mutable std::vector<GLint> drawBaseVertices;
+  mutable std::vector<DrawElementsIndirectCommand> drawCommands;
+  mutable GLuint indirectBuffer = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* 64-bit FNV-1a. It is tiny, has no dependencies and can be evaluated at
+ * compile time, which is all we need for cache keys. */
+constexpr uint64_t FNV1A64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV1A64_PRIME = 0x100000001b3ull;
+
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = FNV1A64_OFFSET_BASIS) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= FNV1A64_PRIME;
+  }
+  return hash;
+}
+
+constexpr uint64_t fnv1a64(const char* str, uint64_t hash = FNV1A64_OFFSET_BASIS) {
+  for (; *str != '\0'; ++str) {
+    hash ^= static_cast<unsigned char>(*str);
+    hash *= FNV1A64_PRIME;
+  }
+  return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& str, uint64_t hash = FNV1A64_OFFSET_BASIS) {
+  return fnv1a64(str.data(), str.size(), hash);
+}
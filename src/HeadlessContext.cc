@@ -0,0 +1,164 @@
+#include "HeadlessContext.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef HAS_EGL
+namespace {
+
+bool hasExtension(const char* extensions, const char* name) {
+  if (extensions == nullptr) {
+    return false;
+  }
+  size_t length = std::strlen(name);
+  for (const char* found = std::strstr(extensions, name); found != nullptr; found = std::strstr(found + length, name)) {
+    bool startsWord = found == extensions || found[-1] == ' ';
+    bool endsWord = found[length] == ' ' || found[length] == '\0';
+    if (startsWord && endsWord) {
+      return true;
+    }
+  }
+  return false;
+}
+
+EGLDisplay openDisplay(void) {
+  const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr) {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+} // namespace
+#endif
+
+HeadlessContext::~HeadlessContext(void) {
+  if (framebuffer != 0) {
+    glDeleteFramebuffers(1, &framebuffer);
+  }
+  if (colorRenderbuffer != 0) {
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+  }
+  if (depthRenderbuffer != 0) {
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+  }
+#ifdef HAS_EGL
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (surface != EGL_NO_SURFACE) {
+    eglDestroySurface(display, surface);
+  }
+  eglDestroyContext(display, context);
+  eglTerminate(display);
+#endif
+}
+
+std::unique_ptr<HeadlessContext> HeadlessContext::create(int width, int height) {
+#ifndef HAS_EGL
+  (void)width;
+  (void)height;
+  std::cerr << "Headless rendering needs EGL, which this build was configured without" << std::endl;
+  return nullptr;
+#else
+  EGLDisplay display = openDisplay();
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    std::cerr << "Failed to initialize EGL" << std::endl;
+    return nullptr;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+    eglTerminate(display);
+    return nullptr;
+  }
+
+  /* We render into our own framebuffer, so a context without any surface
+   * will do; failing that, a token pbuffer. */
+  bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE,
+  };
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+    std::cerr << "No suitable EGL configuration" << std::endl;
+    eglTerminate(display);
+    return nullptr;
+  }
+
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE,
+  };
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT) {
+    std::cerr << "Failed to create an OpenGL 3.3 core context through EGL" << std::endl;
+    eglTerminate(display);
+    return nullptr;
+  }
+
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (!surfaceless) {
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+  }
+  std::unique_ptr<HeadlessContext> headless(new HeadlessContext(display, context, surface));
+  if ((!surfaceless && surface == EGL_NO_SURFACE) || !eglMakeCurrent(display, surface, surface, context)) {
+    std::cerr << "Failed to make the EGL context current" << std::endl;
+    return nullptr;
+  }
+
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(getProcAddress))) {
+    std::cerr << "Failed to initialize GLAD" << std::endl;
+    return nullptr;
+  }
+  if (!headless->createFramebuffer(width, height)) {
+    return nullptr;
+  }
+  return headless;
+#endif
+}
+
+void* HeadlessContext::getProcAddress(const char* name) {
+#ifdef HAS_EGL
+  return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+  (void)name;
+  return nullptr;
+#endif
+}
+
+bool HeadlessContext::createFramebuffer(int width, int height) {
+  glGenRenderbuffers(1, &colorRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depthRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    return false;
+  }
+  glViewport(0, 0, width, height);
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include <glad/glad.h>
+
+/* An OpenGL 3.3 core context without a window, for rendering where there is
+ * no display, e.g. on build machines. It is created through EGL, preferring
+ * Mesa's surfaceless platform, which needs neither a display server nor a
+ * GPU: with llvmpipe it renders on the CPU.
+ *
+ * There is no default framebuffer to speak of, so the context comes with an
+ * offscreen one of the requested size, which it leaves bound. */
+class HeadlessContext {
+public:
+  HeadlessContext(const HeadlessContext&) = delete;
+  HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+  ~HeadlessContext(void);
+
+  /* Makes the context current on the calling thread and loads GLAD for it.
+   * Fails if the build has no EGL support or the driver has no suitable
+   * configuration. */
+  static std::unique_ptr<HeadlessContext> create(int width, int height);
+
+  /* For `GLExtensions::load` and other loaders. */
+  static void* getProcAddress(const char* name);
+
+  GLuint getFramebuffer(void) const {
+    return framebuffer;
+  }
+
+private:
+  HeadlessContext(void* display, void* context, void* surface)
+    : display(display)
+    , context(context)
+    , surface(surface) {}
+
+  bool createFramebuffer(int width, int height);
+
+  /* EGL handles, kept opaque so that EGL's headers stay out of ours. */
+  void* display;
+  void* context;
+  void* surface;
+
+  GLuint framebuffer = 0;
+  GLuint colorRenderbuffer = 0;
+  GLuint depthRenderbuffer = 0;
+};
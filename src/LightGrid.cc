@@ -0,0 +1,350 @@
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "GLState.h"
+#include "Profiler.h"
+#include "SimdLanes.h"
+#include "ThreadPool.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+
+namespace {
+
+/* Index of the lowest set bit; `bits` must not be 0. */
+uint32_t lowestBit(uint32_t bits) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, bits);
+  return index;
+#else
+  return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+}
+
+/* The tile of `N` across [-1, 1] that holds `ndc`, clamped to the grid. */
+uint8_t tileOf(float ndc, uint32_t n) {
+  float tile = std::floor((ndc * 0.5f + 0.5f) * n);
+  return static_cast<uint8_t>(std::min(std::max(tile, 0.0f), static_cast<float>(n - 1)));
+}
+
+/* Replaces the contents of a buffer that backs a texture buffer, orphaning
+ * the old storage like `UniformBuffer::update`. */
+void updateBuffer(GLuint buffer, size_t size) {
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  /* Some drivers reject empty texture buffers. */
+  glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 4), NULL, GL_STREAM_DRAW);
+}
+
+GLuint createTextureBuffer(GLuint unit, GLenum format, GLuint buffer) {
+  updateBuffer(buffer, 0);
+  GLuint texture;
+  glGenTextures(1, &texture);
+  GLState::bindTexture(unit, GL_TEXTURE_BUFFER, texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+  return texture;
+}
+
+size_t maxTextureBufferSize(void) {
+  static GLint size = 0;
+  if (size == 0) {
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &size);
+  }
+  return static_cast<size_t>(size);
+}
+
+} // namespace
+
+LightGrid::LightGrid(size_t threadCount)
+  : pool(threadCount > 0 ? std::make_unique<ThreadPool>(threadCount) : nullptr)
+  , clusterMinX(CLUSTERS_X * CLUSTERS_Z)
+  , clusterMaxX(CLUSTERS_X * CLUSTERS_Z)
+  , clusterMinY(CLUSTERS_Y * CLUSTERS_Z)
+  , clusterMaxY(CLUSTERS_Y * CLUSTERS_Z)
+  , grid(2 * CLUSTER_COUNT) {}
+
+LightGrid::LightGrid(void)
+  : LightGrid(ThreadPool::defaultThreadCount()) {}
+
+LightGrid::~LightGrid(void) {
+  if (lightBuffer != 0) {
+    GLState::deleteTexture(lightTexture);
+    GLState::deleteTexture(gridTexture);
+    GLState::deleteTexture(indexTexture);
+    GLuint buffers[] = { lightBuffer, gridBuffer, indexBuffer };
+    glDeleteBuffers(3, buffers);
+  }
+}
+
+void LightGrid::assign(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix,
+                       const glm::mat4& projectionMatrix, float near, float far) {
+  ProfileScope profileScope("Light assignment");
+  auto start = std::chrono::steady_clock::now();
+
+  if (projectionMatrix != boundsProjection || near != boundsNear || far != boundsFar) {
+    updateClusterBounds(projectionMatrix, near, far);
+  }
+
+  /* Where each light lands on the grid. The tile range is that of the
+   * light's view-space box, projected from its nearest and farthest depth,
+   * which is conservative without needing the exact outline of a projected
+   * sphere. */
+  float projectionX = projectionMatrix[0][0];
+  float projectionY = projectionMatrix[1][1];
+  float sliceScale = CLUSTERS_Z / std::log(far / near);
+  size_t count = std::min(lights.size(), MAX_LIGHTS);
+  visibleLights.clear();
+  for (size_t i = 0; i < count; ++i) {
+    const PointLight& light = lights[i];
+    glm::vec3 center = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+    float depth = -center.z;
+    float radius = light.radius;
+    if (depth + radius < near || depth - radius > far) {
+      continue;
+    }
+    float nearest = std::max(depth - radius, near);
+    float farthest = std::min(depth + radius, far);
+
+    float left = center.x - radius, right = center.x + radius;
+    float bottom = center.y - radius, top = center.y + radius;
+    float minX = projectionX * std::min(left / nearest, left / farthest);
+    float maxX = projectionX * std::max(right / nearest, right / farthest);
+    float minY = projectionY * std::min(bottom / nearest, bottom / farthest);
+    float maxY = projectionY * std::max(top / nearest, top / farthest);
+    if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f) {
+      continue;
+    }
+
+    auto sliceOf = [&](float sliceDepth) {
+      float slice = std::floor(std::log(sliceDepth / near) * sliceScale);
+      return static_cast<uint8_t>(std::min(std::max(slice, 0.0f), static_cast<float>(CLUSTERS_Z - 1)));
+    };
+    visibleLights.push_back({ center, radius, static_cast<uint16_t>(i),
+                              tileOf(minX, CLUSTERS_X), tileOf(maxX, CLUSTERS_X),
+                              tileOf(minY, CLUSTERS_Y), tileOf(maxY, CLUSTERS_Y),
+                              sliceOf(nearest), sliceOf(farthest) });
+  }
+
+  /* Slices are independent, and lights crowd into some more than others, so
+   * each thread takes the next unclaimed slice until none are left. */
+  std::atomic<uint32_t> nextSlice(0);
+  auto assignSlices = [this, &nextSlice](void) {
+    for (uint32_t z = nextSlice++; z < CLUSTERS_Z; z = nextSlice++) {
+      assignSlice(z);
+    }
+  };
+  std::vector<std::future<void>> helpers;
+  if (pool) {
+    for (size_t i = 0; i < pool->size(); ++i) {
+      helpers.push_back(pool->submit(assignSlices));
+    }
+  }
+  assignSlices();
+  for (auto& helper : helpers) {
+    helper.get();
+  }
+
+  statistics.lights = lights.size();
+  statistics.visibleLights = visibleLights.size();
+  statistics.lightIndices = 0;
+  for (const Slice& slice : slices) {
+    statistics.lightIndices += slice.lights.size();
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  statistics.assignmentTime = elapsed.count();
+}
+
+void LightGrid::updateClusterBounds(const glm::mat4& projectionMatrix, float near, float far) {
+  boundsProjection = projectionMatrix;
+  boundsNear = near;
+  boundsFar = far;
+
+  for (uint32_t z = 0; z <= CLUSTERS_Z; ++z) {
+    sliceDepths[z] = near * std::pow(far / near, static_cast<float>(z) / CLUSTERS_Z);
+  }
+
+  /* A tile spans [a, b] in NDC, so at depth d it spans [a, b] * d / p in
+   * view space, where p is the projection's scale along that axis. */
+  auto tileBounds = [&](uint32_t tiles, float projection, std::vector<float>& outMin, std::vector<float>& outMax) {
+    for (uint32_t z = 0; z < CLUSTERS_Z; ++z) {
+      float nearest = sliceDepths[z], farthest = sliceDepths[z + 1];
+      for (uint32_t t = 0; t < tiles; ++t) {
+        float a = -1.0f + 2.0f * t / tiles;
+        float b = -1.0f + 2.0f * (t + 1) / tiles;
+        outMin[z * tiles + t] = std::min(a * nearest, a * farthest) / projection;
+        outMax[z * tiles + t] = std::max(b * nearest, b * farthest) / projection;
+      }
+    }
+  };
+  tileBounds(CLUSTERS_X, projectionMatrix[0][0], clusterMinX, clusterMaxX);
+  tileBounds(CLUSTERS_Y, projectionMatrix[1][1], clusterMinY, clusterMaxY);
+}
+
+void LightGrid::assignSlice(uint32_t z) {
+  constexpr uint32_t SLICE_CLUSTERS = CLUSTERS_X * CLUSTERS_Y;
+  Slice& slice = slices[z];
+  slice.counts.assign(SLICE_CLUSTERS, 0);
+  slice.hits.clear();
+
+  float sliceNear = sliceDepths[z], sliceFar = sliceDepths[z + 1];
+  const float* minX = &clusterMinX[z * CLUSTERS_X];
+  const float* maxX = &clusterMaxX[z * CLUSTERS_X];
+  const float* minY = &clusterMinY[z * CLUSTERS_Y];
+  const float* maxY = &clusterMaxY[z * CLUSTERS_Y];
+
+  /* A sphere reaches into a box if the squared distances from its centre to
+   * the box along each axis add up to no more than its squared radius. Depth
+   * is the same across the slice and y across a row, which leaves x to test
+   * per cluster. */
+  for (const VisibleLight& light : visibleLights) {
+    if (z < light.z0 || z > light.z1) {
+      continue;
+    }
+    float depth = -light.center.z;
+    float dz = std::max(std::max(sliceNear - depth, depth - sliceFar), 0.0f);
+    float remaining = light.radius * light.radius - dz * dz;
+    if (remaining < 0.0f) {
+      continue;
+    }
+    uint32_t columnRange = ((2u << light.x1) - 1) & ~((1u << light.x0) - 1);
+
+    for (uint32_t y = light.y0; y <= light.y1; ++y) {
+      float dy = std::max(std::max(minY[y] - light.center.y, light.center.y - maxY[y]), 0.0f);
+      float rowRemaining = remaining - dy * dy;
+      if (rowRemaining < 0.0f) {
+        continue;
+      }
+
+      uint32_t columns = 0;
+#if defined(SIMD_LANES)
+      Lanes centerX = Lanes::splat(light.center.x);
+      Lanes limit = Lanes::splat(rowRemaining);
+      Lanes zero = Lanes::allClear();
+      for (uint32_t x = light.x0 / Lanes::WIDTH * Lanes::WIDTH; x <= light.x1; x += Lanes::WIDTH) {
+        Lanes dx = max(max(Lanes::load(&minX[x]) - centerX, centerX - Lanes::load(&maxX[x])), zero);
+        columns |= signMask(lessEqual(dx * dx, limit)) << x;
+      }
+#else
+      for (uint32_t x = light.x0; x <= light.x1; ++x) {
+        float dx = std::max(std::max(minX[x] - light.center.x, light.center.x - maxX[x]), 0.0f);
+        columns |= (dx * dx <= rowRemaining ? 1u : 0u) << x;
+      }
+#endif
+      columns &= columnRange;
+      if (columns == 0) {
+        continue;
+      }
+      slice.hits.push_back({ light.index, static_cast<uint16_t>(columns), y });
+      for (uint32_t bits = columns; bits != 0; bits &= bits - 1) {
+        ++slice.counts[y * CLUSTERS_X + lowestBit(bits)];
+      }
+    }
+  }
+
+  /* Lay the lists out back to back, then fill them in light order. */
+  slice.offsets.resize(SLICE_CLUSTERS);
+  uint32_t total = 0;
+  for (uint32_t c = 0; c < SLICE_CLUSTERS; ++c) {
+    slice.offsets[c] = total;
+    total += slice.counts[c];
+  }
+  slice.lights.resize(total);
+  std::vector<uint32_t>& cursors = slice.counts;
+  for (uint32_t c = 0; c < SLICE_CLUSTERS; ++c) {
+    cursors[c] = slice.offsets[c];
+  }
+  for (const Hit& hit : slice.hits) {
+    for (uint32_t bits = hit.columns; bits != 0; bits &= bits - 1) {
+      slice.lights[cursors[hit.row * CLUSTERS_X + lowestBit(bits)]++] = hit.light;
+    }
+  }
+  /* Turn the cursors, now at the end of each list, back into counts. */
+  for (uint32_t c = 0; c < SLICE_CLUSTERS; ++c) {
+    slice.counts[c] -= slice.offsets[c];
+  }
+}
+
+size_t LightGrid::getClusterLightCount(uint32_t cluster) const {
+  const Slice& slice = slices[cluster / (CLUSTERS_X * CLUSTERS_Y)];
+  return slice.counts[cluster % (CLUSTERS_X * CLUSTERS_Y)];
+}
+
+const uint16_t* LightGrid::getClusterLights(uint32_t cluster) const {
+  const Slice& slice = slices[cluster / (CLUSTERS_X * CLUSTERS_Y)];
+  return slice.lights.data() + slice.offsets[cluster % (CLUSTERS_X * CLUSTERS_Y)];
+}
+
+void LightGrid::upload(const std::vector<PointLight>& lights, int viewportWidth, int viewportHeight) {
+  if (lightBuffer == 0) {
+    glGenBuffers(1, &lightBuffer);
+    glGenBuffers(1, &gridBuffer);
+    glGenBuffers(1, &indexBuffer);
+    lightTexture = createTextureBuffer(LIGHT_DATA_UNIT, GL_RGBA32F, lightBuffer);
+    gridTexture = createTextureBuffer(LIGHT_CLUSTERS_UNIT, GL_RG32UI, gridBuffer);
+    indexTexture = createTextureBuffer(LIGHT_INDICES_UNIT, GL_R16UI, indexBuffer);
+    parameterBuffer = UniformBuffer::create(LIGHT_GRID_BINDING, sizeof(LightGridData));
+  }
+
+  size_t lightCount = std::min(lights.size(), MAX_LIGHTS);
+  updateBuffer(lightBuffer, lightCount * sizeof(PointLight));
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, lightCount * sizeof(PointLight), lights.data());
+
+  /* The slices' lists go into one buffer, one after the other. Texture
+   * buffers may be as small as 64K texels, in which case lists past the end
+   * get cut. */
+  size_t indexLimit = maxTextureBufferSize();
+  size_t indexCount = 0;
+  for (uint32_t z = 0; z < CLUSTERS_Z; ++z) {
+    const Slice& slice = slices[z];
+    for (uint32_t c = 0; c < CLUSTERS_X * CLUSTERS_Y; ++c) {
+      size_t offset = indexCount + slice.offsets[c];
+      size_t count = slice.counts[c];
+      if (offset + count > indexLimit) {
+        count = offset < indexLimit ? indexLimit - offset : 0;
+      }
+      uint32_t cluster = z * CLUSTERS_X * CLUSTERS_Y + c;
+      grid[2 * cluster] = static_cast<uint32_t>(std::min(offset, indexLimit));
+      grid[2 * cluster + 1] = static_cast<uint32_t>(count);
+    }
+    indexCount += slice.lights.size();
+  }
+  if (indexCount > indexLimit && !truncationReported) {
+    std::cerr << "Light lists need " << indexCount << " entries, but texture buffers hold only " << indexLimit
+              << "; some lights will be missing" << std::endl;
+    truncationReported = true;
+  }
+  updateBuffer(gridBuffer, grid.size() * sizeof(uint32_t));
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, grid.size() * sizeof(uint32_t), grid.data());
+
+  size_t uploadCount = std::min(indexCount, indexLimit);
+  updateBuffer(indexBuffer, uploadCount * sizeof(uint16_t));
+  size_t offset = 0;
+  for (const Slice& slice : slices) {
+    size_t count = std::min(slice.lights.size(), uploadCount - offset);
+    if (count > 0) {
+      glBufferSubData(GL_TEXTURE_BUFFER, offset * sizeof(uint16_t), count * sizeof(uint16_t), slice.lights.data());
+    }
+    offset += count;
+  }
+
+  GLState::bindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+  GLState::bindTexture(LIGHT_CLUSTERS_UNIT, GL_TEXTURE_BUFFER, gridTexture);
+  GLState::bindTexture(LIGHT_INDICES_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+
+  float logRatio = std::log(boundsFar / boundsNear);
+  LightGridData data;
+  data.tileScale = glm::vec2(static_cast<float>(CLUSTERS_X) / viewportWidth, static_cast<float>(CLUSTERS_Y) / viewportHeight);
+  data.sliceScale = CLUSTERS_Z / logRatio;
+  data.sliceBias = CLUSTERS_Z * std::log(boundsNear) / logRatio;
+  data.clusterCount = glm::uvec3(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+  data.lightCount = static_cast<GLuint>(lightCount);
+  parameterBuffer->update(&data, sizeof data);
+}
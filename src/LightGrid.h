@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class ThreadPool;
+class UniformBuffer;
+
+/* Mirrors the two texels a light takes in the light data buffer. */
+struct PointLight {
+  glm::vec3 position;
+  /* Where the light has faded out completely. */
+  float radius;
+  glm::vec3 color;
+  float intensity;
+};
+
+static_assert(sizeof(PointLight) == 32, "PointLight must match two RGBA32F texels");
+
+/* Clustered forward shading: the view frustum is cut into a grid of
+ * clusters, screen tiles in x and y and exponentially deeper slices in z,
+ * and every cluster gets the list of lights that reach into it. A fragment
+ * then only loops over the lights of its own cluster, so thousands of small
+ * lights cost about as much per pixel as the few that overlap it.
+ *
+ * Lights are assigned on the CPU, one depth slice per task on a pool of
+ * workers, with the clusters of a row tested against a light several at a
+ * time. The lists reach the shaders through texture buffers, see
+ * `assets/shaders/common/ClusteredLighting.glsl`. */
+class LightGrid {
+public:
+  static constexpr uint32_t CLUSTERS_X = 16;
+  static constexpr uint32_t CLUSTERS_Y = 9;
+  static constexpr uint32_t CLUSTERS_Z = 24;
+  static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+  /* Light indices are 16-bit. */
+  static constexpr size_t MAX_LIGHTS = 1 << 16;
+
+  struct Statistics {
+    size_t lights;
+    /* Lights inside the view frustum, and the entries of all cluster lists
+     * together. */
+    size_t visibleLights;
+    size_t lightIndices;
+    /* Of the last `assign`, in milliseconds. */
+    double assignmentTime;
+  };
+
+  /* `threadCount` workers help the calling thread assign lights; none
+   * assigns on the calling thread alone. */
+  explicit LightGrid(size_t threadCount);
+  LightGrid(void);
+
+  LightGrid(const LightGrid&) = delete;
+  LightGrid& operator=(const LightGrid&) = delete;
+
+  ~LightGrid(void);
+
+  /* Builds the cluster lists for a symmetric perspective projection whose
+   * depth range is `near` to `far`. Doesn't touch OpenGL, so it can run
+   * anywhere, but not concurrently with `upload`. */
+  void assign(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+              float near, float far);
+
+  /* Uploads `lights`, which must be the ones last assigned, and their
+   * cluster lists, and binds them for the shaders, which see the screen cut
+   * into tiles of a viewport of the given size. GL thread only. */
+  void upload(const std::vector<PointLight>& lights, int viewportWidth, int viewportHeight);
+
+  /* The lights reaching into a cluster, by index into the lights passed to
+   * `assign`; x varies fastest. */
+  size_t getClusterLightCount(uint32_t cluster) const;
+  const uint16_t* getClusterLights(uint32_t cluster) const;
+
+  const Statistics& getStatistics(void) const {
+    return statistics;
+  }
+
+private:
+  /* A light in view space, with the range of clusters it may touch. */
+  struct VisibleLight {
+    glm::vec3 center;
+    float radius;
+    uint16_t index;
+    uint8_t x0, x1, y0, y1, z0, z1;
+  };
+
+  /* The clusters of a row that a light reaches into. */
+  struct Hit {
+    uint16_t light;
+    /* One bit per column. */
+    uint16_t columns;
+    uint32_t row;
+  };
+
+  /* One depth slice's share of the result. */
+  struct Slice {
+    /* Per cluster of the slice: where its list starts in `lights`, and its
+     * length. */
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> counts;
+    std::vector<uint16_t> lights;
+    std::vector<Hit> hits;
+  };
+
+  void updateClusterBounds(const glm::mat4& projectionMatrix, float near, float far);
+  void assignSlice(uint32_t z);
+
+  std::unique_ptr<ThreadPool> pool;
+
+  /* The projection `clusterMinX` and so on were computed for. */
+  glm::mat4 boundsProjection = glm::mat4(0.0f);
+  float boundsNear = 0.0f;
+  float boundsFar = 0.0f;
+  /* View-space bounds of each cluster's tile, per column and slice (x across
+   * the columns of a row) and per row and slice. */
+  std::vector<float> clusterMinX, clusterMaxX;
+  std::vector<float> clusterMinY, clusterMaxY;
+  /* Depths where the slices start, and where the last one ends. */
+  float sliceDepths[CLUSTERS_Z + 1];
+
+  std::vector<VisibleLight> visibleLights;
+  Slice slices[CLUSTERS_Z];
+
+  /* Created on the first upload. */
+  GLuint lightBuffer = 0;
+  GLuint gridBuffer = 0;
+  GLuint indexBuffer = 0;
+  GLuint lightTexture = 0;
+  GLuint gridTexture = 0;
+  GLuint indexTexture = 0;
+  std::unique_ptr<UniformBuffer> parameterBuffer;
+  std::vector<uint32_t> grid;
+  bool truncationReported = false;
+
+  Statistics statistics = {};
+};
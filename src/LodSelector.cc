@@ -0,0 +1,37 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+LodSelector::LodSelector(float fovy, float viewportHeight, float threshold, float hysteresis)
+  /* Pixels covered by one world unit seen head-on at distance 1. */
+  : pixelsPerUnit(0.5f * viewportHeight / std::tan(0.5f * glm::radians(fovy)))
+  , threshold(threshold)
+  , hysteresis(hysteresis) {}
+
+float LodSelector::projectedSize(float size, float distance) const {
+  return size * pixelsPerUnit / std::max(distance, 1e-3f);
+}
+
+uint32_t LodSelector::select(const LodLevel* levels, uint32_t levelCount, float distance, float scale, uint32_t current) const {
+  if (levelCount == 0) {
+    return 0;
+  }
+
+  /* Up close, or inside the object, any error is visible. */
+  float pixelsPerError = scale * pixelsPerUnit / std::max(distance, 1e-3f);
+  auto projectedError = [&](uint32_t level) {
+    return levels[level].error * pixelsPerError;
+  };
+
+  uint32_t level = std::min(current, levelCount - 1);
+  while (level > 0 && projectedError(level) > threshold * (1.0f + hysteresis)) {
+    --level;
+  }
+  while (level + 1 < levelCount && projectedError(level + 1) < threshold * (1.0f - hysteresis)) {
+    ++level;
+  }
+  return level;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+/* One level of detail of a mesh. */
+struct LodLevel {
+  /* What to hand to the draw function in place of the full mesh. */
+  const void* object;
+  /* How far, in object space, this level may deviate from the full mesh. */
+  float error;
+  uint32_t triangleCount;
+};
+
+/* Picks levels of detail by how large their error would appear on screen:
+ * the coarsest level whose error projects to less than a pixel threshold is
+ * indistinguishable from the full mesh. Levels only change once the error
+ * moves clearly past the threshold, so objects hovering around a switching
+ * distance don't pop back and forth every frame. */
+class LodSelector {
+public:
+  /* `fovy` is the vertical field of view in degrees, as `Camera::getFovy`
+   * returns it, and `viewportHeight` in pixels. `hysteresis` widens the
+   * threshold to a band, as a fraction of it. */
+  LodSelector(float fovy, float viewportHeight, float threshold = 1.0f, float hysteresis = 0.25f);
+
+  /* `levels` run from finest to coarsest with increasing error. `distance`
+   * is how far the object is from the camera and `scale` how much its
+   * transform enlarges it. Returns the new level, given the one used last. */
+  uint32_t select(const LodLevel* levels, uint32_t levelCount, float distance, float scale, uint32_t current) const;
+
+  /* How many pixels `size` world units span at `distance`. */
+  float projectedSize(float size, float distance) const;
+
+private:
+  float pixelsPerUnit;
+  float threshold;
+  float hysteresis;
+};
@@ -0,0 +1,80 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile(void) {
+#ifdef _WIN32
+  if (address != nullptr) {
+    UnmapViewOfFile(address);
+  }
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle != nullptr) {
+    CloseHandle(fileHandle);
+  }
+#else
+  if (address != nullptr) {
+    munmap(address, length);
+  }
+#endif
+}
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (address == NULL) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  return std::unique_ptr<MappedFile>(new MappedFile(address, static_cast<size_t>(fileSize.QuadPart), file, mapping));
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void* address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  /* The mapping keeps its own reference to the file. */
+  close(fd);
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+
+  return std::unique_ptr<MappedFile>(new MappedFile(address, static_cast<size_t>(st.st_size), nullptr, nullptr));
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/* A read-only memory mapping of a whole file. The pages are faulted in lazily
+ * by the OS, so opening a large file is cheap until its contents are read. */
+class MappedFile {
+public:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile(void);
+
+  static std::unique_ptr<MappedFile> open(const std::string& path);
+
+  const unsigned char* data(void) const {
+    return static_cast<const unsigned char*>(address);
+  }
+
+  size_t size(void) const {
+    return length;
+  }
+
+private:
+  MappedFile(void* address, size_t length, void* fileHandle, void* mappingHandle)
+    : address(address)
+    , length(length)
+    , fileHandle(fileHandle)
+    , mappingHandle(mappingHandle) {}
+
+  void* address;
+  size_t length;
+  /* Only used on Windows, where the file and mapping handles must outlive the
+   * view. */
+  void* fileHandle;
+  void* mappingHandle;
+};
@@ -1,10 +1,11 @@
 #include "Mesh.h"
 
+#include "GLState.h"
 #include "ShaderProgram.h"
 
 Mesh::~Mesh(void) {
   if (VAO != 0) {
-    glDeleteVertexArrays(1, &VAO);
+    GLState::deleteVertexArray(VAO);
   }
   if (VBO != 0) {
     glDeleteBuffers(1, &VBO);
@@ -12,37 +13,53 @@ Mesh::~Mesh(void) {
   if (EBO != 0) {
     glDeleteBuffers(1, &EBO);
   }
+  if (instanceVBO != 0) {
+    glDeleteBuffers(1, &instanceVBO);
+  }
 }
 
 void Mesh::draw(const ShaderProgram& shaderProgram) const {
-  for (size_t i = 0, n = textures.size(); i < n; ++i) {
-    /* Active proper texture unit before binding. */
-    glActiveTexture(GL_TEXTURE0 + i);
-
-    const Texture& texture = textures[i];
-    /* Then, set the sampler to the correct texture unit. */
-    shaderProgram.uniform(texture.name, static_cast<GLint>(i));
-    /* Finally, bind the texture. */
-    glBindTexture(GL_TEXTURE_2D, texture.id);
-  }
+  bindTextures(shaderProgram, textures);
 
-  /* Draw mesh. */
-  glBindVertexArray(VAO);
+  /* Draw mesh. The VAO is left bound: nothing binds buffers outside of a
+   * VAO's setup, so the next draw of this mesh can skip rebinding it. */
+  GLState::bindVertexArray(VAO);
   if (EBO != 0) {
     glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)0);
   } else {
     glDrawArrays(GL_TRIANGLES, 0, count);
   }
-  glBindVertexArray(0);
+  GLState::countDraw(count / 3);
+}
+
+void Mesh::drawInstanced(const ShaderProgram& shaderProgram, GLsizei instances) const {
+  bindTextures(shaderProgram, textures);
+
+  GLState::bindVertexArray(VAO);
+  if (EBO != 0) {
+    glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)0, instances);
+  } else {
+    glDrawArraysInstanced(GL_TRIANGLES, 0, count, instances);
+  }
+  GLState::countDraw(static_cast<size_t>(count / 3) * instances);
+}
+
+void Mesh::bindTextures(const ShaderProgram& shaderProgram, const std::vector<Texture>& textures) {
+  for (size_t i = 0, n = textures.size(); i < n; ++i) {
+    const Texture& texture = textures[i];
+    /* Set the sampler to the texture unit, then bind the texture to it. */
+    shaderProgram.uniform(shaderProgram.getUniform<GLint>(texture.uniformName), static_cast<GLint>(i));
+    GLState::bindTexture(static_cast<GLuint>(i), texture.target, texture.id);
+  }
 }
 
-void Mesh::setupIndices(const std::vector<unsigned int>& indices) {
+void Mesh::setupIndices(const GLuint* indices, size_t indexCount) {
   /* An *element buffer object (EBO)* is a buffer that stores indices that
    * OpenGL uses to decide what vertices to draw. */
   glGenBuffers(1, &EBO);
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), indices, GL_STATIC_DRAW);
 }
 
 void Mesh::bindBuffers(void) {
@@ -52,7 +69,7 @@ void Mesh::bindBuffers(void) {
 
   /* By binding a VAO, all subsequent VBO, EBO and vertex attribute calls will
    * be stored inside the VAO. */
-  glBindVertexArray(VAO);
+  GLState::bindVertexArray(VAO);
 
   /* A vertex array object (VAO) stores our vertex attribute configuration and
    * which VBO to use. */
@@ -62,7 +79,7 @@ void Mesh::bindBuffers(void) {
 }
 
 void Mesh::unbindBuffers(void) {
-  glBindVertexArray(0);
+  GLState::bindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   if (EBO != 0) {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
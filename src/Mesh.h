@@ -1,18 +1,58 @@
 #pragma once
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
-#include <boost/pfr.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "Bounds.h"
+#include "GLState.h"
+#include "TextureLoader.h"
+#include "UniformTable.h"
+#include "VertexAttribute.h"
+
 class ShaderProgram;
 
 struct Texture {
+  Texture(GLuint id, std::string name, std::string path = {})
+    : id(id)
+    , target(GL_TEXTURE_2D)
+    , name(std::move(name))
+    , path(std::move(path))
+    , uniformName(this->name) {}
+
+  /* Keeps the texture resident for as long as this refers to it. */
+  Texture(TextureHandle handle, std::string name, std::string path = {})
+    : id(handle.getID())
+    , target(handle.getTarget())
+    , name(std::move(name))
+    , path(std::move(path))
+    , uniformName(this->name)
+    , handle(std::move(handle)) {}
+
   GLuint id;
+  /* What to bind `id` to. */
+  GLenum target;
   std::string name;
   std::string path;
+  /* `name` hashed up front, so binding doesn't hash on every draw. */
+  UniformName uniformName;
+  /* Invalid for textures the loader doesn't own. */
+  TextureHandle handle;
+};
+
+/* Ready-made per-instance layouts for `Mesh::setInstances`. */
+struct InstanceTransform {
+  glm::mat4 modelMatrix;
+};
+
+/* Half the size of a matrix: a translation with a uniform scale in `w`, and
+ * a unit quaternion (x, y, z, w). */
+struct InstanceTRS {
+  glm::vec4 translationScale;
+  glm::vec4 rotation;
 };
 
 class Mesh {
@@ -22,16 +62,22 @@ public:
     : EBO(0)
     , count(vertices.size())
     , textures(std::move(textures)) {
-    setupVertices(vertices);
+    setupVertices(vertices.data(), vertices.size());
     unbindBuffers();
   }
 
   template <typename VertexType>
   Mesh(const std::vector<VertexType>& vertices, const std::vector<GLuint>& indices, std::vector<Texture> textures = {})
-    : count(indices.size())
+    : Mesh(vertices.data(), vertices.size(), indices.data(), indices.size(), std::move(textures)) {}
+
+  /* Builds a mesh from raw arrays, e.g. views into a memory-mapped file. The
+   * data is copied straight into GPU buffers and need not outlive the call. */
+  template <typename VertexType>
+  Mesh(const VertexType* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, std::vector<Texture> textures = {})
+    : count(indexCount)
     , textures(std::move(textures)) {
-    setupVertices(vertices);
-    setupIndices(indices);
+    setupVertices(vertices, vertexCount);
+    setupIndices(indices, indexCount);
     unbindBuffers();
   }
 
@@ -41,11 +87,20 @@ public:
     : VAO(other.VAO)
     , VBO(other.VBO)
     , EBO(other.EBO)
-    , count(other.count) {
+    , count(other.count)
+    , attributeCount(other.attributeCount)
+    , instanceVBO(other.instanceVBO)
+    , instanceCount(other.instanceCount)
+    , instanceLayout(other.instanceLayout)
+    , bounds(other.bounds)
+    , textures(std::move(other.textures)) {
     other.VAO = 0;
     other.VBO = 0;
     other.EBO = 0;
     other.count = 0;
+    other.instanceVBO = 0;
+    other.instanceCount = 0;
+    other.instanceLayout = nullptr;
   }
 
   ~Mesh(void);
@@ -61,15 +116,57 @@ public:
     swap(lhs.VBO, rhs.VBO);
     swap(lhs.EBO, rhs.EBO);
     swap(lhs.count, rhs.count);
+    swap(lhs.attributeCount, rhs.attributeCount);
+    swap(lhs.instanceVBO, rhs.instanceVBO);
+    swap(lhs.instanceCount, rhs.instanceCount);
+    swap(lhs.instanceLayout, rhs.instanceLayout);
+    swap(lhs.bounds, rhs.bounds);
+    swap(lhs.textures, rhs.textures);
   }
 
   void draw(const ShaderProgram& shaderProgram) const;
 
+  /* Uploads per-instance data. The fields of `InstanceType` are reflected
+   * like vertex fields and take the attribute locations right after the
+   * vertex's, advancing once per instance. Can be called every frame. */
+  template <typename InstanceType>
+  void setInstances(const InstanceType* instances, size_t instanceCount);
+
+  template <typename InstanceType>
+  void setInstances(const std::vector<InstanceType>& instances) {
+    setInstances(instances.data(), instances.size());
+  }
+
+  /* Draws all instances passed to `setInstances` with a single call. */
+  void drawInstanced(const ShaderProgram& shaderProgram) const {
+    drawInstanced(shaderProgram, instanceCount);
+  }
+
+  /* Draws the first `instances` instances. */
+  void drawInstanced(const ShaderProgram& shaderProgram, GLsizei instances) const;
+
+  GLsizei getInstanceCount(void) const {
+    return instanceCount;
+  }
+
+  const std::vector<Texture>& getTextures(void) const {
+    return textures;
+  }
+
+  /* Around the vertex positions, in model space. */
+  const Bounds& getBounds(void) const {
+    return bounds;
+  }
+
+  /* Binds `textures` to consecutive texture units, starting at 0, and points
+   * the sampler uniform of the same name at each. */
+  static void bindTextures(const ShaderProgram& shaderProgram, const std::vector<Texture>& textures);
+
 private:
   template <typename VertexType>
-  void setupVertices(const std::vector<VertexType>& vertices);
+  void setupVertices(const VertexType* vertices, size_t vertexCount);
 
-  void setupIndices(const std::vector<unsigned int>& indices);
+  void setupIndices(const GLuint* indices, size_t indexCount);
 
   void bindBuffers(void);
   void unbindBuffers(void);
@@ -77,39 +174,48 @@ private:
   GLuint VAO;
   GLuint VBO, EBO;
   GLsizei count;
+  /* Attribute locations taken by the vertex type. */
+  GLuint attributeCount = 0;
+  GLuint instanceVBO = 0;
+  GLsizei instanceCount = 0;
+  /* Identifies the instance type the attributes are currently set up for. */
+  GLuint (*instanceLayout)(GLuint, GLuint) = nullptr;
+  Bounds bounds;
   std::vector<Texture> textures;
 };
 
 template <typename VertexType>
-void Mesh::setupVertices(const std::vector<VertexType>& vertices) {
+void Mesh::setupVertices(const VertexType* vertices, size_t vertexCount) {
   bindBuffers();
 
-  constexpr size_t stride = sizeof(VertexType);
-  size_t offset = 0;
-
   /* `glBufferData` is a function specifically targeted to copy user-defined
    * data into the currently bound buffer. */
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * stride, vertices.data(), GL_STATIC_DRAW);
-
-  boost::pfr::for_each_field(VertexType{}, [&](auto&& field, auto index) {
-    using T = std::decay_t<decltype(field)>;
-
-    /* We can tell OpenGL how it should interpret the vertex data (per vertex
-     * attribute) using `glVertexAttribPointer`. */
-    if constexpr (std::is_same_v<T, glm::vec2>) {
-      glVertexAttribPointer(index, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
-    } else if constexpr (std::is_same_v<T, glm::vec3>) {
-      glVertexAttribPointer(index, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
-    } else if constexpr (std::is_same_v<T, glm::vec4>) {
-      glVertexAttribPointer(index, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
-    } else {
-      static_assert(false, "All vertex attributes must be glm::vec2/3/4");
-    }
-
-    /* Enable the vertex attribute with `glEnableVertexAttribArray` as vertex
-     * attributes are disabled by default. */
-    glEnableVertexAttribArray(index);
-
-    offset += sizeof(T);
-  });
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(VertexType), vertices, GL_STATIC_DRAW);
+
+  bounds = computeVertexBounds<VertexType>(vertices, vertexCount);
+
+  attributeCount = setupVertexAttributes<VertexType>();
+}
+
+template <typename InstanceType>
+void Mesh::setInstances(const InstanceType* instances, size_t instanceCount) {
+  GLState::bindVertexArray(VAO);
+  if (instanceVBO == 0) {
+    glGenBuffers(1, &instanceVBO);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+  /* Respecifying the whole store orphans the previous one, so updating the
+   * instances every frame doesn't wait for draws still reading them. */
+  glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(InstanceType), instances, GL_DYNAMIC_DRAW);
+
+  /* The attribute pointers keep referring to `instanceVBO`, so they only
+   * need setting up again when the instance type changes. */
+  if (instanceLayout != &setupVertexAttributes<InstanceType>) {
+    instanceLayout = &setupVertexAttributes<InstanceType>;
+    instanceLayout(attributeCount, 1);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  this->instanceCount = static_cast<GLsizei>(instanceCount);
 }
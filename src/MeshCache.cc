@@ -0,0 +1,319 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+namespace {
+
+/* Bump this whenever the layout of the file or of the cached vertices
+ * changes, so that stale caches are rebuilt instead of misread. */
+constexpr uint32_t MESH_CACHE_VERSION = 4;
+
+constexpr char MESH_CACHE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'M', 'E', 'S', 'H' };
+
+/* Vertex and index arrays are aligned so the views into the mapping are
+ * suitably aligned for any vertex type. */
+constexpr size_t MESH_CACHE_ALIGNMENT = 16;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t importFlags;
+  uint64_t sourcePathHash;
+  int64_t sourceModifiedTime;
+  uint32_t vertexStride;
+  uint32_t meshCount;
+  uint32_t nodeCount;
+  uint32_t reserved;
+  uint64_t nodesOffset;
+};
+
+struct MeshHeader {
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t texturesOffset;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t textureCount;
+  uint32_t lodCount;
+};
+
+bool sourceModifiedTime(const std::string& path, int64_t& outTime) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return false;
+  }
+  outTime = static_cast<int64_t>(time.time_since_epoch().count());
+  return true;
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void pad(std::ofstream& out, size_t& offset, size_t alignment) {
+  static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+  size_t aligned = alignUp(offset, alignment);
+  out.write(zeros, aligned - offset);
+  offset = aligned;
+}
+
+void writeBytes(std::ofstream& out, size_t& offset, const void* data, size_t size) {
+  out.write(static_cast<const char*>(data), size);
+  offset += size;
+}
+
+} // namespace
+
+MeshCache::Writer::Writer(const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride)
+  : sourcePath(sourcePath)
+  , importFlags(importFlags)
+  , vertexStride(vertexStride) {}
+
+void MeshCache::Writer::addMesh(const void* vertices, uint32_t vertexCount, const GLuint* indices, uint32_t indexCount,
+                                std::vector<TextureRecord> textures, std::vector<LodRecord> lods) {
+  const unsigned char* vertexBytes = static_cast<const unsigned char*>(vertices);
+  meshes.push_back({
+    std::vector<unsigned char>(vertexBytes, vertexBytes + static_cast<size_t>(vertexCount) * vertexStride),
+    vertexCount,
+    std::vector<GLuint>(indices, indices + indexCount),
+    std::move(textures),
+    std::move(lods),
+  });
+}
+
+bool MeshCache::Writer::write(const std::string& cachePath) const {
+  FileHeader header = {};
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof header.magic);
+  header.version = MESH_CACHE_VERSION;
+  header.importFlags = importFlags;
+  header.sourcePathHash = fnv1a64(sourcePath);
+  if (!sourceModifiedTime(sourcePath, header.sourceModifiedTime)) {
+    return false;
+  }
+  header.vertexStride = vertexStride;
+  header.meshCount = static_cast<uint32_t>(meshes.size());
+  header.nodeCount = static_cast<uint32_t>(nodes.size());
+
+  /* Lay the file out up front: headers, then the texture and LOD records,
+   * then the nodes, then the aligned vertex and index arrays. */
+  std::vector<MeshHeader> meshHeaders(meshes.size());
+  size_t offset = sizeof(FileHeader) + meshes.size() * sizeof(MeshHeader);
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    meshHeaders[i].texturesOffset = offset;
+    meshHeaders[i].textureCount = static_cast<uint32_t>(meshes[i].textures.size());
+    for (const auto& texture : meshes[i].textures) {
+      offset += 2 * sizeof(uint32_t) + texture.name.size() + texture.path.size();
+    }
+    meshHeaders[i].lodCount = static_cast<uint32_t>(meshes[i].lods.size());
+    offset += meshes[i].lods.size() * sizeof(LodRecord);
+  }
+  header.nodesOffset = offset;
+  for (const auto& node : nodes) {
+    offset += 2 * sizeof(uint32_t) + sizeof node.transform + node.meshes.size() * sizeof(uint32_t);
+  }
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    offset = alignUp(offset, MESH_CACHE_ALIGNMENT);
+    meshHeaders[i].vertexOffset = offset;
+    meshHeaders[i].vertexCount = meshes[i].vertexCount;
+    offset += meshes[i].vertices.size();
+
+    offset = alignUp(offset, MESH_CACHE_ALIGNMENT);
+    meshHeaders[i].indexOffset = offset;
+    meshHeaders[i].indexCount = static_cast<uint32_t>(meshes[i].indices.size());
+    offset += meshes[i].indices.size() * sizeof(GLuint);
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), ec);
+
+  /* Write to a temporary file and rename it into place, so that a crash or a
+   * concurrent reader never observes a half-written cache. */
+  std::string tempPath = cachePath + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    return false;
+  }
+
+  offset = 0;
+  writeBytes(out, offset, &header, sizeof header);
+  writeBytes(out, offset, meshHeaders.data(), meshHeaders.size() * sizeof(MeshHeader));
+  for (const auto& mesh : meshes) {
+    for (const auto& texture : mesh.textures) {
+      uint32_t lengths[2] = { static_cast<uint32_t>(texture.name.size()), static_cast<uint32_t>(texture.path.size()) };
+      writeBytes(out, offset, lengths, sizeof lengths);
+      writeBytes(out, offset, texture.name.data(), texture.name.size());
+      writeBytes(out, offset, texture.path.data(), texture.path.size());
+    }
+    writeBytes(out, offset, mesh.lods.data(), mesh.lods.size() * sizeof(LodRecord));
+  }
+  for (const auto& node : nodes) {
+    uint32_t fields[2] = { node.parent, static_cast<uint32_t>(node.meshes.size()) };
+    writeBytes(out, offset, fields, sizeof fields);
+    writeBytes(out, offset, node.transform.data(), sizeof node.transform);
+    writeBytes(out, offset, node.meshes.data(), node.meshes.size() * sizeof(uint32_t));
+  }
+  for (const auto& mesh : meshes) {
+    pad(out, offset, MESH_CACHE_ALIGNMENT);
+    writeBytes(out, offset, mesh.vertices.data(), mesh.vertices.size());
+    pad(out, offset, MESH_CACHE_ALIGNMENT);
+    writeBytes(out, offset, mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+  }
+
+  out.close();
+  if (!out) {
+    std::filesystem::remove(tempPath, ec);
+    std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    return false;
+  }
+
+  std::filesystem::rename(tempPath, cachePath, ec);
+  if (ec) {
+    std::filesystem::remove(tempPath, ec);
+    std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    return false;
+  }
+  return true;
+}
+
+MeshCache::MeshCache(std::unique_ptr<MappedFile> file)
+  : file(std::move(file)) {}
+
+MeshCache::~MeshCache(void) = default;
+
+std::string MeshCache::pathFor(const std::string& sourcePath, uint32_t vertexStride) {
+  /* Fold the stride into the name so full-precision and quantized imports of
+   * the same file don't keep evicting each other. */
+  uint64_t hash = fnv1a64(&vertexStride, sizeof vertexStride, fnv1a64(sourcePath));
+  std::ostringstream name;
+  name << ".cache/meshes/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+  return name.str();
+}
+
+std::unique_ptr<MeshCache> MeshCache::open(const std::string& cachePath, const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride) {
+  std::unique_ptr<MappedFile> file = MappedFile::open(cachePath);
+  if (!file) {
+    return nullptr;
+  }
+
+  std::unique_ptr<MeshCache> cache(new MeshCache(std::move(file)));
+  if (!cache->parse(sourcePath, importFlags, vertexStride)) {
+    return nullptr;
+  }
+  return cache;
+}
+
+bool MeshCache::parse(const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride) {
+  const unsigned char* base = file->data();
+  size_t size = file->size();
+
+  if (size < sizeof(FileHeader)) {
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, base, sizeof header);
+
+  int64_t modifiedTime;
+  if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof header.magic) != 0
+      || header.version != MESH_CACHE_VERSION
+      || header.importFlags != importFlags
+      || header.vertexStride != vertexStride
+      || header.sourcePathHash != fnv1a64(sourcePath)
+      || !sourceModifiedTime(sourcePath, modifiedTime)
+      || header.sourceModifiedTime != modifiedTime) {
+    return false;
+  }
+
+  if (header.meshCount > (size - sizeof(FileHeader)) / sizeof(MeshHeader)) {
+    return false;
+  }
+
+  meshes.reserve(header.meshCount);
+  for (uint32_t i = 0; i < header.meshCount; ++i) {
+    MeshHeader meshHeader;
+    std::memcpy(&meshHeader, base + sizeof(FileHeader) + i * sizeof(MeshHeader), sizeof meshHeader);
+
+    /* Never trust offsets read from disk. */
+    if (meshHeader.vertexOffset > size || static_cast<uint64_t>(meshHeader.vertexCount) * vertexStride > size - meshHeader.vertexOffset
+        || meshHeader.indexOffset > size || static_cast<uint64_t>(meshHeader.indexCount) * sizeof(GLuint) > size - meshHeader.indexOffset
+        || meshHeader.indexOffset % alignof(GLuint) != 0) {
+      return false;
+    }
+
+    MeshView view;
+    view.vertices = base + meshHeader.vertexOffset;
+    view.vertexCount = meshHeader.vertexCount;
+    view.indices = reinterpret_cast<const GLuint*>(base + meshHeader.indexOffset);
+    view.indexCount = meshHeader.indexCount;
+
+    size_t offset = meshHeader.texturesOffset;
+    for (uint32_t j = 0; j < meshHeader.textureCount; ++j) {
+      uint32_t lengths[2];
+      if (offset > size || size - offset < sizeof lengths) {
+        return false;
+      }
+      std::memcpy(lengths, base + offset, sizeof lengths);
+      offset += sizeof lengths;
+      if (static_cast<uint64_t>(lengths[0]) + lengths[1] > size - offset) {
+        return false;
+      }
+      const char* chars = reinterpret_cast<const char*>(base + offset);
+      view.textures.push_back({ std::string(chars, lengths[0]), std::string(chars + lengths[0], lengths[1]) });
+      offset += lengths[0] + lengths[1];
+    }
+
+    if (offset > size || static_cast<uint64_t>(meshHeader.lodCount) * sizeof(LodRecord) > size - offset) {
+      return false;
+    }
+    view.lods.resize(meshHeader.lodCount);
+    std::memcpy(view.lods.data(), base + offset, meshHeader.lodCount * sizeof(LodRecord));
+    for (const auto& lod : view.lods) {
+      if (lod.firstIndex > view.indexCount || lod.indexCount > view.indexCount - lod.firstIndex) {
+        return false;
+      }
+    }
+
+    meshes.push_back(std::move(view));
+  }
+
+  size_t offset = header.nodesOffset;
+  nodes.reserve(header.nodeCount);
+  for (uint32_t i = 0; i < header.nodeCount; ++i) {
+    NodeRecord node;
+    uint32_t fields[2];
+    if (offset > size || size - offset < sizeof fields + sizeof node.transform) {
+      return false;
+    }
+    std::memcpy(fields, base + offset, sizeof fields);
+    offset += sizeof fields;
+    std::memcpy(node.transform.data(), base + offset, sizeof node.transform);
+    offset += sizeof node.transform;
+    if (static_cast<uint64_t>(fields[1]) * sizeof(uint32_t) > size - offset) {
+      return false;
+    }
+    node.parent = fields[0];
+    node.meshes.resize(fields[1]);
+    std::memcpy(node.meshes.data(), base + offset, fields[1] * sizeof(uint32_t));
+    offset += fields[1] * sizeof(uint32_t);
+
+    /* Indices must stay in range, and parents come first. */
+    if ((node.parent != ~0u && node.parent >= i)
+        || std::any_of(node.meshes.begin(), node.meshes.end(), [&header](uint32_t mesh) { return mesh >= header.meshCount; })) {
+      return false;
+    }
+    nodes.push_back(std::move(node));
+  }
+
+  return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+class MappedFile;
+
+/* A versioned on-disk cache of the geometry `Model` extracts from an Assimp
+ * scene. A cache file is only valid for the exact source path, modification
+ * time, import flags and vertex stride it was written with; anything else is
+ * treated as a miss.
+ *
+ * The file is memory-mapped on load, and the vertex and index arrays are
+ * exposed as views straight into the mapping so they can be handed to
+ * `glBufferData` without any intermediate copies. */
+class MeshCache {
+public:
+  struct TextureRecord {
+    std::string name;
+    std::string path;
+  };
+
+  /* A level of detail: a run of the mesh's indices, and how far it strays
+   * from the full mesh. */
+  struct LodRecord {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+  };
+
+  /* A node of the scene hierarchy, with its transform relative to its
+   * parent, stored column by column. */
+  struct NodeRecord {
+    uint32_t parent;
+    std::array<float, 16> transform;
+    std::vector<uint32_t> meshes;
+  };
+
+  struct MeshView {
+    const void* vertices;
+    uint32_t vertexCount;
+    const GLuint* indices;
+    uint32_t indexCount;
+    std::vector<TextureRecord> textures;
+    /* Finest first. */
+    std::vector<LodRecord> lods;
+  };
+
+  class Writer {
+  public:
+    Writer(const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride);
+
+    void addMesh(const void* vertices, uint32_t vertexCount, const GLuint* indices, uint32_t indexCount,
+                 std::vector<TextureRecord> textures, std::vector<LodRecord> lods);
+
+    /* Parents must be added before their children. */
+    void addNode(NodeRecord node) {
+      nodes.push_back(std::move(node));
+    }
+
+    bool write(const std::string& cachePath) const;
+
+  private:
+    struct PendingMesh {
+      std::vector<unsigned char> vertices;
+      uint32_t vertexCount;
+      std::vector<GLuint> indices;
+      std::vector<TextureRecord> textures;
+      std::vector<LodRecord> lods;
+    };
+
+    std::string sourcePath;
+    uint32_t importFlags;
+    uint32_t vertexStride;
+    std::vector<PendingMesh> meshes;
+    std::vector<NodeRecord> nodes;
+  };
+
+  MeshCache(const MeshCache&) = delete;
+  MeshCache& operator=(const MeshCache&) = delete;
+
+  ~MeshCache(void);
+
+  /* Where the cache for the given source file and vertex layout lives. */
+  static std::string pathFor(const std::string& sourcePath, uint32_t vertexStride);
+
+  static std::unique_ptr<MeshCache> open(const std::string& cachePath, const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride);
+
+  const std::vector<MeshView>& getMeshes(void) const {
+    return meshes;
+  }
+
+  const std::vector<NodeRecord>& getNodes(void) const {
+    return nodes;
+  }
+
+private:
+  explicit MeshCache(std::unique_ptr<MappedFile> file);
+
+  bool parse(const std::string& sourcePath, uint32_t importFlags, uint32_t vertexStride);
+
+  std::unique_ptr<MappedFile> file;
+  std::vector<MeshView> meshes;
+  std::vector<NodeRecord> nodes;
+};
@@ -0,0 +1,450 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+
+VertexCacheStatistics analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+  VertexCacheStatistics statistics = { 0.0f, 0.0f };
+  if (indexCount < 3 || vertexCount == 0) {
+    return statistics;
+  }
+
+  /* `cacheTime[v]` is the value of `misses` when `v` last entered the cache;
+   * with a FIFO, `v` is still cached while fewer than `cacheSize` vertices
+   * have entered since. */
+  std::vector<size_t> cacheTime(vertexCount, 0);
+  std::vector<bool> referenced(vertexCount, false);
+  size_t misses = 0;
+  size_t uniqueVertices = 0;
+
+  for (size_t i = 0; i < indexCount; ++i) {
+    GLuint v = indices[i];
+    if (!referenced[v]) {
+      referenced[v] = true;
+      ++uniqueVertices;
+    } else if (misses - cacheTime[v] < cacheSize) {
+      continue;
+    }
+    ++misses;
+    cacheTime[v] = misses;
+  }
+
+  statistics.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+  statistics.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+  return statistics;
+}
+
+size_t weldVertices(void* vertices, size_t vertexCount, size_t stride, GLuint* indices, size_t indexCount) {
+  unsigned char* bytes = static_cast<unsigned char*>(vertices);
+
+  auto hash = [bytes, stride](GLuint v) {
+    return static_cast<size_t>(fnv1a64(bytes + static_cast<size_t>(v) * stride, stride));
+  };
+  auto equal = [bytes, stride](GLuint a, GLuint b) {
+    return std::memcmp(bytes + static_cast<size_t>(a) * stride, bytes + static_cast<size_t>(b) * stride, stride) == 0;
+  };
+
+  /* Find the first occurrence of every distinct vertex. */
+  std::vector<GLuint> remap(vertexCount);
+  std::unordered_set<GLuint, decltype(hash), decltype(equal)> unique(vertexCount, hash, equal);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    auto result = unique.insert(static_cast<GLuint>(v));
+    remap[v] = *result.first;
+  }
+
+  /* Compact the first occurrences to the front. Since a vertex is only ever
+   * moved to an earlier slot, we never overwrite one we still need. */
+  std::vector<GLuint> compacted(vertexCount);
+  size_t uniqueCount = 0;
+  for (size_t v = 0; v < vertexCount; ++v) {
+    if (remap[v] == v) {
+      if (uniqueCount != v) {
+        std::memcpy(bytes + uniqueCount * stride, bytes + v * stride, stride);
+      }
+      compacted[v] = static_cast<GLuint>(uniqueCount++);
+    }
+  }
+
+  for (size_t i = 0; i < indexCount; ++i) {
+    indices[i] = compacted[remap[indices[i]]];
+  }
+
+  return uniqueCount;
+}
+
+void optimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+  size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0 || vertexCount == 0) {
+    return;
+  }
+
+  /* Vertex-triangle adjacency, stored as one flat array. */
+  std::vector<GLuint> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    ++liveTriangles[indices[i]];
+  }
+  std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+  }
+  std::vector<GLuint> adjacency(adjacencyOffsets[vertexCount]);
+  {
+    std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+      for (size_t k = 0; k < 3; ++k) {
+        adjacency[fill[indices[t * 3 + k]]++] = static_cast<GLuint>(t);
+      }
+    }
+  }
+
+  std::vector<GLuint> output;
+  output.reserve(triangleCount * 3);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<size_t> cacheTime(vertexCount, 0);
+  std::vector<GLuint> deadEnd;
+  std::vector<GLuint> candidates;
+  size_t timestamp = cacheSize + 1;
+  size_t cursor = 0;
+
+  long fanningVertex = 0;
+  while (fanningVertex >= 0) {
+    candidates.clear();
+
+    /* Emit every remaining triangle around the fanning vertex. */
+    for (size_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; ++a) {
+      GLuint t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (size_t k = 0; k < 3; ++k) {
+        GLuint v = indices[t * 3 + k];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        --liveTriangles[v];
+        if (timestamp - cacheTime[v] > cacheSize) {
+          cacheTime[v] = timestamp++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    /* Prefer the candidate that is still in the cache and will stay there
+     * while its remaining triangles are emitted. */
+    fanningVertex = -1;
+    size_t bestPriority = 0;
+    for (GLuint v : candidates) {
+      if (liveTriangles[v] == 0) {
+        continue;
+      }
+      size_t priority = 0;
+      if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+        priority = timestamp - cacheTime[v];
+      }
+      if (fanningVertex < 0 || priority > bestPriority) {
+        bestPriority = priority;
+        fanningVertex = v;
+      }
+    }
+
+    if (fanningVertex < 0) {
+      /* Dead end: back up through recently used vertices, then fall back to
+       * scanning for any vertex with triangles left. */
+      while (!deadEnd.empty()) {
+        GLuint v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0) {
+          fanningVertex = v;
+          break;
+        }
+      }
+      while (fanningVertex < 0 && cursor < vertexCount) {
+        if (liveTriangles[cursor] > 0) {
+          fanningVertex = static_cast<long>(cursor);
+        }
+        ++cursor;
+      }
+    }
+  }
+
+  std::memcpy(indices, output.data(), output.size() * sizeof(GLuint));
+}
+
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t stride, GLuint* indices, size_t indexCount) {
+  constexpr GLuint UNUSED = ~0u;
+
+  std::vector<GLuint> remap(vertexCount, UNUSED);
+  size_t newCount = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    GLuint& slot = remap[indices[i]];
+    if (slot == UNUSED) {
+      slot = static_cast<GLuint>(newCount++);
+    }
+    indices[i] = slot;
+  }
+
+  const unsigned char* source = static_cast<const unsigned char*>(vertices);
+  std::vector<unsigned char> reordered(newCount * stride);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    if (remap[v] != UNUSED) {
+      std::memcpy(reordered.data() + remap[v] * stride, source + v * stride, stride);
+    }
+  }
+  std::memcpy(vertices, reordered.data(), reordered.size());
+
+  return newCount;
+}
+
+namespace {
+
+/* The sum of squared distances to a set of planes, as the symmetric matrix
+ * [A b; b^T c], weighted by the area of the triangles the planes came from. */
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double weight;
+};
+
+Quadric planeQuadric(const glm::dvec3& normal, double distance, double weight) {
+  return {
+    weight * normal.x * normal.x, weight * normal.x * normal.y, weight * normal.x * normal.z,
+    weight * normal.y * normal.y, weight * normal.y * normal.z, weight * normal.z * normal.z,
+    weight * normal.x * distance, weight * normal.y * distance, weight * normal.z * distance,
+    weight * distance * distance,
+    weight,
+  };
+}
+
+void add(Quadric& q, const Quadric& other) {
+  q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+  q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+  q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+  q.c += other.c;
+  q.weight += other.weight;
+}
+
+/* Mean squared distance of `p` to the planes. */
+double evaluate(const Quadric& q, const glm::vec3& p) {
+  double x = p.x, y = p.y, z = p.z;
+  double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z
+               + q.a11 * y * y + 2.0 * q.a12 * y * z + q.a22 * z * z
+               + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+  return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+struct Collapse {
+  double cost;
+  GLuint from;
+  GLuint to;
+};
+
+} // namespace
+
+size_t simplifyMesh(GLuint* destination, const GLuint* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t stride,
+                    size_t targetIndexCount, float* outError) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+  auto position = [bytes, stride](GLuint v) {
+    glm::vec3 p;
+    std::memcpy(&p, bytes + static_cast<size_t>(v) * stride, sizeof p);
+    return p;
+  };
+
+  std::vector<GLuint> result(indices, indices + indexCount - indexCount % 3);
+  double maxError = 0.0;
+
+  /* Vertices that share a position but differ in other attributes lie on a
+   * seam; moving one would tear the surface open. */
+  std::vector<GLuint> positionIds(vertexCount);
+  std::vector<bool> locked(vertexCount, false);
+  {
+    auto hash = [bytes, stride](GLuint v) {
+      return static_cast<size_t>(fnv1a64(bytes + static_cast<size_t>(v) * stride, sizeof(glm::vec3)));
+    };
+    auto equal = [bytes, stride](GLuint a, GLuint b) {
+      return std::memcmp(bytes + static_cast<size_t>(a) * stride, bytes + static_cast<size_t>(b) * stride, sizeof(glm::vec3)) == 0;
+    };
+    std::unordered_set<GLuint, decltype(hash), decltype(equal)> unique(vertexCount, hash, equal);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      auto inserted = unique.insert(static_cast<GLuint>(v));
+      positionIds[v] = *inserted.first;
+      if (!inserted.second) {
+        locked[v] = true;
+        locked[positionIds[v]] = true;
+      }
+    }
+  }
+
+  /* Edges used by a single triangle lie on an open border, which we keep in
+   * place so holes and silhouettes don't shrink. */
+  {
+    std::unordered_map<uint64_t, int> edgeUses;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t k = 0; k < 3; ++k) {
+        GLuint a = positionIds[result[i + k]], b = positionIds[result[i + (k + 1) % 3]];
+        ++edgeUses[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)];
+      }
+    }
+    std::vector<bool> borderPositions(vertexCount, false);
+    for (const auto& edge : edgeUses) {
+      if (edge.second == 1) {
+        borderPositions[edge.first >> 32] = true;
+        borderPositions[edge.first & 0xffffffffu] = true;
+      }
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+      if (borderPositions[positionIds[v]]) {
+        locked[v] = true;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount, Quadric{});
+  for (size_t i = 0; i < result.size(); i += 3) {
+    glm::vec3 p0 = position(result[i]), p1 = position(result[i + 1]), p2 = position(result[i + 2]);
+    glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+    double length = glm::length(normal);
+    if (length == 0.0) {
+      continue;
+    }
+    normal /= length;
+    Quadric q = planeQuadric(normal, -glm::dot(normal, glm::dvec3(p0)), 0.5 * length);
+    for (size_t k = 0; k < 3; ++k) {
+      add(quadrics[result[i + k]], q);
+    }
+  }
+
+  std::vector<size_t> adjacencyOffsets(vertexCount + 1);
+  std::vector<GLuint> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(vertexCount);
+
+  /* Each pass collapses the cheapest edges that don't share a vertex or a
+   * triangle, then rewrites the indices, until the target is reached or
+   * nothing can collapse any more. */
+  while (result.size() > targetIndexCount) {
+    size_t triangleCount = result.size() / 3;
+
+    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for (GLuint v : result) {
+      ++adjacencyOffsets[v + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+      adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    adjacency.resize(result.size());
+    {
+      std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+      for (size_t t = 0; t < triangleCount; ++t) {
+        for (size_t k = 0; k < 3; ++k) {
+          adjacency[fill[result[t * 3 + k]]++] = static_cast<GLuint>(t);
+        }
+      }
+    }
+
+    collapses.clear();
+    for (size_t t = 0; t < triangleCount; ++t) {
+      for (size_t k = 0; k < 3; ++k) {
+        GLuint a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+        for (GLuint from : { a, b }) {
+          GLuint to = from == a ? b : a;
+          if (locked[from] || from == to) {
+            continue;
+          }
+          Quadric q = quadrics[from];
+          add(q, quadrics[to]);
+          collapses.push_back({ evaluate(q, position(to)), from, to });
+        }
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+    /* Each collapse removes the triangles around the edge, usually two. */
+    size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+    size_t removed = 0;
+    std::fill(touched.begin(), touched.end(), false);
+    std::vector<std::pair<GLuint, GLuint>> applied;
+
+    for (const Collapse& collapse : collapses) {
+      if (removed >= trianglesToRemove) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+
+      /* Moving `from` onto `to` must not turn any surviving triangle over. */
+      glm::vec3 target = position(collapse.to);
+      bool flips = false;
+      size_t collapsedTriangles = 0;
+      for (size_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; ++a) {
+        const GLuint* triangle = &result[adjacency[a] * 3];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+          ++collapsedTriangles;
+          continue;
+        }
+        glm::vec3 p[3], q[3];
+        for (size_t k = 0; k < 3; ++k) {
+          p[k] = position(triangle[k]);
+          q[k] = triangle[k] == collapse.from ? target : p[k];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        /* Also refuse large rotations, which add up to flips over several
+         * collapses. */
+        flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+      }
+      if (flips) {
+        continue;
+      }
+
+      for (size_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a) {
+        const GLuint* triangle = &result[adjacency[a] * 3];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+      }
+      add(quadrics[collapse.to], quadrics[collapse.from]);
+      maxError = std::max(maxError, collapse.cost);
+      applied.push_back({ collapse.from, collapse.to });
+      removed += collapsedTriangles;
+    }
+
+    if (applied.empty()) {
+      break;
+    }
+
+    /* No vertex is both moved and a target within a pass, so one level of
+     * remapping suffices. */
+    std::vector<GLuint> remap(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      remap[v] = static_cast<GLuint>(v);
+    }
+    for (const auto& collapse : applied) {
+      remap[collapse.first] = collapse.second;
+    }
+    size_t written = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      GLuint a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+      if (a != b && b != c && c != a) {
+        result[written++] = a;
+        result[written++] = b;
+        result[written++] = c;
+      }
+    }
+    result.resize(written);
+  }
+
+  std::memcpy(destination, result.data(), result.size() * sizeof(GLuint));
+  if (outError) {
+    *outError = static_cast<float>(std::sqrt(maxError));
+  }
+  return result.size();
+}
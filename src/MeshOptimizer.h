@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+/* Import-time optimisations for indexed triangle lists. They work on raw
+ * vertex bytes, so any trivially copyable vertex type without padding can be
+ * passed in along with its stride. */
+
+struct VertexCacheStatistics {
+  /* Average cache miss ratio: vertex shader invocations per triangle. 0.5 is
+   * the theoretical best for large regular meshes, 3 the worst. */
+  float acmr;
+  /* Average transform to vertex ratio: vertex shader invocations per unique
+   * vertex. 1 is optimal. */
+  float atvr;
+};
+
+/* Simulates a FIFO post-transform cache of `cacheSize` entries. */
+VertexCacheStatistics analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+/* Merges bitwise-identical vertices and rewrites `indices` to match. The
+ * unique vertices are compacted to the front of the array in order of first
+ * occurrence. Returns the new vertex count. */
+size_t weldVertices(void* vertices, size_t vertexCount, size_t stride, GLuint* indices, size_t indexCount);
+
+/* Reorders triangles for post-transform cache locality using Tipsify
+ * (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+ * and Reduced Overdraw", 2007). */
+void optimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+/* Reorders vertices in the order the index buffer first references them, so
+ * vertex fetches walk memory linearly, and rewrites `indices` to match.
+ * Unreferenced vertices are dropped. Returns the new vertex count. */
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t stride, GLuint* indices, size_t indexCount);
+
+/* Reduces the triangles in `indices` towards `targetIndexCount` indices by
+ * collapsing edges in order of quadric error (Garland and Heckbert, "Surface
+ * Simplification Using Quadric Error Metrics", 1997). Edges collapse onto
+ * one of their vertices, so the result indexes the same vertex buffer; the
+ * positions are the first three floats of each vertex. Vertices on open
+ * borders and on attribute seams never move, and collapses that would flip or
+ * sharply fold a triangle are skipped, so the target may not be reached.
+ *
+ * Writes the result to `destination`, which needs room for `indexCount`
+ * indices, and returns its length. `outError` receives an estimate of the
+ * largest distance between the result and the original surface. */
+size_t simplifyMesh(GLuint* destination, const GLuint* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t stride,
+                    size_t targetIndexCount, float* outError = nullptr);
@@ -1,60 +1,290 @@
 #include "Model.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
 
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
 #include "TextureLoader.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
+
+/* Part of the mesh cache key: changing the post-processing steps changes the
+ * geometry we get back. */
+static constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+static Model::QuantizedVertex quantize(const Model::Vertex& vertex) {
+  Model::QuantizedVertex result;
+  result.position = toHalf4(glm::vec4(vertex.position, 1.0f));
+  result.normal = toPackedSnorm3x10_1x2(glm::vec4(vertex.normal, 0.0f));
+  result.texCoord = toHalf2(vertex.texCoord);
+  return result;
+}
+
+Model::Model(std::string directory, bool quantizeVertices)
+  : directory(std::move(directory))
+  , quantizeVertices(quantizeVertices) {
+  if (quantizeVertices) {
+    arena = GeometryArena::shared<QuantizedVertex>();
+    computeBounds = &computeVertexBounds<QuantizedVertex>;
+  } else {
+    arena = GeometryArena::shared<Vertex>();
+    computeBounds = &computeVertexBounds<Vertex>;
+  }
+}
+
+Model::~Model(void) {
+  for (const auto& batch : batches) {
+    for (GeometryArena::Handle geometry : batch.geometry) {
+      arena->free(geometry);
+    }
+  }
+}
+
+void Model::draw(const ShaderProgram& shaderProgram, UniformBuffer& objectBuffer, const glm::mat4& modelMatrix) const {
+  if (batchable) {
+    ObjectData object = makeObjectData(modelMatrix);
+    objectBuffer.update(&object, sizeof object);
+    for (const auto& batch : batches) {
+      Mesh::bindTextures(shaderProgram, batch.textures);
+      batch.arena->draw(batch.geometry.data(), batch.indices.data(), batch.geometry.size());
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].meshes.empty()) {
+      continue;
+    }
+    ObjectData object = makeObjectData(modelMatrix * nodeModelTransforms[i]);
+    objectBuffer.update(&object, sizeof object);
+    for (uint32_t mesh : nodes[i].meshes) {
+      drawLevel(&subMeshes[mesh].levels.front(), shaderProgram);
+    }
+  }
+}
+
+SceneGraph::Node Model::instantiate(SceneGraph& scene, SceneGraph::Node parent, const glm::mat4& transform,
+                                    const ShaderProgram& shaderProgram, RenderLayer layer) const {
+  SceneGraph::Node root = scene.addNode(parent, transform);
+
+  /* Parents come first, so theirs are always mapped by the time a child
+   * needs them. */
+  std::vector<SceneGraph::Node> sceneNodes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const Node& node = nodes[i];
+    sceneNodes[i] = scene.addNode(node.parent == NO_PARENT ? root : sceneNodes[node.parent], node.transform);
+    for (uint32_t mesh : node.meshes) {
+      const SubMesh& subMesh = subMeshes[mesh];
+      const auto& textures = batches[subMesh.batch].textures;
+      GLuint material = textures.empty() ? 0 : textures.front().id;
+      SceneGraph::Drawable drawable = { layer, &shaderProgram, material, &drawLevel, &subMesh.levels.front(),
+                                        subMesh.lods.data(), static_cast<uint32_t>(subMesh.lods.size()), &requestTextureDetail };
+      scene.addNode(sceneNodes[i], glm::mat4(1.0f), subMesh.bounds.box, drawable);
+    }
+  }
+  return root;
+}
+
+void Model::drawLevel(const void* object, const ShaderProgram& shaderProgram) {
+  const Level& level = *static_cast<const Level*>(object);
+  const SubMesh& subMesh = *level.subMesh;
+  const Batch& batch = subMesh.model->batches[subMesh.batch];
+  Mesh::bindTextures(shaderProgram, batch.textures);
+  batch.arena->draw(&subMesh.geometry, &level.indices, 1);
+}
+
+void Model::requestTextureDetail(const void* object, float screenSize) {
+  const SubMesh& subMesh = *static_cast<const Level*>(object)->subMesh;
+  for (const Texture& texture : subMesh.model->batches[subMesh.batch].textures) {
+    TextureLoader::requestDetail(texture.handle, screenSize);
+  }
+}
+
+std::unique_ptr<Model> Model::load(const std::string& path, bool quantizeVertices) {
+  ProfileScope profileScope("Model import");
+  auto startTime = std::chrono::steady_clock::now();
+
+  auto sep = path.find_last_of('/');
+  if (sep == std::string::npos) {
+    sep = 0;
+  }
+
+  std::unique_ptr<Model> model(new Model(path.substr(0, sep), quantizeVertices));
+
+  /* Warm start: the processed geometry is already on disk, so skip Assimp
+   * entirely. */
+  std::string cachePath = MeshCache::pathFor(path, model->vertexStride());
+  if (auto cache = MeshCache::open(cachePath, path, IMPORT_FLAGS, model->vertexStride())) {
+    model->loadFromCache(*cache);
+    model->finishLoading();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    std::cout << "Loaded model '" << path << "' from mesh cache in " << elapsed.count() << " ms" << std::endl;
+    return model;
+  }
 
-std::unique_ptr<Model> Model::load(const std::string& path) {
   Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+  const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
 
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
     std::cerr << "Assimp error: " << importer.GetErrorString() << std::endl;
     return nullptr;
   }
 
-  auto sep = path.find_last_of('/');
-  if (sep == std::string::npos) {
-    sep = 0;
+  MeshCache::Writer cacheWriter(path, IMPORT_FLAGS, model->vertexStride());
+  /* Meshes may be shared between nodes, so process each one once, up front,
+   * and let the nodes refer to them by index. */
+  for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+    model->processMesh(scene->mMeshes[i], scene, cacheWriter);
   }
+  model->processNode(scene->mRootNode, NO_PARENT, cacheWriter);
+  model->finishLoading();
 
-  return std::unique_ptr<Model>(new Model(path.substr(0, sep), scene));
-}
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+  std::cout << "Imported model '" << path << "' with Assimp in " << elapsed.count() << " ms" << std::endl;
+
+  cacheWriter.write(cachePath);
 
-Model::Model(std::string directory, const aiScene* scene)
-  : directory(std::move(directory)) {
-  processNode(scene->mRootNode, scene);
+  return model;
 }
 
-void Model::processNode(const aiNode* node, const aiScene* scene) {
-  for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-    const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-    processMesh(mesh, scene);
-  }
+void Model::processNode(const aiNode* node, uint32_t parent, MeshCache::Writer& cacheWriter) {
+  uint32_t index = static_cast<uint32_t>(nodes.size());
+
+  /* Assimp matrices are row-major, glm's column-major. */
+  glm::mat4 transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+  std::vector<uint32_t> meshes(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+  MeshCache::NodeRecord record = { parent, {}, meshes };
+  std::copy_n(glm::value_ptr(transform), record.transform.size(), record.transform.begin());
+  cacheWriter.addNode(std::move(record));
+
+  nodes.push_back({ parent, transform, std::move(meshes) });
 
   for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], index, cacheWriter);
+  }
+}
+
+template <typename VertexType>
+void Model::addMesh(const std::vector<VertexType>& vertices, const std::vector<GLuint>& indices, std::vector<MeshCache::LodRecord> lods,
+                    std::vector<Texture> textures, MeshCache::Writer& cacheWriter) {
+  std::vector<MeshCache::TextureRecord> textureRecords;
+  for (const auto& texture : textures) {
+    textureRecords.push_back({ texture.name, texture.path });
   }
+  addGeometry(vertices.data(), vertices.size(), indices.data(), indices.size(), lods, std::move(textures));
+
+  cacheWriter.addMesh(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()),
+                      std::move(textureRecords), std::move(lods));
 }
 
-void Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
-  struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoord;
+void Model::addGeometry(const void* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount,
+                        const std::vector<MeshCache::LodRecord>& lods, std::vector<Texture> textures) {
+  GeometryArena::Handle geometry = arena->allocate(vertices, vertexCount, indices, indexCount);
+
+  /* Meshes that share their textures can be drawn with a single call. */
+  auto sameTextures = [&textures](const Batch& batch) {
+    return std::equal(batch.textures.begin(), batch.textures.end(), textures.begin(), textures.end(),
+                      [](const Texture& lhs, const Texture& rhs) { return lhs.id == rhs.id && lhs.name == rhs.name; });
   };
+  auto batch = std::find_if(batches.begin(), batches.end(), sameTextures);
+  if (batch == batches.end()) {
+    batches.push_back({ arena.get(), std::move(textures), {}, {} });
+    batch = std::prev(batches.end());
+  }
+  /* Meshes without levels of detail have just the one. */
+  std::vector<Level> levels;
+  std::vector<LodLevel> lodLevels;
+  for (const auto& lod : lods) {
+    levels.push_back({ nullptr, { lod.firstIndex, lod.indexCount } });
+    lodLevels.push_back({ nullptr, lod.error, lod.indexCount / 3 });
+  }
+  if (levels.empty()) {
+    levels.push_back({ nullptr, { 0, static_cast<GLuint>(indexCount) } });
+  }
+
+  batch->geometry.push_back(geometry);
+  batch->indices.push_back(levels.front().indices);
 
-  std::vector<Vertex> vertices;
-  std::vector<unsigned int> indices;
+  uint32_t batchIndex = static_cast<uint32_t>(std::distance(batches.begin(), batch));
+  subMeshes.push_back({ this, batchIndex, geometry, computeBounds(vertices, vertexCount), std::move(levels), std::move(lodLevels) });
+}
+
+void Model::loadFromCache(const MeshCache& cache) {
+  for (const auto& view : cache.getMeshes()) {
+    std::vector<Texture> textures;
+    for (const auto& record : view.textures) {
+      textures.push_back({ TextureLoader::loadAsync(record.path), record.name, record.path });
+    }
+    /* The views point straight into the mapped file. */
+    addGeometry(view.vertices, view.vertexCount, view.indices, view.indexCount, view.lods, std::move(textures));
+  }
+
+  for (const auto& record : cache.getNodes()) {
+    nodes.push_back({ record.parent, glm::make_mat4(record.transform.data()), record.meshes });
+  }
+}
+
+void Model::finishLoading(void) {
+  /* The sub-meshes have stopped moving around in memory. */
+  for (auto& subMesh : subMeshes) {
+    for (size_t i = 0; i < subMesh.levels.size(); ++i) {
+      subMesh.levels[i].subMesh = &subMesh;
+      if (i < subMesh.lods.size()) {
+        subMesh.lods[i].object = &subMesh.levels[i];
+      }
+    }
+  }
+
+  std::vector<unsigned int> references(subMeshes.size(), 0);
+  nodeModelTransforms.resize(nodes.size());
+  bool first = true;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const Node& node = nodes[i];
+    nodeModelTransforms[i] = node.parent == NO_PARENT ? node.transform : nodeModelTransforms[node.parent] * node.transform;
+
+    for (uint32_t mesh : node.meshes) {
+      ++references[mesh];
+      if (nodeModelTransforms[i] != glm::mat4(1.0f)) {
+        batchable = false;
+      }
+
+      Bounds meshBounds = { transform(subMeshes[mesh].bounds.box, nodeModelTransforms[i]),
+                            transform(subMeshes[mesh].bounds.sphere, nodeModelTransforms[i]) };
+      if (first) {
+        bounds = meshBounds;
+        first = false;
+      } else {
+        grow(bounds.box, meshBounds.box);
+        grow(bounds.sphere, meshBounds.sphere);
+      }
+    }
+  }
+
+  for (unsigned int count : references) {
+    if (count != 1) {
+      batchable = false;
+    }
+  }
+}
+
+void Model::processMesh(const aiMesh* mesh, const aiScene* scene, MeshCache::Writer& cacheWriter) {
+  std::vector<Vertex> vertices(mesh->mNumVertices);
+  std::vector<GLuint> indices;
   std::vector<Texture> textures;
 
   /* Walk through each of the mesh's vertices. */
   for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-    Vertex vertex;
+    Vertex& vertex = vertices[i];
     /* Positions */
     vertex.position = glm::vec3(
       mesh->mVertices[i].x,
@@ -68,6 +298,8 @@ void Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
         mesh->mNormals[i].y,
         mesh->mNormals[i].z
       );
+    } else {
+      vertex.normal = glm::vec3(0.0f);
     }
     /* Texture coordinates */
     if (mesh->mTextureCoords[0]) {
@@ -78,11 +310,11 @@ void Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
     } else {
       vertex.texCoord = glm::vec2(0.0f);
     }
-    vertices.push_back(vertex);
   }
 
   /* Now walk through each of the mesh's faces and retrieve the corresponding
    * vertex indices. */
+  indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
   for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
     aiFace face = mesh->mFaces[i];
     for (unsigned int j = 0; j < face.mNumIndices; j++) {
@@ -90,6 +322,47 @@ void Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
     }
   }
 
+  /* Assimp hands us vertices in file order, with a copy per face corner for
+   * many formats. Weld the duplicates and reorder indices and vertices so the
+   * GPU's post-transform cache and vertex fetch get as many hits as
+   * possible. Since this runs before the mesh cache is written, warm loads
+   * get the optimised geometry for free. */
+  VertexCacheStatistics before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+  size_t originalVertexCount = vertices.size();
+  vertices.resize(weldVertices(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+  optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+  vertices.resize(optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+  VertexCacheStatistics after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+  std::cout << "Optimised mesh (" << indices.size() / 3 << " triangles): "
+            << originalVertexCount << " -> " << vertices.size() << " vertices, "
+            << "ACMR " << before.acmr << " -> " << after.acmr << ", "
+            << "ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+  /* Levels of detail, each simplified from the full mesh so errors don't
+   * compound, and stored after it in the same index array. They all index
+   * the full mesh's vertices, so the fetch order above only suits the first
+   * one; the cache order is optimised per level. */
+  std::vector<MeshCache::LodRecord> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+  std::vector<GLuint> simplified(indices.size());
+  size_t fullIndexCount = indices.size();
+  for (size_t level = 1; level < MAX_LOD_LEVELS; ++level) {
+    size_t previousCount = lods.back().indexCount;
+    size_t targetCount = previousCount / 6 * 3;
+    float error;
+    size_t count = simplifyMesh(simplified.data(), indices.data(), fullIndexCount, vertices.data(), vertices.size(), sizeof(Vertex), targetCount, &error);
+    /* Stop once the simplifier stalls on locked seams and borders; a level
+     * that saves little isn't worth its memory. */
+    if (count == 0 || count > previousCount * 3 / 4) {
+      break;
+    }
+    optimizeVertexCache(simplified.data(), count, vertices.size());
+    lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), error });
+    indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+  }
+  if (lods.size() > 1) {
+    std::cout << "Generated " << lods.size() - 1 << " levels of detail, down to " << lods.back().indexCount / 3 << " triangles" << std::endl;
+  }
+
   static const std::unordered_map<aiTextureType, std::string> supportedTextureTypes = {
     { aiTextureType_AMBIENT, "ambient" },
     { aiTextureType_DIFFUSE, "diffuse" },
@@ -105,14 +378,24 @@ void Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
       aiString str;
       material->GetTexture(pair.first, i, &str);
       std::string path = directory + "/" + str.C_Str();
-      GLuint textureID = TextureLoader::load(path);
-      if (textureID != 0) {
-        /* Retrieve texture number. */
-        int number = textureNrs[pair.second]++;
-        textures.push_back({ textureID, "material." + pair.second + std::to_string(number), path });
-      }
+      /* Decoding happens in the background; the mesh draws with a
+       * placeholder until `TextureLoader::processUploads` swaps it in. */
+      TextureHandle texture = TextureLoader::loadAsync(path);
+      /* Retrieve texture number. */
+      int number = textureNrs[pair.second]++;
+      textures.push_back({ std::move(texture), "material." + pair.second + std::to_string(number), path });
     }
   }
 
-  meshes.emplace_back(vertices, indices, textures);
+  /* Quantize last: welding and the optimisers compare full-precision
+   * vertices, so rounding can't merge vertices that differ. */
+  if (quantizeVertices) {
+    std::vector<QuantizedVertex> quantizedVertices(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      quantizedVertices[i] = quantize(vertices[i]);
+    }
+    addMesh(quantizedVertices, indices, std::move(lods), std::move(textures), cacheWriter);
+  } else {
+    addMesh(vertices, indices, std::move(lods), std::move(textures), cacheWriter);
+  }
 }
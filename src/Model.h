@@ -4,30 +4,143 @@
 #include <string>
 #include <vector>
 
+#include "Bounds.h"
+#include "GeometryArena.h"
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
 
 class aiMesh;
 class aiNode;
 class aiScene;
 
 class ShaderProgram;
+class UniformBuffer;
 
 class Model {
 public:
-  static std::unique_ptr<Model> load(const std::string& path);
+  struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+  };
 
-  void draw(const ShaderProgram& shaderProgram) const {
-    for (const auto& mesh : meshes) {
-      mesh.draw(shaderProgram);
-    }
+  /* 16 bytes instead of 32. Positions stay floats in the shader (`w` is 1), so
+   * no dequantisation is needed; half floats keep about three significant
+   * digits, which is plenty for models of moderate extent. */
+  struct QuantizedVertex {
+    Half4 position;
+    PackedSnorm3x10_1x2 normal;
+    Half2 texCoord;
+  };
+
+  static std::unique_ptr<Model> load(const std::string& path, bool quantizeVertices = false);
+
+  Model(const Model&) = delete;
+  Model& operator=(const Model&) = delete;
+
+  ~Model(void);
+
+  /* Draws every mesh at full detail where its node puts it, writing the
+   * object data to `objectBuffer`. Models without node transforms issue one
+   * multi-draw call per distinct set of textures; others one call per
+   * mesh. */
+  void draw(const ShaderProgram& shaderProgram, UniformBuffer& objectBuffer, const glm::mat4& modelMatrix) const;
+
+  /* Around all meshes, in model space. */
+  const Bounds& getBounds(void) const {
+    return bounds;
   }
 
+  /* Adds the model's node hierarchy to `scene` below a new node placed at
+   * `transform` relative to `parent`, and returns that node. Every mesh gets
+   * a node of its own, so it is culled, sorted and given a level of detail
+   * individually. The model must outlive the nodes. */
+  SceneGraph::Node instantiate(SceneGraph& scene, SceneGraph::Node parent, const glm::mat4& transform,
+                               const ShaderProgram& shaderProgram, RenderLayer layer = RenderLayer::SOLID) const;
+
 private:
-  Model(std::string directory, const aiScene* scene);
+  /* A node of the imported hierarchy. Parents come before their children. */
+  struct Node {
+    uint32_t parent;
+    /* Relative to the parent. */
+    glm::mat4 transform;
+    std::vector<uint32_t> meshes;
+  };
+
+  /* Meshes sharing the same textures. */
+  struct Batch {
+    const GeometryArena* arena;
+    std::vector<Texture> textures;
+    std::vector<GeometryArena::Handle> geometry;
+    /* The full-detail indices of each. */
+    std::vector<GeometryArena::IndexRange> indices;
+  };
+
+  struct SubMesh;
+
+  /* The levels of detail of a mesh share its vertices; each is a run of
+   * indices stored one after another in the mesh's allocation. */
+  struct Level {
+    const SubMesh* subMesh;
+    GeometryArena::IndexRange indices;
+  };
+
+  struct SubMesh {
+    const Model* model;
+    uint32_t batch;
+    GeometryArena::Handle geometry;
+    /* In the mesh's own space, before its node's transform. */
+    Bounds bounds;
+    std::vector<Level> levels;
+    /* The same, as the scene graph sees them. */
+    std::vector<LodLevel> lods;
+  };
 
-  void processNode(const aiNode* node, const aiScene* scene);
-  void processMesh(const aiMesh* mesh, const aiScene* scene);
+  static constexpr uint32_t NO_PARENT = ~0u;
+
+  /* At most this many levels per mesh, each with about half the triangles of
+   * the one before. */
+  static constexpr size_t MAX_LOD_LEVELS = 4;
+
+  static void drawLevel(const void* level, const ShaderProgram& shaderProgram);
+  /* Streams in texture detail for how large the level's mesh appears. */
+  static void requestTextureDetail(const void* level, float screenSize);
+
+  Model(std::string directory, bool quantizeVertices);
+
+  void processNode(const aiNode* node, uint32_t parent, MeshCache::Writer& cacheWriter);
+  void processMesh(const aiMesh* mesh, const aiScene* scene, MeshCache::Writer& cacheWriter);
+
+  template <typename VertexType>
+  void addMesh(const std::vector<VertexType>& vertices, const std::vector<GLuint>& indices, std::vector<MeshCache::LodRecord> lods,
+               std::vector<Texture> textures, MeshCache::Writer& cacheWriter);
+
+  void addGeometry(const void* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount,
+                   const std::vector<MeshCache::LodRecord>& lods, std::vector<Texture> textures);
+
+  void loadFromCache(const MeshCache& cache);
+
+  /* Derives what depends on the whole hierarchy once it is loaded. */
+  void finishLoading(void);
+
+  uint32_t vertexStride(void) const {
+    return quantizeVertices ? sizeof(QuantizedVertex) : sizeof(Vertex);
+  }
 
   std::string directory;
-  std::vector<Mesh> meshes;
+  bool quantizeVertices;
+  /* Shared with every other model of the same vertex format. */
+  std::shared_ptr<GeometryArena> arena;
+  Bounds (*computeBounds)(const void* vertices, size_t count);
+  std::vector<Batch> batches;
+  std::vector<SubMesh> subMeshes;
+  std::vector<Node> nodes;
+  /* Node to model space, per node. */
+  std::vector<glm::mat4> nodeModelTransforms;
+  /* Whether every mesh is drawn exactly once, untransformed, so the batches
+   * can be drawn as they are. */
+  bool batchable = true;
+  Bounds bounds;
 };
@@ -0,0 +1,257 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+namespace {
+
+/* Frames between issuing a GPU scope's queries and collecting them. */
+constexpr size_t FRAME_LATENCY = 2;
+
+struct Event {
+  const char* name;
+  uint32_t thread;
+  int64_t start;
+  int64_t end;
+};
+
+/* Shared by every thread that records. Never destroyed, so that threads
+ * still running at exit can't record into a dead buffer. */
+struct EventBuffer {
+  std::mutex mutex;
+  std::vector<Event> events;
+  size_t next = 0;
+  bool wrapped = false;
+  std::vector<std::pair<uint32_t, const char*>> threadNames;
+};
+
+EventBuffer& eventBuffer(void) {
+  static EventBuffer* buffer = new EventBuffer;
+  return *buffer;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+uint32_t currentThread(void) {
+  static std::atomic<uint32_t> nextThread(Profiler::GPU_THREAD + 1);
+  thread_local uint32_t thread = nextThread++;
+  return thread;
+}
+
+void push(const Event& event) {
+  EventBuffer& buffer = eventBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.empty()) {
+    return;
+  }
+  buffer.events[buffer.next] = event;
+  if (++buffer.next == buffer.events.size()) {
+    buffer.next = 0;
+    buffer.wrapped = true;
+  }
+}
+
+/* GPU state, only touched from the GL thread. */
+struct GpuScope {
+  const char* name;
+  GLuint beginQuery;
+  GLuint endQuery;
+};
+
+struct GpuFrame {
+  /* Grows to the most queries a frame has needed, then gets reused. */
+  std::vector<GLuint> queries;
+  size_t usedQueries = 0;
+  std::vector<GpuScope> scopes;
+  /* CPU clock minus GPU clock, sampled when the frame's first scope began. */
+  int64_t clockOffset = 0;
+};
+
+/* One more than the latency, for the frame being recorded. */
+constexpr size_t GPU_FRAMES = FRAME_LATENCY + 1;
+
+GpuFrame gpuFrames[GPU_FRAMES];
+size_t gpuFrameIndex = 0;
+std::vector<size_t> openGpuScopes;
+size_t droppedGpuScopes = 0;
+
+GLuint nextQuery(GpuFrame& frame) {
+  if (frame.usedQueries == frame.queries.size()) {
+    GLuint query;
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+  }
+  return frame.queries[frame.usedQueries++];
+}
+
+/* Turns a frame's finished queries into events, then frees the frame for
+ * reuse. Unless `wait`, scopes whose results aren't in yet are dropped. */
+void collect(GpuFrame& frame, bool wait) {
+  for (const GpuScope& scope : frame.scopes) {
+    /* Commands complete in order, so once the end is in, so is the
+     * beginning. */
+    GLuint available = GL_TRUE;
+    if (!wait) {
+      glGetQueryObjectuiv(scope.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (!available) {
+      ++droppedGpuScopes;
+      continue;
+    }
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+    push({ scope.name, Profiler::GPU_THREAD, static_cast<int64_t>(begin) + frame.clockOffset,
+           static_cast<int64_t>(end) + frame.clockOffset });
+  }
+  frame.scopes.clear();
+  frame.usedQueries = 0;
+}
+
+void writeEscaped(std::ostream& out, const char* text) {
+  for (const char* c = text; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\';
+    }
+    if (static_cast<unsigned char>(*c) >= 0x20) {
+      out << *c;
+    }
+  }
+}
+
+void writeThreadName(std::ostream& out, uint32_t thread, const char* name) {
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"";
+  writeEscaped(out, name);
+  out << "\"}}";
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::enabled(false);
+
+void Profiler::setEnabled(bool enable) {
+  if (enable) {
+    EventBuffer& buffer = eventBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.empty()) {
+      buffer.events.resize(CAPACITY);
+    }
+  }
+  enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const char* name) {
+  uint32_t thread = currentThread();
+  EventBuffer& buffer = eventBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.threadNames.emplace_back(thread, name);
+}
+
+int64_t Profiler::now(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t end) {
+  push({ name, currentThread(), start, end });
+}
+
+void Profiler::beginGpuScope(const char* name) {
+  GpuFrame& frame = gpuFrames[gpuFrameIndex % GPU_FRAMES];
+  if (frame.scopes.empty()) {
+    /* Reading the GPU clock directly doesn't wait for queued commands, so
+     * it lines up with the CPU clock closely enough to place the frame. */
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    frame.clockOffset = now() - gpuNow;
+  }
+
+  GLuint query = nextQuery(frame);
+  glQueryCounter(query, GL_TIMESTAMP);
+  openGpuScopes.push_back(frame.scopes.size());
+  frame.scopes.push_back({ name, query, 0 });
+
+  if (GLExtensions::pushDebugGroup) {
+    GLExtensions::pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+  }
+}
+
+void Profiler::endGpuScope(void) {
+  if (openGpuScopes.empty()) {
+    return;
+  }
+  if (GLExtensions::popDebugGroup) {
+    GLExtensions::popDebugGroup();
+  }
+
+  GpuFrame& frame = gpuFrames[gpuFrameIndex % GPU_FRAMES];
+  GLuint query = nextQuery(frame);
+  glQueryCounter(query, GL_TIMESTAMP);
+  frame.scopes[openGpuScopes.back()].endQuery = query;
+  openGpuScopes.pop_back();
+}
+
+void Profiler::endFrame(void) {
+  while (!openGpuScopes.empty()) {
+    endGpuScope();
+  }
+  ++gpuFrameIndex;
+  collect(gpuFrames[gpuFrameIndex % GPU_FRAMES], false);
+}
+
+void Profiler::finish(void) {
+  while (!openGpuScopes.empty()) {
+    endGpuScope();
+  }
+  for (size_t i = 1; i <= FRAME_LATENCY; ++i) {
+    collect(gpuFrames[(gpuFrameIndex + i) % GPU_FRAMES], true);
+  }
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "Failed to open trace file: " << path << std::endl;
+    return false;
+  }
+
+  EventBuffer& buffer = eventBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+
+  /* Timestamps are in microseconds. */
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+  writeThreadName(out, GPU_THREAD, "GPU");
+  for (const auto& threadName : buffer.threadNames) {
+    out << ",\n";
+    writeThreadName(out, threadName.first, threadName.second);
+  }
+
+  size_t count = buffer.wrapped ? buffer.events.size() : buffer.next;
+  size_t first = buffer.wrapped ? buffer.next : 0;
+  for (size_t i = 0; i < count; ++i) {
+    const Event& event = buffer.events[(first + i) % buffer.events.size()];
+    out << ",\n{\"name\":\"";
+    writeEscaped(out, event.name);
+    out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.start / 1000.0
+        << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+  if (!out) {
+    std::cerr << "Failed to write trace file: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+size_t Profiler::getDroppedGpuScopes(void) {
+  return droppedGpuScopes;
+}
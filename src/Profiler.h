@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Scoped timing markers for the CPU and the GPU, kept in a ring buffer of the
+ * most recent events and exported as Chrome trace events, which Perfetto and
+ * chrome://tracing open directly.
+ *
+ * Everything is off until `setEnabled(true)`; until then a scope costs one
+ * relaxed atomic load. Scope names are stored as pointers, so they must be
+ * string literals (or otherwise outlive the profiler).
+ *
+ * GPU scopes bracket GL commands with timestamp queries and a debug group.
+ * Their results are collected two frames later and only if already
+ * available, so profiling never waits on the GPU; a frame whose queries are
+ * late loses its GPU events instead. */
+class Profiler {
+public:
+  /* Trace thread of the GPU scopes. CPU threads are numbered from 1 in the
+   * order they first record an event. */
+  static constexpr uint32_t GPU_THREAD = 0;
+  /* Events kept; older ones are overwritten. */
+  static constexpr size_t CAPACITY = 1 << 16;
+
+  static void setEnabled(bool enabled);
+
+  static bool isEnabled(void) {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  /* Labels the calling thread's track in the trace. */
+  static void setThreadName(const char* name);
+
+  /* Nanoseconds since the profiler started, on the clock all events use. */
+  static int64_t now(void);
+
+  /* Records a finished CPU scope of the calling thread. Safe from any
+   * thread. */
+  static void record(const char* name, int64_t start, int64_t end);
+
+  /* GPU scopes nest, but must be opened and closed on the GL thread in the
+   * same frame. */
+  static void beginGpuScope(const char* name);
+  static void endGpuScope(void);
+
+  /* Closes the frame's GPU scopes and collects those of two frames ago.
+   * Call once per frame, after its last GPU scope. */
+  static void endFrame(void);
+
+  /* Waits for the GPU scopes still in flight. Call after the last frame,
+   * before exporting. */
+  static void finish(void);
+
+  /* Writes the buffered events, oldest first. */
+  static bool writeChromeTrace(const std::string& path);
+
+  /* GPU events that were dropped because their queries weren't ready. */
+  static size_t getDroppedGpuScopes(void);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+/* Times the enclosing block on the calling thread. */
+class ProfileScope {
+public:
+  explicit ProfileScope(const char* name)
+    : name(name)
+    , start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+
+  ~ProfileScope(void) {
+    if (start >= 0) {
+      Profiler::record(name, start, Profiler::now());
+    }
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  const char* name;
+  int64_t start;
+};
+
+/* Times the GL commands issued in the enclosing block. GL thread only. */
+class GpuProfileScope {
+public:
+  explicit GpuProfileScope(const char* name)
+    : active(Profiler::isEnabled()) {
+    if (active) {
+      Profiler::beginGpuScope(name);
+    }
+  }
+
+  ~GpuProfileScope(void) {
+    if (active) {
+      Profiler::endGpuScope();
+    }
+  }
+
+  GpuProfileScope(const GpuProfileScope&) = delete;
+  GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+  bool active;
+};
@@ -0,0 +1,157 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "GLExtensions.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+namespace {
+
+/* Bump this whenever the file layout changes. */
+constexpr uint32_t PROGRAM_BINARY_CACHE_VERSION = 1;
+
+constexpr char PROGRAM_BINARY_CACHE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'P', 'R', 'O', 'G' };
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t binaryFormat;
+  uint64_t key;
+  uint64_t binarySize;
+};
+
+uint64_t hashString(GLenum name, uint64_t hash) {
+  const GLubyte* value = glGetString(name);
+  return value ? fnv1a64(reinterpret_cast<const char*>(value), hash) : hash;
+}
+
+} // namespace
+
+bool ProgramBinaryCache::isAvailable(void) {
+  static const bool available = [](void) {
+    if (GLExtensions::getProgramBinary == nullptr) {
+      return false;
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+  }();
+  return available;
+}
+
+uint64_t ProgramBinaryCache::keyFor(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines) {
+  static const uint64_t driverHash = hashString(GL_VERSION, hashString(GL_RENDERER, hashString(GL_VENDOR, FNV1A64_OFFSET_BASIS)));
+
+  /* Lengths go in too, so moving text from one part to the next changes the
+   * key. */
+  uint64_t hash = driverHash;
+  for (const std::string* part : { &vertexSource, &fragmentSource, &defines }) {
+    uint64_t length = part->size();
+    hash = fnv1a64(&length, sizeof length, hash);
+    hash = fnv1a64(*part, hash);
+  }
+  return hash;
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t key) {
+  std::ostringstream name;
+  name << ".cache/programs/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+  return name.str();
+}
+
+GLuint ProgramBinaryCache::load(uint64_t key) {
+  if (!isAvailable()) {
+    return 0;
+  }
+  std::unique_ptr<MappedFile> file = MappedFile::open(pathFor(key));
+  if (!file) {
+    return 0;
+  }
+
+  FileHeader header;
+  if (file->size() < sizeof header) {
+    return 0;
+  }
+  std::memcpy(&header, file->data(), sizeof header);
+  if (std::memcmp(header.magic, PROGRAM_BINARY_CACHE_MAGIC, sizeof header.magic) != 0
+      || header.version != PROGRAM_BINARY_CACHE_VERSION || header.key != key
+      || header.binarySize > file->size() - sizeof header) {
+    return 0;
+  }
+
+  GLuint programID = glCreateProgram();
+  GLExtensions::programBinary(programID, header.binaryFormat, file->data() + sizeof header, static_cast<GLsizei>(header.binarySize));
+  GLint success;
+  glGetProgramiv(programID, GL_LINK_STATUS, &success);
+  if (!success) {
+    std::cerr << "Driver rejected cached program binary: " << pathFor(key) << std::endl;
+    glDeleteProgram(programID);
+    return 0;
+  }
+  return programID;
+}
+
+bool ProgramBinaryCache::store(uint64_t key, GLuint programID) {
+  if (!isAvailable()) {
+    return false;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+  std::vector<unsigned char> binary(static_cast<size_t>(length));
+  GLenum binaryFormat = 0;
+  GLExtensions::getProgramBinary(programID, length, &length, &binaryFormat, binary.data());
+
+  FileHeader header = {};
+  std::memcpy(header.magic, PROGRAM_BINARY_CACHE_MAGIC, sizeof header.magic);
+  header.version = PROGRAM_BINARY_CACHE_VERSION;
+  header.binaryFormat = binaryFormat;
+  header.key = key;
+  header.binarySize = static_cast<uint64_t>(length);
+
+  std::string cachePath = pathFor(key);
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), ec);
+
+  /* Write to a temporary file and rename it into place, so that a crash or a
+   * concurrent reader never observes a half-written binary. */
+  std::string tempPath = cachePath + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Failed to write program binary: " << cachePath << std::endl;
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof header);
+  out.write(reinterpret_cast<const char*>(binary.data()), length);
+  out.close();
+  if (!out) {
+    std::filesystem::remove(tempPath, ec);
+    std::cerr << "Failed to write program binary: " << cachePath << std::endl;
+    return false;
+  }
+
+  std::filesystem::rename(tempPath, cachePath, ec);
+  if (ec) {
+    std::filesystem::remove(tempPath, ec);
+    std::cerr << "Failed to write program binary: " << cachePath << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void ProgramBinaryCache::prepareForLink(GLuint programID) {
+  if (isAvailable()) {
+    GLExtensions::programParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
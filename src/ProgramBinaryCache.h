@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+/* An on-disk cache of linked shader programs, as returned by
+ * `glGetProgramBinary`. A binary is only valid for the exact sources and
+ * defines it was built from, on the exact driver that built it, so all of
+ * those go into its key; anything else is a different file.
+ *
+ * Drivers may still reject a binary they produced, e.g. after an update that
+ * kept the version string. `load` then reports a miss, and the caller
+ * compiles from source and stores a fresh binary. */
+class ProgramBinaryCache {
+public:
+  /* Whether the context can retrieve and load program binaries. */
+  static bool isAvailable(void);
+
+  /* Hashes the sources, the defines and the vendor, renderer and version
+   * strings of the current context. */
+  static uint64_t keyFor(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines);
+
+  static std::string pathFor(uint64_t key);
+
+  /* A linked program, or 0 on a miss or when the driver rejects the binary. */
+  static GLuint load(uint64_t key);
+
+  /* The program must have been linked with the retrievable hint set; see
+   * `prepareForLink`. */
+  static bool store(uint64_t key, GLuint programID);
+
+  /* Asks the driver to keep the binary of `programID` around. Call before
+   * linking it. */
+  static void prepareForLink(GLuint programID);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Maps a depth onto an unsigned integer with the same ordering. Depths are
+ * clamped to be non-negative, and the bit patterns of non-negative floats
+ * already sort like integers. */
+inline uint32_t depthBits(float depth) {
+  depth = depth > 0.0f ? depth : 0.0f;
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof bits);
+  return bits;
+}
+
+/* Sorts `entries` by their unsigned integer `key` member, in increasing
+ * order and stably: an LSD radix sort, a byte per pass. All histograms are
+ * built in one sweep up front, and passes where every key has the same byte
+ * are skipped, which is common for the high bytes. `scratch` is working
+ * space, kept by the caller so that sorting every frame doesn't allocate. */
+template <typename Entry>
+void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch) {
+  constexpr int PASSES = sizeof(Entry::key);
+  size_t count = entries.size();
+  scratch.resize(count);
+
+  size_t histograms[PASSES][256] = {};
+  for (const auto& entry : entries) {
+    for (int pass = 0; pass < PASSES; ++pass) {
+      ++histograms[pass][(entry.key >> (pass * 8)) & 0xff];
+    }
+  }
+
+  for (int pass = 0; pass < PASSES; ++pass) {
+    size_t* histogram = histograms[pass];
+    if (count == 0 || histogram[(entries[0].key >> (pass * 8)) & 0xff] == count) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (int bucket = 0; bucket < 256; ++bucket) {
+      size_t bucketSize = histogram[bucket];
+      histogram[bucket] = offset;
+      offset += bucketSize;
+    }
+    for (const auto& entry : entries) {
+      scratch[histogram[(entry.key >> (pass * 8)) & 0xff]++] = entry;
+    }
+    entries.swap(scratch);
+  }
+}
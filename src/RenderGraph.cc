@@ -0,0 +1,393 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Profiler.h"
+
+namespace {
+
+struct FormatInfo {
+  /* For `glTexImage2D` when there is no `glTexStorage2D`. */
+  GLenum format;
+  GLenum type;
+  size_t bytesPerPixel;
+};
+
+FormatInfo formatInfo(GLenum internalFormat) {
+  switch (internalFormat) {
+  case GL_R8:                 return { GL_RED,             GL_UNSIGNED_BYTE,              1 };
+  case GL_RG8:                return { GL_RG,              GL_UNSIGNED_BYTE,              2 };
+  case GL_RGB8:               return { GL_RGB,             GL_UNSIGNED_BYTE,              4 };
+  case GL_R16F:               return { GL_RED,             GL_HALF_FLOAT,                 2 };
+  case GL_RG16F:              return { GL_RG,              GL_HALF_FLOAT,                 4 };
+  case GL_RGB16F:             return { GL_RGB,             GL_HALF_FLOAT,                 8 };
+  case GL_RGBA16F:            return { GL_RGBA,            GL_HALF_FLOAT,                 8 };
+  case GL_R11F_G11F_B10F:     return { GL_RGB,             GL_FLOAT,                      4 };
+  case GL_R32F:               return { GL_RED,             GL_FLOAT,                      4 };
+  case GL_RGBA32F:            return { GL_RGBA,            GL_FLOAT,                      16 };
+  case GL_DEPTH_COMPONENT16:  return { GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT,             2 };
+  case GL_DEPTH_COMPONENT24:  return { GL_DEPTH_COMPONENT, GL_UNSIGNED_INT,               4 };
+  case GL_DEPTH_COMPONENT32F: return { GL_DEPTH_COMPONENT, GL_FLOAT,                      4 };
+  case GL_DEPTH24_STENCIL8:   return { GL_DEPTH_STENCIL,   GL_UNSIGNED_INT_24_8,          4 };
+  case GL_DEPTH32F_STENCIL8:  return { GL_DEPTH_STENCIL,   GL_FLOAT_32_UNSIGNED_INT_24_8_REV, 8 };
+  default:                    return { GL_RGBA,            GL_UNSIGNED_BYTE,              4 };
+  }
+}
+
+bool isDepthFormat(GLenum internalFormat) {
+  return formatInfo(internalFormat).format == GL_DEPTH_COMPONENT || formatInfo(internalFormat).format == GL_DEPTH_STENCIL;
+}
+
+} // namespace
+
+RenderGraph::~RenderGraph(void) {
+  releaseObjects();
+  for (const Allocation& allocation : allocations) {
+    if (allocation.texture) {
+      GLState::deleteTexture(allocation.name);
+    } else {
+      glDeleteRenderbuffers(1, &allocation.name);
+    }
+  }
+}
+
+void RenderGraph::setOutput(GLuint framebuffer, int width, int height) {
+  if (framebuffer != outputFramebuffer || width != outputWidth || height != outputHeight) {
+    outputFramebuffer = framebuffer;
+    outputWidth = width;
+    outputHeight = height;
+    dirty = true;
+  }
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const char* name, GLenum internalFormat, float scale) {
+  return addResource(name, internalFormat, scale, true);
+}
+
+RenderGraph::Resource RenderGraph::createRenderbuffer(const char* name, GLenum internalFormat, float scale) {
+  return addResource(name, internalFormat, scale, false);
+}
+
+RenderGraph::Resource RenderGraph::addResource(const char* name, GLenum internalFormat, float scale, bool texture) {
+  resources.push_back({ name, internalFormat, scale, texture, 0, 0, 0, NO_PASS, NO_PASS });
+  dirty = true;
+  return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::addPass(const char* name, std::function<void(void)> execute) {
+  PassInfo pass;
+  pass.name = name;
+  pass.execute = std::move(execute);
+  pass.culled = false;
+  pass.framebuffer = 0;
+  pass.width = 0;
+  pass.height = 0;
+  passes.push_back(std::move(pass));
+  dirty = true;
+  return static_cast<Pass>(passes.size() - 1);
+}
+
+void RenderGraph::read(Pass pass, Resource resource) {
+  passes[pass].reads.push_back(resource);
+  dirty = true;
+}
+
+void RenderGraph::write(Pass pass, Resource resource, GLenum attachment) {
+  passes[pass].writes.push_back({ resource, attachment });
+  dirty = true;
+}
+
+GLuint RenderGraph::getTexture(Resource resource) const {
+  const ResourceInfo& info = resources[resource];
+  if (!info.texture || info.firstUse == NO_PASS) {
+    return 0;
+  }
+  return allocations[info.allocation].name;
+}
+
+void RenderGraph::execute(void) {
+  if (dirty) {
+    compile();
+  }
+
+  for (const PassInfo& pass : passes) {
+    if (pass.culled) {
+      continue;
+    }
+    ProfileScope profileScope(pass.name);
+    GpuProfileScope gpuProfileScope(pass.name);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer != 0 ? pass.framebuffer : outputFramebuffer);
+    glViewport(0, 0, pass.width, pass.height);
+    if (!pass.invalidateBefore.empty() && GLExtensions::invalidateFramebuffer) {
+      GLExtensions::invalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(pass.invalidateBefore.size()),
+                                          pass.invalidateBefore.data());
+    }
+
+    pass.execute();
+
+    if (!pass.invalidateAfter.empty() && GLExtensions::invalidateFramebuffer) {
+      GLExtensions::invalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(pass.invalidateAfter.size()),
+                                          pass.invalidateAfter.data());
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+  glViewport(0, 0, outputWidth, outputHeight);
+}
+
+void RenderGraph::compile(void) {
+  dirty = false;
+  releaseObjects();
+
+  cullPasses();
+  allocateResources();
+
+  for (PassInfo& pass : passes) {
+    if (!pass.culled && !createFramebuffer(pass)) {
+      pass.culled = true;
+    }
+  }
+
+  statistics = {};
+  statistics.passes = passes.size();
+  for (const PassInfo& pass : passes) {
+    statistics.culledPasses += pass.culled ? 1 : 0;
+  }
+  for (const ResourceInfo& resource : resources) {
+    if (resource.firstUse != NO_PASS) {
+      ++statistics.attachments;
+      statistics.unaliasedBytes += resource.width * resource.height * formatInfo(resource.internalFormat).bytesPerPixel;
+    }
+  }
+  statistics.allocations = allocations.size();
+  for (const Allocation& allocation : allocations) {
+    statistics.allocatedBytes += allocation.width * allocation.height * formatInfo(allocation.internalFormat).bytesPerPixel;
+  }
+
+  std::cout << "Render graph: " << statistics.passes - statistics.culledPasses << " of " << statistics.passes
+            << " passes, " << statistics.attachments << " attachments in " << statistics.allocations << " allocations, "
+            << statistics.allocatedBytes / 1024 << " KiB (" << statistics.unaliasedBytes / 1024
+            << " KiB without aliasing)" << std::endl;
+}
+
+void RenderGraph::cullPasses(void) {
+  /* Walking backwards, a pass runs if it writes the output or something a
+   * pass that runs after it uses. Writes draw on top of what earlier passes
+   * wrote, so they count as uses too. */
+  std::vector<bool> used(resources.size(), false);
+  for (size_t i = passes.size(); i-- > 0;) {
+    PassInfo& pass = passes[i];
+    pass.culled = true;
+    for (const Attachment& write : pass.writes) {
+      if (write.resource == OUTPUT || used[write.resource]) {
+        pass.culled = false;
+      }
+    }
+    if (pass.culled) {
+      continue;
+    }
+    for (Resource resource : pass.reads) {
+      used[resource] = true;
+    }
+    for (const Attachment& write : pass.writes) {
+      if (write.resource != OUTPUT) {
+        used[write.resource] = true;
+      }
+    }
+  }
+
+  for (ResourceInfo& resource : resources) {
+    resource.firstUse = NO_PASS;
+    resource.lastUse = NO_PASS;
+  }
+  auto use = [this](Resource resource, Pass pass) {
+    if (resource == OUTPUT) {
+      return;
+    }
+    ResourceInfo& info = resources[resource];
+    if (info.firstUse == NO_PASS) {
+      info.firstUse = pass;
+    }
+    info.lastUse = pass;
+  };
+  for (Pass i = 0; i < passes.size(); ++i) {
+    if (passes[i].culled) {
+      continue;
+    }
+    for (Resource resource : passes[i].reads) {
+      use(resource, i);
+    }
+    for (const Attachment& write : passes[i].writes) {
+      use(write.resource, i);
+    }
+  }
+}
+
+void RenderGraph::allocateResources(void) {
+  std::vector<Resource> order;
+  for (Resource i = 0; i < resources.size(); ++i) {
+    ResourceInfo& resource = resources[i];
+    resource.width = std::max(1, static_cast<int>(std::lround(outputWidth * resource.scale)));
+    resource.height = std::max(1, static_cast<int>(std::lround(outputHeight * resource.scale)));
+    if (resource.firstUse != NO_PASS) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [this](Resource lhs, Resource rhs) {
+    return resources[lhs].firstUse < resources[rhs].firstUse;
+  });
+
+  /* Greedily, in order of first use: a resource takes the first allocation
+   * of its kind that is free again by then. Allocations left over from the
+   * last build are reused where they still fit. */
+  for (Allocation& allocation : allocations) {
+    allocation.busyUntil = NO_PASS;
+  }
+  size_t previousCount = allocations.size();
+  for (Resource i : order) {
+    ResourceInfo& resource = resources[i];
+    uint32_t match = static_cast<uint32_t>(allocations.size());
+    for (uint32_t j = 0; j < allocations.size(); ++j) {
+      const Allocation& allocation = allocations[j];
+      bool free = allocation.busyUntil == NO_PASS || allocation.busyUntil < resource.firstUse;
+      if (free && allocation.texture == resource.texture && allocation.internalFormat == resource.internalFormat &&
+          allocation.width == resource.width && allocation.height == resource.height) {
+        match = j;
+        break;
+      }
+    }
+    if (match == allocations.size()) {
+      allocations.push_back({ 0, resource.texture, resource.internalFormat, resource.width, resource.height, NO_PASS });
+    }
+    resource.allocation = match;
+    allocations[match].busyUntil = resource.lastUse;
+  }
+
+  /* Drop what the new build doesn't need, then create what it needs and
+   * doesn't have yet. */
+  std::vector<uint32_t> remap(allocations.size());
+  size_t kept = 0;
+  for (uint32_t j = 0; j < allocations.size(); ++j) {
+    Allocation& allocation = allocations[j];
+    if (allocation.busyUntil == NO_PASS) {
+      if (j < previousCount) {
+        if (allocation.texture) {
+          GLState::deleteTexture(allocation.name);
+        } else {
+          glDeleteRenderbuffers(1, &allocation.name);
+        }
+      }
+      continue;
+    }
+    remap[j] = static_cast<uint32_t>(kept);
+    allocations[kept++] = allocation;
+  }
+  allocations.resize(kept);
+  for (Resource i : order) {
+    resources[i].allocation = remap[resources[i].allocation];
+  }
+
+  for (Allocation& allocation : allocations) {
+    if (allocation.name != 0) {
+      continue;
+    }
+    if (!allocation.texture) {
+      glGenRenderbuffers(1, &allocation.name);
+      glBindRenderbuffer(GL_RENDERBUFFER, allocation.name);
+      glRenderbufferStorage(GL_RENDERBUFFER, allocation.internalFormat, allocation.width, allocation.height);
+      continue;
+    }
+
+    glGenTextures(1, &allocation.name);
+    GLState::bindTexture(0, GL_TEXTURE_2D, allocation.name);
+    if (GLExtensions::texStorage2D) {
+      GLExtensions::texStorage2D(GL_TEXTURE_2D, 1, allocation.internalFormat, allocation.width, allocation.height);
+    } else {
+      FormatInfo info = formatInfo(allocation.internalFormat);
+      glTexImage2D(GL_TEXTURE_2D, 0, allocation.internalFormat, allocation.width, allocation.height, 0, info.format,
+                   info.type, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    /* Depth is compared or read texel for texel, never blended. */
+    GLint filter = isDepthFormat(allocation.internalFormat) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+}
+
+bool RenderGraph::createFramebuffer(PassInfo& pass) {
+  pass.invalidateBefore.clear();
+  pass.invalidateAfter.clear();
+
+  bool writesOutput = false;
+  for (const Attachment& write : pass.writes) {
+    writesOutput = writesOutput || write.resource == OUTPUT;
+  }
+  if (writesOutput) {
+    if (pass.writes.size() > 1) {
+      std::cerr << "Render pass '" << pass.name << "' writes both the output and attachments" << std::endl;
+      return false;
+    }
+    pass.width = outputWidth;
+    pass.height = outputHeight;
+    return true;
+  }
+
+  Pass index = static_cast<Pass>(&pass - passes.data());
+  glGenFramebuffers(1, &pass.framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+  std::vector<GLenum> drawBuffers;
+  for (const Attachment& write : pass.writes) {
+    const ResourceInfo& resource = resources[write.resource];
+    const Allocation& allocation = allocations[resource.allocation];
+    if (allocation.texture) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, write.attachment, GL_TEXTURE_2D, allocation.name, 0);
+    } else {
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, write.attachment, GL_RENDERBUFFER, allocation.name);
+    }
+    if (write.attachment >= GL_COLOR_ATTACHMENT0 && write.attachment <= GL_COLOR_ATTACHMENT15) {
+      drawBuffers.push_back(write.attachment);
+    }
+    pass.width = resource.width;
+    pass.height = resource.height;
+
+    /* Nothing before this pass wrote it, or nothing after it reads it. */
+    if (resource.firstUse == index) {
+      pass.invalidateBefore.push_back(write.attachment);
+    }
+    if (resource.lastUse == index) {
+      pass.invalidateAfter.push_back(write.attachment);
+    }
+  }
+  std::sort(drawBuffers.begin(), drawBuffers.end());
+  if (drawBuffers.empty()) {
+    glDrawBuffer(GL_NONE);
+  } else {
+    glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+  }
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Framebuffer of render pass '" << pass.name << "' is incomplete: 0x" << std::hex << status << std::dec
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void RenderGraph::releaseObjects(void) {
+  for (PassInfo& pass : passes) {
+    if (pass.framebuffer != 0) {
+      glDeleteFramebuffers(1, &pass.framebuffer);
+    }
+    pass.framebuffer = 0;
+  }
+}
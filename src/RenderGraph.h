@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glad/glad.h>
+
+/* The offscreen passes of a frame and the attachments they draw into and
+ * sample from. Passes are declared once, in the order they run, together
+ * with what each reads and writes; the graph then works out the rest:
+ *
+ * - Passes that contribute nothing to the output are culled.
+ * - Attachments live from the first pass that uses them to the last, and
+ *   are transient: their contents don't survive the frame. Attachments of
+ *   the same format and size whose lifetimes don't overlap share one GL
+ *   object, so e.g. a chain of post-processing passes ping-pongs between two
+ *   textures however long it is.
+ * - Each pass gets a framebuffer with its attachments, bound before it runs.
+ *   Attachments a pass is the first to write are invalidated before it draws,
+ *   and ones nothing uses afterwards once it is done, so tiled GPUs neither
+ *   load nor store them.
+ *
+ * A pass that writes an attachment an earlier pass wrote draws on top of its
+ * contents; the first writer must clear it. Sizes are relative to the output,
+ * and everything is rebuilt when the output's size changes. */
+class RenderGraph {
+public:
+  /* Index of an attachment, or `OUTPUT` for the framebuffer the graph draws
+   * into last. */
+  using Resource = uint32_t;
+  using Pass = uint32_t;
+
+  static constexpr Resource OUTPUT = ~0u;
+
+  struct Statistics {
+    size_t passes;
+    size_t culledPasses;
+    /* Attachments declared, and GL objects backing them. */
+    size_t attachments;
+    size_t allocations;
+    /* Memory of those objects, which is all the graph needs at any point of
+     * a frame, against what the attachments would take without aliasing. */
+    size_t allocatedBytes;
+    size_t unaliasedBytes;
+  };
+
+  RenderGraph(void) = default;
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+  ~RenderGraph(void);
+
+  /* `framebuffer` is 0 for the window. */
+  void setOutput(GLuint framebuffer, int width, int height);
+
+  /* A texture later passes can sample, at `scale` times the output's size. */
+  Resource createTexture(const char* name, GLenum internalFormat, float scale = 1.0f);
+  /* An attachment that is only ever drawn into, such as a depth buffer. */
+  Resource createRenderbuffer(const char* name, GLenum internalFormat, float scale = 1.0f);
+
+  Pass addPass(const char* name, std::function<void(void)> execute);
+  void read(Pass pass, Resource resource);
+  /* `attachment` is e.g. `GL_COLOR_ATTACHMENT0`; ignored for `OUTPUT`. */
+  void write(Pass pass, Resource resource, GLenum attachment);
+
+  /* The texture behind `resource`, which changes whenever the graph is
+   * rebuilt, so ask from within the pass that samples it. */
+  GLuint getTexture(Resource resource) const;
+
+  /* Runs the passes that weren't culled, each with its framebuffer bound and
+   * its viewport set, rebuilding first if anything changed. Leaves the
+   * output bound. */
+  void execute(void);
+
+  const Statistics& getStatistics(void) const {
+    return statistics;
+  }
+
+private:
+  struct ResourceInfo {
+    const char* name;
+    GLenum internalFormat;
+    float scale;
+    bool texture;
+    /* Set by `compile`. */
+    int width;
+    int height;
+    uint32_t allocation;
+    /* Passes, or `NO_PASS` if no pass that runs uses it. */
+    Pass firstUse;
+    Pass lastUse;
+  };
+
+  struct Attachment {
+    Resource resource;
+    GLenum attachment;
+  };
+
+  struct PassInfo {
+    const char* name;
+    std::function<void(void)> execute;
+    std::vector<Resource> reads;
+    std::vector<Attachment> writes;
+    /* Set by `compile`. */
+    bool culled;
+    /* 0 for passes that draw into the output. */
+    GLuint framebuffer;
+    int width;
+    int height;
+    std::vector<GLenum> invalidateBefore;
+    std::vector<GLenum> invalidateAfter;
+  };
+
+  /* A texture or renderbuffer that backs one or more resources. */
+  struct Allocation {
+    GLuint name;
+    bool texture;
+    GLenum internalFormat;
+    int width;
+    int height;
+    /* The last pass using it so far, while assigning resources. */
+    Pass busyUntil;
+  };
+
+  static constexpr Pass NO_PASS = ~0u;
+
+  Resource addResource(const char* name, GLenum internalFormat, float scale, bool texture);
+
+  void compile(void);
+  void cullPasses(void);
+  void allocateResources(void);
+  bool createFramebuffer(PassInfo& pass);
+  void releaseObjects(void);
+
+  std::vector<ResourceInfo> resources;
+  std::vector<PassInfo> passes;
+  std::vector<Allocation> allocations;
+
+  GLuint outputFramebuffer = 0;
+  int outputWidth = 0;
+  int outputHeight = 0;
+  bool dirty = true;
+
+  Statistics statistics = {};
+};
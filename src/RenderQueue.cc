@@ -0,0 +1,155 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+#include "GLState.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "RadixSort.h"
+#include "ShaderProgram.h"
+#include "UniformBlocks.h"
+
+namespace {
+
+const char* layerName(RenderLayer layer) {
+  switch (layer) {
+  case RenderLayer::SOLID:
+    return "Solid pass";
+  case RenderLayer::SKYBOX:
+    return "Skybox pass";
+  case RenderLayer::TRANSLUCENT:
+    return "Translucent pass";
+  case RenderLayer::ACCUMULATE:
+    return "Accumulate pass";
+  }
+  return "Unknown pass";
+}
+
+void applyLayerState(RenderLayer layer) {
+  GLState::setDepthTest(true);
+  switch (layer) {
+  case RenderLayer::SOLID:
+    GLState::setDepthFunc(GL_LESS);
+    GLState::setDepthMask(true);
+    GLState::setBlend(false);
+    break;
+  case RenderLayer::SKYBOX:
+    /* The skybox is drawn at the far plane, so it has to pass against a
+     * depth buffer cleared to exactly that. */
+    GLState::setDepthFunc(GL_LEQUAL);
+    GLState::setDepthMask(true);
+    GLState::setBlend(false);
+    break;
+  case RenderLayer::TRANSLUCENT:
+    /* Test against solid geometry, but don't occlude other translucent
+     * surfaces. */
+    GLState::setDepthFunc(GL_LESS);
+    GLState::setDepthMask(false);
+    GLState::setBlend(true);
+    GLState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    break;
+  case RenderLayer::ACCUMULATE:
+    /* Sums, which don't depend on the order they are added in. */
+    GLState::setDepthFunc(GL_LESS);
+    GLState::setDepthMask(false);
+    GLState::setBlend(true);
+    GLState::setBlendFunc(GL_ONE, GL_ONE);
+    break;
+  }
+}
+
+void drawMesh(const void* object, const ShaderProgram& shaderProgram) {
+  static_cast<const Mesh*>(object)->draw(shaderProgram);
+}
+
+} // namespace
+
+void RenderQueue::push(RenderLayer layer, const ShaderProgram& shaderProgram, const Mesh& mesh, const glm::mat4* modelMatrix, float depth) {
+  const auto& textures = mesh.getTextures();
+  GLuint material = textures.empty() ? 0 : textures.front().id;
+  packets.push_back({ layer, &shaderProgram, material, depth, modelMatrix, &drawMesh, &mesh });
+}
+
+uint64_t RenderQueue::makeKey(const DrawPacket& packet) {
+  /* Solid:       layer:4 | program:12 | material:16 | depth:32
+   * Translucent: layer:4 | ~depth:32  | program:12  | material:16
+   *
+   * Translucent packets must be strictly back to front, so their depth
+   * outranks the state they need. */
+  uint64_t layer = static_cast<uint64_t>(packet.layer) & 0xf;
+  uint64_t program = packet.shaderProgram->getID() & 0xfff;
+  uint64_t material = packet.material & 0xffff;
+  uint64_t depth = depthBits(packet.depth);
+
+  if (packet.layer == RenderLayer::TRANSLUCENT) {
+    return layer << 60 | (~depth & 0xffffffff) << 28 | program << 16 | material;
+  }
+  return layer << 60 | program << 48 | material << 32 | depth;
+}
+
+void RenderQueue::sort(void) {
+  size_t count = packets.size();
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    order[i] = { makeKey(packets[i]), static_cast<uint32_t>(i) };
+  }
+  /* The layer and program bytes are mostly the same for every packet, so
+   * their passes get skipped. */
+  radixSort(order, scratch);
+}
+
+void RenderQueue::submit(void) const {
+  if (order.empty()) {
+    return;
+  }
+  ProfileScope profileScope("Submit");
+  /* Each layer is a pass of its own on the GPU timeline. */
+  bool profiling = Profiler::isEnabled();
+
+  size_t alignment = UniformBuffer::getOffsetAlignment();
+  size_t stride = (sizeof(ObjectData) + alignment - 1) / alignment * alignment;
+  objectData.resize(order.size() * stride);
+  for (size_t i = 0; i < order.size(); ++i) {
+    const DrawPacket& packet = packets[order[i].index];
+    if (packet.modelMatrix != nullptr) {
+      ObjectData object = makeObjectData(*packet.modelMatrix);
+      std::memcpy(objectData.data() + i * stride, &object, sizeof object);
+    }
+  }
+  if (!objectBuffer) {
+    objectBuffer = UniformBuffer::create(OBJECT_DATA_BINDING, objectData.size());
+  }
+  objectBuffer->update(objectData.data(), objectData.size());
+
+  bool first = true;
+  RenderLayer layer = RenderLayer::SOLID;
+  const ShaderProgram* shaderProgram = nullptr;
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    const DrawPacket& packet = packets[order[i].index];
+    if (first || packet.layer != layer) {
+      if (profiling) {
+        if (!first) {
+          Profiler::endGpuScope();
+        }
+        Profiler::beginGpuScope(layerName(packet.layer));
+      }
+      layer = packet.layer;
+      applyLayerState(layer);
+      first = false;
+    }
+    if (packet.shaderProgram != shaderProgram) {
+      shaderProgram = packet.shaderProgram;
+      shaderProgram->use();
+    }
+    if (packet.modelMatrix != nullptr) {
+      objectBuffer->bindRange(i * stride, sizeof(ObjectData));
+    }
+    packet.draw(packet.object, *shaderProgram);
+  }
+  if (profiling) {
+    Profiler::endGpuScope();
+  }
+
+  applyLayerState(RenderLayer::SOLID);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "UniformBuffer.h"
+
+class Mesh;
+class ShaderProgram;
+
+/* Coarsest sort criterion: layers are drawn in this order, each with its own
+ * depth and blend state. */
+enum class RenderLayer : uint8_t {
+  SOLID,
+  SKYBOX,
+  TRANSLUCENT,
+  /* Translucent surfaces whose contributions are summed up, in any order,
+   * e.g. for weighted blended transparency. */
+  ACCUMULATE,
+};
+
+/* Everything needed to draw one object. Packets are cheap to copy; whatever
+ * they point at must stay alive until the queue has been submitted. */
+struct DrawPacket {
+  RenderLayer layer;
+  const ShaderProgram* shaderProgram;
+  /* Groups packets that bind the same textures, e.g. the name of the first
+   * one. Only the low 16 bits take part in sorting. */
+  GLuint material;
+  /* View-space distance, see `RenderQueue::viewDepth`. */
+  float depth;
+  /* Uploaded as the `ObjectData` uniform block unless null. */
+  const glm::mat4* modelMatrix;
+  /* Issues the actual draw, once the program, layer state and model matrix
+   * are in place. */
+  void (*draw)(const void* object, const ShaderProgram& shaderProgram);
+  const void* object;
+};
+
+/* Collects a frame's draw packets, sorts them by a 64-bit key and submits
+ * them in that order. Solid packets are grouped by program, then material,
+ * then drawn front to back so early-Z rejects hidden fragments; translucent
+ * packets are drawn back to front, as blending requires. */
+class RenderQueue {
+public:
+  void clear(void) {
+    packets.clear();
+    order.clear();
+  }
+
+  void push(const DrawPacket& packet) {
+    packets.push_back(packet);
+  }
+
+  void push(RenderLayer layer, const ShaderProgram& shaderProgram, const Mesh& mesh, const glm::mat4* modelMatrix, float depth);
+
+  /* Sorts the packets pushed since the last `clear`. Must be called before
+   * `submit`. */
+  void sort(void);
+
+  /* Uploads the object data of all packets at once, then draws the packets
+   * in sorted order, binding each one's object data, and finally restores
+   * the solid layer's state. */
+  void submit(void) const;
+
+  size_t size(void) const {
+    return packets.size();
+  }
+
+  static uint64_t makeKey(const DrawPacket& packet);
+
+  /* Distance in front of the camera, for `DrawPacket::depth`. */
+  static float viewDepth(const glm::mat4& viewMatrix, const glm::vec3& position) {
+    return -(viewMatrix * glm::vec4(position, 1.0f)).z;
+  }
+
+private:
+  struct SortEntry {
+    uint64_t key;
+    uint32_t index;
+  };
+
+  std::vector<DrawPacket> packets;
+  std::vector<SortEntry> order;
+  std::vector<SortEntry> scratch;
+
+  /* One `ObjectData` per packet, each at an offset that can be bound. */
+  mutable std::vector<unsigned char> objectData;
+  mutable std::unique_ptr<UniformBuffer> objectBuffer;
+};
@@ -0,0 +1,153 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+#include "FrustumCuller.h"
+
+SceneGraph::Node SceneGraph::addNode(Node parent, const glm::mat4& localTransform) {
+  return createNode(parent, localTransform, BoundingBox::empty(), nullptr);
+}
+
+SceneGraph::Node SceneGraph::addNode(Node parent, const glm::mat4& localTransform, const BoundingBox& bounds, const Drawable& drawable) {
+  return createNode(parent, localTransform, bounds, &drawable);
+}
+
+SceneGraph::Node SceneGraph::createNode(Node parent, const glm::mat4& localTransform, const BoundingBox& bounds, const Drawable* drawable) {
+  Node node = static_cast<Node>(parents.size());
+
+  parents.push_back(parent);
+  firstChildren.push_back(NO_NODE);
+  nextSiblings.push_back(NO_NODE);
+  if (parent != NO_NODE) {
+    nextSiblings[node] = firstChildren[parent];
+    firstChildren[parent] = node;
+  }
+
+  localTransforms.push_back(localTransform);
+  worldTransforms.push_back(localTransform);
+  localBounds.push_back(bounds);
+  worldBounds.push_back(BoundingBox::empty());
+  drawables.push_back(drawable ? *drawable : Drawable{ RenderLayer::SOLID, nullptr, 0, nullptr, nullptr, nullptr, 0, nullptr });
+  lodLevels.push_back(0);
+
+  dirty.push_back(true);
+  dirtyNodes.push_back(node);
+  if (!bounds.isEmpty()) {
+    ++boundedCount;
+    hierarchyStale = true;
+  }
+  return node;
+}
+
+void SceneGraph::setLocalTransform(Node node, const glm::mat4& transform) {
+  localTransforms[node] = transform;
+  if (!dirty[node]) {
+    dirty[node] = true;
+    dirtyNodes.push_back(node);
+  }
+}
+
+void SceneGraph::update(void) {
+  /* Parents come before their children, so in increasing order a dirty
+   * ancestor is always reached first, and its subtree update cleans any
+   * dirty descendants. */
+  std::sort(dirtyNodes.begin(), dirtyNodes.end());
+  for (Node node : dirtyNodes) {
+    if (dirty[node]) {
+      updateSubtree(node);
+    }
+  }
+  dirtyNodes.clear();
+
+  if (hierarchyStale || refitCount > boundedCount) {
+    rebuildHierarchy();
+  }
+}
+
+void SceneGraph::updateSubtree(Node root) {
+  stack.clear();
+  stack.push_back(root);
+  while (!stack.empty()) {
+    Node node = stack.back();
+    stack.pop_back();
+
+    Node parent = parents[node];
+    worldTransforms[node] = parent == NO_NODE ? localTransforms[node] : worldTransforms[parent] * localTransforms[node];
+    dirty[node] = false;
+
+    if (!localBounds[node].isEmpty()) {
+      worldBounds[node] = transform(localBounds[node], worldTransforms[node]);
+      /* A stale hierarchy is rebuilt from scratch anyway. */
+      if (!hierarchyStale) {
+        hierarchy.refit(node, worldBounds[node]);
+        ++refitCount;
+      }
+    }
+
+    for (Node child = firstChildren[node]; child != NO_NODE; child = nextSiblings[child]) {
+      stack.push_back(child);
+    }
+  }
+}
+
+void SceneGraph::rebuildHierarchy(void) {
+  std::vector<BoundingBox> boxes;
+  std::vector<uint32_t> ids;
+  boxes.reserve(boundedCount);
+  ids.reserve(boundedCount);
+  for (Node node = 0; node < parents.size(); ++node) {
+    if (!localBounds[node].isEmpty()) {
+      boxes.push_back(worldBounds[node]);
+      ids.push_back(node);
+    }
+  }
+  hierarchy.build(boxes.data(), ids.data(), boxes.size());
+
+  hierarchyStale = false;
+  refitCount = 0;
+}
+
+void SceneGraph::cull(const Frustum& frustum, std::vector<Node>& outVisible) const {
+  size_t previousSize = outVisible.size();
+  hierarchy.query(frustum, outVisible);
+  size_t visible = outVisible.size() - previousSize;
+  FrustumCuller::count(visible, hierarchy.size() - visible);
+}
+
+SceneGraph::Node SceneGraph::pick(const glm::vec3& origin, const glm::vec3& direction, float* outDistance) const {
+  return hierarchy.raycast(origin, direction, outDistance);
+}
+
+void SceneGraph::enqueue(RenderQueue& queue, const Frustum& frustum, const glm::mat4& viewMatrix, const LodSelector& lodSelector) {
+  visibleNodes.clear();
+  cull(frustum, visibleNodes);
+
+  for (Node node : visibleNodes) {
+    const Drawable& drawable = drawables[node];
+    if (!drawable.draw) {
+      continue;
+    }
+    const BoundingBox& bounds = worldBounds[node];
+    float depth = RenderQueue::viewDepth(viewMatrix, bounds.getCenter());
+
+    const void* object = drawable.object;
+    if (drawable.lodCount > 0 || drawable.onVisible) {
+      /* Measure to the nearest the bounds can get. */
+      glm::vec3 viewCenter(viewMatrix * glm::vec4(bounds.getCenter(), 1.0f));
+      float distance = glm::length(viewCenter) - glm::length(bounds.getExtents());
+      if (drawable.onVisible) {
+        drawable.onVisible(object, lodSelector.projectedSize(2.0f * glm::length(bounds.getExtents()), distance));
+      }
+      if (drawable.lodCount > 0) {
+        /* Scale the error by the largest stretch of the node's transform. */
+        const glm::mat4& world = worldTransforms[node];
+        float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        uint32_t level = lodSelector.select(drawable.lods, drawable.lodCount, distance, scale, lodLevels[node]);
+        lodLevels[node] = static_cast<uint8_t>(level);
+        object = drawable.lods[level].object;
+      }
+    }
+
+    queue.push({ drawable.layer, drawable.shaderProgram, drawable.material, depth, &worldTransforms[node], drawable.draw, object });
+  }
+}
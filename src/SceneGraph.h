@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Bounds.h"
+#include "LodSelector.h"
+#include "RenderQueue.h"
+
+class Frustum;
+
+/* A hierarchy of transforms. Nodes are stored as flat arrays indexed by node,
+ * with every parent before its children, so world matrices are laid out
+ * contiguously and can be recomputed in a single forward pass.
+ *
+ * Moving a node marks it dirty; `update` then recomputes the world matrices
+ * of the dirty subtrees only, and refits the bounding volume hierarchy along
+ * the paths of the nodes that moved. Nodes with bounds can be culled and
+ * picked through the hierarchy in logarithmic time. */
+class SceneGraph {
+public:
+  using Node = uint32_t;
+  static constexpr Node NO_NODE = ~0u;
+
+  /* What to draw at a node; see `DrawPacket`. */
+  struct Drawable {
+    RenderLayer layer;
+    const ShaderProgram* shaderProgram;
+    GLuint material;
+    void (*draw)(const void* object, const ShaderProgram& shaderProgram);
+    const void* object;
+    /* Optional levels of detail, finest first. When present, the object of
+     * the selected level is drawn instead of `object`. */
+    const LodLevel* lods;
+    uint32_t lodCount;
+    /* Optional. Told how many pixels the bounds span whenever the node is
+     * enqueued, e.g. to stream in texture detail. Gets `object`, whatever
+     * level of detail is drawn. */
+    void (*onVisible)(const void* object, float screenSize);
+  };
+
+  /* A node that only groups and transforms its children. `parent` may be
+   * `NO_NODE` for a root. */
+  Node addNode(Node parent, const glm::mat4& localTransform);
+
+  /* A node with `bounds`, in its local space, that takes part in culling and
+   * picking, and draws `drawable` when visible. */
+  Node addNode(Node parent, const glm::mat4& localTransform, const BoundingBox& bounds, const Drawable& drawable);
+
+  void setLocalTransform(Node node, const glm::mat4& transform);
+
+  const glm::mat4& getLocalTransform(Node node) const {
+    return localTransforms[node];
+  }
+
+  /* As of the last `update`. */
+  const glm::mat4& getWorldTransform(Node node) const {
+    return worldTransforms[node];
+  }
+
+  /* As of the last `update`; empty for nodes without bounds. */
+  const BoundingBox& getWorldBounds(Node node) const {
+    return worldBounds[node];
+  }
+
+  Node getParent(Node node) const {
+    return parents[node];
+  }
+
+  size_t size(void) const {
+    return parents.size();
+  }
+
+  /* Brings world matrices, world bounds and the hierarchy up to date. */
+  void update(void);
+
+  /* Appends the nodes with bounds that intersect `frustum`. */
+  void cull(const Frustum& frustum, std::vector<Node>& outVisible) const;
+
+  /* The node with bounds that the ray hits first, or `NO_NODE`. */
+  Node pick(const glm::vec3& origin, const glm::vec3& direction, float* outDistance = nullptr) const;
+
+  /* Pushes a packet for every visible node with a drawable, picking levels
+   * of detail with `lodSelector`, and calls the drawable's `onVisible`.
+   * Each node remembers its level for the selector's hysteresis. */
+  void enqueue(RenderQueue& queue, const Frustum& frustum, const glm::mat4& viewMatrix, const LodSelector& lodSelector);
+
+private:
+  Node createNode(Node parent, const glm::mat4& localTransform, const BoundingBox& bounds, const Drawable* drawable);
+
+  void updateSubtree(Node root);
+  void rebuildHierarchy(void);
+
+  std::vector<Node> parents;
+  std::vector<Node> firstChildren;
+  std::vector<Node> nextSiblings;
+  std::vector<glm::mat4> localTransforms;
+  std::vector<glm::mat4> worldTransforms;
+  std::vector<BoundingBox> localBounds;
+  std::vector<BoundingBox> worldBounds;
+  std::vector<Drawable> drawables;
+  std::vector<uint8_t> lodLevels;
+  std::vector<bool> dirty;
+
+  std::vector<Node> dirtyNodes;
+
+  BoundingVolumeHierarchy hierarchy;
+  /* Nodes were added since the hierarchy was built. */
+  bool hierarchyStale = false;
+  /* Refitting loosens the hierarchy; past one refit per bounded node on
+   * average it is cheaper to rebuild. */
+  size_t refitCount = 0;
+  size_t boundedCount = 0;
+
+  /* Scratch space for `update` and `enqueue`. */
+  std::vector<Node> stack;
+  std::vector<Node> visibleNodes;
+};
@@ -0,0 +1,108 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+/* Deep enough for any sane hierarchy; deeper means a cycle slipped past
+ * the include-once check, e.g. through a symbolic link. */
+constexpr int MAX_INCLUDE_DEPTH = 16;
+
+bool loadShaderFile(const std::string& path, std::string& outSource) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  outSource = buffer.str();
+  return true;
+}
+
+/* The directive on `line`, e.g. "include" for `  #  include "x"`, with
+ * `outRest` set to what follows it; empty if the line isn't a directive. */
+std::string parseDirective(const std::string& line, std::string& outRest) {
+  size_t start = line.find_first_not_of(" \t");
+  if (start == std::string::npos || line[start] != '#') {
+    return std::string();
+  }
+  size_t nameStart = line.find_first_not_of(" \t", start + 1);
+  if (nameStart == std::string::npos) {
+    return std::string();
+  }
+  size_t nameEnd = nameStart;
+  while (nameEnd < line.size() && std::isalpha(static_cast<unsigned char>(line[nameEnd]))) {
+    ++nameEnd;
+  }
+  outRest = line.substr(nameEnd);
+  return line.substr(nameStart, nameEnd - nameStart);
+}
+
+bool expand(const std::filesystem::path& path, const std::string& defines, int depth, std::string& outSource, std::vector<std::string>& outFiles) {
+  std::string name = path.lexically_normal().generic_string();
+  if (std::find(outFiles.begin(), outFiles.end(), name) != outFiles.end()) {
+    return true;
+  }
+  if (depth > MAX_INCLUDE_DEPTH) {
+    std::cerr << "Shader includes nested too deeply: " << name << std::endl;
+    return false;
+  }
+
+  std::string source;
+  if (!loadShaderFile(name, source)) {
+    std::cerr << "Failed to load shader: " << name << std::endl;
+    return false;
+  }
+  size_t fileIndex = outFiles.size();
+  outFiles.push_back(name);
+  if (depth > 0) {
+    outSource += "#line 1 " + std::to_string(fileIndex) + "\n";
+  }
+
+  std::istringstream lines(source);
+  std::string line;
+  for (int lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    std::string rest;
+    std::string directive = parseDirective(line, rest);
+
+    if (directive == "include") {
+      size_t open = rest.find('"');
+      size_t close = open == std::string::npos ? std::string::npos : rest.find('"', open + 1);
+      if (close == std::string::npos) {
+        std::cerr << name << ":" << lineNumber << ": malformed #include" << std::endl;
+        return false;
+      }
+      std::filesystem::path includePath = path.parent_path() / rest.substr(open + 1, close - open - 1);
+      if (!expand(includePath, defines, depth + 1, outSource, outFiles)) {
+        std::cerr << "  included from " << name << ":" << lineNumber << std::endl;
+        return false;
+      }
+      outSource += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+      continue;
+    }
+
+    outSource += line;
+    outSource += '\n';
+    if (directive == "version" && depth == 0 && !defines.empty()) {
+      outSource += defines;
+      outSource += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool preprocessShader(const std::string& path, const std::string& defines, std::string& outSource, std::vector<std::string>& outFiles) {
+  outSource.clear();
+  outFiles.clear();
+  return expand(path, defines, 0, outSource, outFiles);
+}
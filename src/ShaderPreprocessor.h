@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/* Expands the shader at `path` into a single source string:
+ *
+ * - `#include "file"` is replaced with the contents of `file`, resolved
+ *   relative to the including file. Each file is included at most once, so
+ *   shared declarations can be included wherever they are needed.
+ * - `defines` is inserted right after the `#version` line, which has to
+ *   stay first.
+ * - `#line` directives keep compiler messages pointing at the right line.
+ *   Their source string number is the file's index in `outFiles`.
+ *
+ * Reports the problem and returns false if a file can't be read or an
+ * include is malformed. */
+bool preprocessShader(const std::string& path, const std::string& defines, std::string& outSource, std::vector<std::string>& outFiles);
@@ -1,21 +1,18 @@
 #include "ShaderProgram.h"
 
-#include <fstream>
+#include <chrono>
 #include <iostream>
-#include <sstream>
+#include <vector>
 
-static bool loadShaderFile(const std::string& path, std::string& outSource) {
-  std::ifstream file(path);
-  if (!file.is_open()) {
-    return false;
-  }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  outSource = buffer.str();
-  return true;
-}
+#include "GLState.h"
+#include "ProgramBinaryCache.h"
+#include "Profiler.h"
+#include "ShaderPreprocessor.h"
+#include "UniformBlocks.h"
 
-static GLuint compileShader(GLenum type, const std::string& shaderSource) {
+/* `files` maps the source string numbers in compiler messages back to the
+ * files they came from. */
+static GLuint compileShader(GLenum type, const std::string& shaderSource, const std::vector<std::string>& files) {
   GLuint shaderID = glCreateShader(type);
   const GLchar* source = shaderSource.c_str();
   glShaderSource(shaderID, 1, &source, NULL);
@@ -27,15 +24,56 @@ static GLuint compileShader(GLenum type, const std::string& shaderSource) {
     glGetShaderInfoLog(shaderID, sizeof infoLog, NULL, infoLog);
     std::cerr << (type == GL_VERTEX_SHADER ? "Vertex" : "Fragment")
               << " shader compilation failed:\n"
-              << infoLog << std::endl;
+              << infoLog;
+    for (size_t i = 0; i < files.size(); ++i) {
+      std::cerr << "  source string " << i << ": " << files[i] << "\n";
+    }
+    std::cerr << std::flush;
     glDeleteShader(shaderID);
     return 0;
   }
   return shaderID;
 }
 
+/* Fills `outUniforms` with the program's uniforms outside of blocks. Arrays
+ * are reported by their first element; they are entered under their bare
+ * name as well, and each further element by its own. */
+static void introspectUniforms(GLuint programID, UniformTable& outUniforms) {
+  GLint uniformCount = 0;
+  GLint maxNameLength = 0;
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+  std::vector<GLchar> nameBuffer(static_cast<size_t>(maxNameLength) + 1);
+
+  for (GLint i = 0; i < uniformCount; ++i) {
+    GLsizei nameLength = 0;
+    GLint arraySize = 0;
+    GLenum type = 0;
+    glGetActiveUniform(programID, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &nameLength, &arraySize, &type, nameBuffer.data());
+    std::string name(nameBuffer.data(), nameLength);
+
+    /* Block members have no location; they are set through buffers. */
+    GLint location = glGetUniformLocation(programID, name.c_str());
+    if (location == -1) {
+      continue;
+    }
+    outUniforms.add(name, location, type);
+
+    const std::string firstElement = "[0]";
+    if (name.size() > firstElement.size() && name.compare(name.size() - firstElement.size(), firstElement.size(), firstElement) == 0) {
+      std::string baseName = name.substr(0, name.size() - firstElement.size());
+      outUniforms.add(baseName, location, type);
+      for (GLint element = 1; element < arraySize; ++element) {
+        std::string elementName = baseName + "[" + std::to_string(element) + "]";
+        outUniforms.add(elementName, glGetUniformLocation(programID, elementName.c_str()), type);
+      }
+    }
+  }
+}
+
 static GLuint linkProgram(GLuint vertexShaderID, GLuint fragmentShaderID) {
   GLuint programID = glCreateProgram();
+  ProgramBinaryCache::prepareForLink(programID);
   glAttachShader(programID, vertexShaderID);
   glAttachShader(programID, fragmentShaderID);
   glLinkProgram(programID);
@@ -53,62 +91,115 @@ static GLuint linkProgram(GLuint vertexShaderID, GLuint fragmentShaderID) {
 
 ShaderProgram::~ShaderProgram(void) {
   if (programID != 0) {
-    glDeleteProgram(programID);
+    GLState::deleteProgram(programID);
   }
 }
 
-std::unique_ptr<ShaderProgram> ShaderProgram::create(const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
-  std::string shaderSource;
-
-  if (!loadShaderFile(vertexShaderPath, shaderSource)) {
-    std::cerr << "Failed to load vertex shader: " << vertexShaderPath << std::endl;
-    return nullptr;
-  }
-
-  GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, shaderSource);
+/* Compiles and links from source, logging how long each step took. */
+static GLuint buildProgram(const std::string& vertexSource, const std::vector<std::string>& vertexFiles,
+                           const std::string& fragmentSource, const std::vector<std::string>& fragmentFiles, const std::string& name) {
+  ProfileScope profileScope("Shader compile");
+  auto start = std::chrono::steady_clock::now();
+  GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, vertexSource, vertexFiles);
   if (vertexShaderID == 0) {
-    return nullptr;
-  }
-
-  if (!loadShaderFile(fragmentShaderPath, shaderSource)) {
-    std::cerr << "Failed to load fragment shader: " << fragmentShaderPath << std::endl;
-    glDeleteShader(vertexShaderID);
-    return nullptr;
+    return 0;
   }
-
-  GLuint fragmentShaderID = compileShader(GL_FRAGMENT_SHADER, shaderSource);
+  GLuint fragmentShaderID = compileShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentFiles);
   if (fragmentShaderID == 0) {
     glDeleteShader(vertexShaderID);
-    return nullptr;
+    return 0;
   }
 
+  auto compiled = std::chrono::steady_clock::now();
   GLuint programID = linkProgram(vertexShaderID, fragmentShaderID);
+  auto linked = std::chrono::steady_clock::now();
 
   /* Don't forget to delete the shader objects once we've linked them into the
    * program object; we no longer need them anymore. */
   glDeleteShader(fragmentShaderID);
   glDeleteShader(vertexShaderID);
 
-  if (programID == 0) {
+  if (programID != 0) {
+    std::chrono::duration<double, std::milli> compileTime = compiled - start;
+    std::chrono::duration<double, std::milli> linkTime = linked - compiled;
+    std::cout << "Built shader program '" << name << "': compiled in " << compileTime.count()
+              << " ms, linked in " << linkTime.count() << " ms" << std::endl;
+  }
+  return programID;
+}
+
+std::unique_ptr<ShaderProgram> ShaderProgram::create(const std::string& vertexShaderPath, const std::string& fragmentShaderPath,
+                                                     const std::vector<std::string>& defines) {
+  ProfileScope profileScope("Shader program");
+  std::string defineLines;
+  for (const auto& define : defines) {
+    defineLines += "#define " + define + "\n";
+  }
+
+  std::string vertexSource, fragmentSource;
+  std::vector<std::string> vertexFiles, fragmentFiles;
+  if (!preprocessShader(vertexShaderPath, defineLines, vertexSource, vertexFiles)
+      || !preprocessShader(fragmentShaderPath, defineLines, fragmentSource, fragmentFiles)) {
     return nullptr;
   }
+  std::string name = vertexShaderPath + " + " + fragmentShaderPath;
+  for (const auto& define : defines) {
+    name += " " + define;
+  }
+
+  /* Try the binary the driver produced last time first; a miss, or one the
+   * driver turns down, falls through to compiling. */
+  auto start = std::chrono::steady_clock::now();
+  uint64_t cacheKey = ProgramBinaryCache::keyFor(vertexSource, fragmentSource, defineLines);
+  GLuint programID = ProgramBinaryCache::load(cacheKey);
+  if (programID != 0) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Loaded shader program '" << name << "' from binary cache in " << elapsed.count() << " ms" << std::endl;
+  } else {
+    programID = buildProgram(vertexSource, vertexFiles, fragmentSource, fragmentFiles, name);
+    if (programID == 0) {
+      return nullptr;
+    }
+    ProgramBinaryCache::store(cacheKey, programID);
+  }
+
+  /* Point the shared blocks at their fixed binding points, so one buffer
+   * per block serves every program. Blocks the program doesn't use are
+   * simply absent. */
+  for (const auto& block : UNIFORM_BLOCKS) {
+    GLuint blockIndex = glGetUniformBlockIndex(programID, block.name);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glUniformBlockBinding(programID, blockIndex, block.binding);
+    }
+  }
 
-  return std::unique_ptr<ShaderProgram>(new ShaderProgram(programID));
+  std::unique_ptr<ShaderProgram> program(new ShaderProgram(programID));
+  introspectUniforms(programID, program->uniforms);
+
+  /* Likewise for the samplers of shared data, which stay bound to their
+   * units. */
+  for (const auto& sampler : SHARED_SAMPLERS) {
+    UniformHandle<GLint> handle = program->getUniform<GLint>(sampler.name);
+    if (handle.isValid()) {
+      program->use();
+      program->uniform(handle, static_cast<GLint>(sampler.unit));
+    }
+  }
+  return program;
 }
 
 void ShaderProgram::use(void) const {
-  glUseProgram(programID);
+  GLState::useProgram(programID);
 }
 
-GLint ShaderProgram::getUniformLocation(const std::string& name) const {
-  auto it = uniformLocationCache.find(name);
-  if (it != uniformLocationCache.end()) {
-    return it->second;
+void ShaderProgram::uniform(UniformHandle<GLint> handle, GLint value) const {
+  if (!handle.isValid()) {
+    return;
   }
-  GLint location = glGetUniformLocation(programID, name.c_str());
-  if (location == -1) {
-    std::cerr << "Uniform '" << name << "' not found in shader program (ID: " << programID << ")" << std::endl;
+  if (!uniforms.shadow(handle, value)) {
+    GLState::countCall(true);
+    return;
   }
-  uniformLocationCache[name] = location;
-  return location;
+  GLState::countCall(false);
+  glUniform1i(uniforms.getLocation(handle), value);
 }
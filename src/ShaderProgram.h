@@ -3,12 +3,14 @@
 #include <algorithm>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "UniformTable.h"
+
 class ShaderProgram {
   friend void swap(ShaderProgram& lhs, ShaderProgram& rhs) noexcept;
 
@@ -16,7 +18,8 @@ public:
   ShaderProgram(const ShaderProgram&) = delete;
 
   ShaderProgram(ShaderProgram&& other) noexcept
-    : programID(other.programID) {
+    : programID(other.programID)
+    , uniforms(std::move(other.uniforms)) {
     other.programID = 0;
   }
 
@@ -27,7 +30,11 @@ public:
 
   ~ShaderProgram(void);
 
-  static std::unique_ptr<ShaderProgram> create(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+  /* Both shaders may `#include` other files; see `preprocessShader`. Each
+   * of `defines` is injected as `#define <define>`, so it can be a bare
+   * name or a name followed by a value. */
+  static std::unique_ptr<ShaderProgram> create(const std::string& vertexShaderPath, const std::string& fragmentShaderPath,
+                                               const std::vector<std::string>& defines = {});
 
   GLuint getID(void) const {
     return programID;
@@ -35,40 +42,50 @@ public:
 
   void use(void) const;
 
-  void uniform(const std::string& name, GLint value) const {
-    glUniform1i(getUniformLocation(name), value);
+  /* The active uniforms are read once, after linking. Look a uniform up
+   * once and keep the handle; setting through a handle is an array index.
+   * Uniforms the program lacks, including ones the compiler optimised out,
+   * give invalid handles, which are silently ignored. */
+  template <typename T>
+  UniformHandle<T> getUniform(UniformName name) const {
+    return uniforms.find<T>(name);
   }
 
-  void uniform(const std::string& name, GLfloat value) const {
-    glUniform1f(getUniformLocation(name), value);
+  /* Integer uniforms are mostly samplers, which get set to the same unit on
+   * every draw, so their values are shadowed and unchanged ones skipped. */
+  void uniform(UniformHandle<GLint> handle, GLint value) const;
+
+  void uniform(UniformHandle<GLfloat> handle, GLfloat value) const {
+    glUniform1f(uniforms.getLocation(handle), value);
   }
 
-  void uniform(const std::string& name, GLfloat x, GLfloat y, GLfloat z) const {
-    glUniform3f(getUniformLocation(name), x, y, z);
+  void uniform(UniformHandle<glm::vec3> handle, const glm::vec3& value) const {
+    glUniform3fv(uniforms.getLocation(handle), 1, glm::value_ptr(value));
   }
 
-  void uniform(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value));
+  void uniform(UniformHandle<glm::mat3> handle, const glm::mat3& value) const {
+    glUniformMatrix3fv(uniforms.getLocation(handle), 1, GL_FALSE, glm::value_ptr(value));
   }
 
-  void uniform(const std::string& name, const glm::mat3& value) const {
-    glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
+  void uniform(UniformHandle<glm::mat4> handle, const glm::mat4& value) const {
+    glUniformMatrix4fv(uniforms.getLocation(handle), 1, GL_FALSE, glm::value_ptr(value));
   }
 
-  void uniform(const std::string& name, const glm::mat4& value) const {
-    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
+  /* For setup code: looks the uniform up on every call. */
+  template <typename T>
+  void uniform(UniformName name, const T& value) const {
+    uniform(getUniform<T>(name), value);
   }
 
 private:
   explicit ShaderProgram(GLuint programID) : programID(programID) {}
 
-  GLint getUniformLocation(const std::string& name) const;
-
   GLuint programID;
-  mutable std::unordered_map<std::string, GLint> uniformLocationCache;
+  mutable UniformTable uniforms;
 };
 
 inline void swap(ShaderProgram& lhs, ShaderProgram& rhs) noexcept {
   using std::swap;
   swap(lhs.programID, rhs.programID);
+  swap(lhs.uniforms, rhs.uniforms);
 }
@@ -0,0 +1,22 @@
+#include "ShaderVariants.h"
+
+#include <algorithm>
+
+const ShaderProgram* ShaderVariants::get(const std::vector<std::string>& keys) {
+  /* The same set in another order or with repeats is the same variant. */
+  std::vector<std::string> sortedKeys = keys;
+  std::sort(sortedKeys.begin(), sortedKeys.end());
+  sortedKeys.erase(std::unique(sortedKeys.begin(), sortedKeys.end()), sortedKeys.end());
+
+  std::string id;
+  for (const auto& key : sortedKeys) {
+    id += key;
+    id += '\n';
+  }
+
+  auto it = variants.find(id);
+  if (it == variants.end()) {
+    it = variants.emplace(std::move(id), ShaderProgram::create(vertexShaderPath, fragmentShaderPath, sortedKeys)).first;
+  }
+  return it->second.get();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+/* The programs built from one pair of shaders under different sets of
+ * defines. A variant is compiled the first time it is requested, then kept,
+ * so a shader can select features with `#ifdef` instead of branching on a
+ * uniform in every fragment, and only the combinations in use get built. */
+class ShaderVariants {
+public:
+  ShaderVariants(std::string vertexShaderPath, std::string fragmentShaderPath)
+    : vertexShaderPath(std::move(vertexShaderPath))
+    , fragmentShaderPath(std::move(fragmentShaderPath)) {}
+
+  /* The variant with `keys` defined, in any order, or nullptr if it fails to
+   * build. Failures are kept too, so a broken variant is reported once.
+   * Variants live as long as this, so the pointer can be kept instead of
+   * being requested again every frame. */
+  const ShaderProgram* get(const std::vector<std::string>& keys);
+
+  size_t size(void) const {
+    return variants.size();
+  }
+
+private:
+  std::string vertexShaderPath;
+  std::string fragmentShaderPath;
+  /* By sorted, newline-separated keys. */
+  std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> variants;
+};
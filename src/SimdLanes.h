@@ -0,0 +1,56 @@
+#pragma once
+
+/* A handful of floats processed by one instruction: eight with AVX, four
+ * with SSE2. Kernels written against `Lanes` compile to whichever the build
+ * targets; `SIMD_LANES` is left undefined when it targets neither, and
+ * callers fall back to scalar code. */
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_LANES
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_LANES
+#endif
+
+#if defined(__AVX__)
+struct Lanes {
+  static constexpr unsigned int WIDTH = 8;
+  __m256 v;
+
+  static Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+  static Lanes splat(float x) { return { _mm256_set1_ps(x) }; }
+  static Lanes allClear(void) { return { _mm256_setzero_ps() }; }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator|(Lanes a, Lanes b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Lanes lessThanZero(Lanes a) { return { _mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_LT_OQ) }; }
+inline Lanes lessEqual(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+/* One bit per lane, set where the lane's sign bit (or comparison) is. */
+inline unsigned int signMask(Lanes a) { return static_cast<unsigned int>(_mm256_movemask_ps(a.v)); }
+#elif defined(SIMD_LANES)
+struct Lanes {
+  static constexpr unsigned int WIDTH = 4;
+  __m128 v;
+
+  static Lanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+  static Lanes splat(float x) { return { _mm_set1_ps(x) }; }
+  static Lanes allClear(void) { return { _mm_setzero_ps() }; }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes operator|(Lanes a, Lanes b) { return { _mm_or_ps(a.v, b.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Lanes max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Lanes lessThanZero(Lanes a) { return { _mm_cmplt_ps(a.v, _mm_setzero_ps()) }; }
+inline Lanes lessEqual(Lanes a, Lanes b) { return { _mm_cmple_ps(a.v, b.v) }; }
+/* One bit per lane, set where the lane's sign bit (or comparison) is. */
+inline unsigned int signMask(Lanes a) { return static_cast<unsigned int>(_mm_movemask_ps(a.v)); }
+#endif
@@ -1,72 +1,745 @@
 #include "TextureLoader.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
 #include <iostream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-TextureLoader::~TextureLoader(void) {
-  for (auto& pair : cache) {
-    glDeleteTextures(1, &pair.second);
-  }
-  cache.clear();
-}
-
-GLuint TextureLoader::loadTexture(const std::string& path) {
-  auto it = cache.find(path);
-  if (it != cache.end()) {
-    return it->second;
-  }
+#include "CookedTexture.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
+static bool decodeImage(const std::string& path, int& width, int& height, int& nrChannels, unsigned char*& pixels, bool flip = true) {
   /* OpenGL's coordinate system has the Y-axis pointing upward (0 at the
    * bottom), while most image formats store pixel data with the Y-axis pointing
    * downward (0 at the top). Calling stbi_set_flip_vertically_on_load(true)
    * before loading an image with stb_image.h flips the image data vertically,
-   * aligning it with OpenGL's coordinate system for correct rendering. */
-  stbi_set_flip_vertically_on_load(true);
+   * aligning it with OpenGL's coordinate system for correct rendering.
+   *
+   * The `_thread` variant only affects the calling thread, so concurrent
+   * decodes (and other loaders that don't want the flip) can't race on it. */
+  stbi_set_flip_vertically_on_load_thread(flip);
 
-  /* Load and generate the texture. */
-  int width, height, nrChannels;
-  stbi_uc* image = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-  if (image == NULL) {
+  pixels = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+  if (pixels == NULL) {
     std::cerr << "Failed to load image: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
-    return 0;
+    return false;
+  }
+
+  if (nrChannels != 1 && nrChannels != 3 && nrChannels != 4) {
+    std::cerr << "Unsupported image channels: " << nrChannels << std::endl;
+    stbi_image_free(pixels);
+    pixels = NULL;
+    return false;
   }
 
-  GLenum format;
+  return true;
+}
+
+/* Bytes taken by a full mip chain down to 1x1. */
+static size_t mipChainSize(int width, int height, size_t bytesPerTexel) {
+  size_t size = 0;
+  for (;;) {
+    size += static_cast<size_t>(width) * height * bytesPerTexel;
+    if (width == 1 && height == 1) {
+      return size;
+    }
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+}
+
+/* Levels up to this size are uploaded as soon as an image is decoded. */
+static constexpr int INITIAL_LEVEL_SIZE = 64;
+
+/* How far a streamed-in level blends in per frame. */
+static constexpr float LEVEL_FADE_STEP = 0.25f;
+
+static int levelDimension(int size, int level) {
+  return std::max(size >> level, 1);
+}
+
+/* Halves a level with a box filter. An odd last row or column is averaged
+ * with itself. */
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& level, int width, int height, int channels) {
+  int halfWidth = std::max(width / 2, 1);
+  int halfHeight = std::max(height / 2, 1);
+  std::vector<unsigned char> half(static_cast<size_t>(halfWidth) * halfHeight * channels);
+  for (int y = 0; y < halfHeight; ++y) {
+    const unsigned char* row0 = &level[static_cast<size_t>(std::min(2 * y, height - 1)) * width * channels];
+    const unsigned char* row1 = &level[static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width * channels];
+    unsigned char* out = &half[static_cast<size_t>(y) * halfWidth * channels];
+    for (int x = 0; x < halfWidth; ++x) {
+      int x0 = std::min(2 * x, width - 1) * channels;
+      int x1 = std::min(2 * x + 1, width - 1) * channels;
+      for (int c = 0; c < channels; ++c) {
+        int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+        out[x * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+      }
+    }
+  }
+  return half;
+}
+
+/* The image followed by every smaller mip level, down to 1x1. Built on the
+ * decode workers, so the GL thread doesn't have to generate mipmaps. */
+static void buildMipChain(const unsigned char* pixels, int width, int height, int channels,
+                          std::vector<std::vector<unsigned char>>& outLevels) {
+  ProfileScope profileScope("Mip generation");
+  outLevels.emplace_back(pixels, pixels + static_cast<size_t>(width) * height * channels);
+  while (width > 1 || height > 1) {
+    outLevels.push_back(downsample(outLevels.back(), width, height, channels));
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+}
+
+static GLenum clientFormat(int nrChannels) {
   if (nrChannels == 1) {
-    format = GL_RED;
+    return GL_RED;
   } else if (nrChannels == 3) {
-    format = GL_RGB;
-  } else if (nrChannels == 4) {
-    format = GL_RGBA;
-  } else {
-    std::cerr << "Unsupported image channels: " << nrChannels << std::endl;
-    stbi_image_free(image);
-    return 0;
+    return GL_RGB;
   }
+  return GL_RGBA;
+}
 
-  GLuint textureID;
-  glGenTextures(1, &textureID);
+/* Wrapping and filtering for the bound texture. Images with alpha are
+ * usually cut-outs, whose edges would bleed into each other when repeated. */
+static void setSampling(bool hasAlpha) {
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, hasAlpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, hasAlpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/* Returns the GPU memory the texture now takes. */
+static size_t uploadImage(GLuint textureID, int width, int height, int nrChannels, const unsigned char* pixels) {
+  GLenum format = clientFormat(nrChannels);
 
   /* Bind it so any subsequent texture commands will configure the currently
    * bound texture. */
-  glBindTexture(GL_TEXTURE_2D, textureID);
+  GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
+  /* Rows of 1- and 3-channel images are not necessarily 4-byte aligned. */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   glGenerateMipmap(GL_TEXTURE_2D);
 
   /* Set the texture wrapping/filtering options (on the currently bound texture
    * object. */
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  setSampling(format == GL_RGBA);
+
+  /* Three-channel images are padded to four bytes per texel, see
+   * `uncompressedSize`. */
+  return mipChainSize(width, height, nrChannels == 1 ? 1 : 4);
+}
+
+static bool blockFormatToGL(BlockFormat format, GLenum& outInternalFormat) {
+  switch (format) {
+  case BlockFormat::BC1:
+    outInternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    return GLExtensions::isSupported("GL_EXT_texture_compression_s3tc");
+  case BlockFormat::BC3:
+    outInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return GLExtensions::isSupported("GL_EXT_texture_compression_s3tc");
+  case BlockFormat::BC4:
+    /* RGTC is core since OpenGL 3.0. */
+    outInternalFormat = GL_COMPRESSED_RED_RGTC1;
+    return true;
+  case BlockFormat::BC5:
+    outInternalFormat = GL_COMPRESSED_RG_RGTC2;
+    return true;
+  }
+  return false;
+}
+
+/* What the same mip chain would occupy uncompressed. Three-channel images are
+ * padded to four bytes per texel by every driver we care about. */
+static size_t uncompressedSize(const CookedTexture& cookedTexture) {
+  size_t bytesPerTexel = 4;
+  if (cookedTexture.getFormat() == BlockFormat::BC4) {
+    bytesPerTexel = 1;
+  } else if (cookedTexture.getFormat() == BlockFormat::BC5) {
+    bytesPerTexel = 2;
+  }
+
+  size_t size = 0;
+  for (const auto& level : cookedTexture.getLevels()) {
+    size += static_cast<size_t>(level.width) * level.height * bytesPerTexel;
+  }
+  return size;
+}
+
+TextureHandle::TextureHandle(uint32_t slot)
+  : slot(slot) {
+  TextureLoader::instance().retain(slot);
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other)
+  : slot(other.slot) {
+  if (slot != NO_SLOT) {
+    TextureLoader::instance().retain(slot);
+  }
+}
+
+TextureHandle::~TextureHandle(void) {
+  if (slot != NO_SLOT) {
+    TextureLoader::instance().release(slot);
+  }
+}
+
+GLuint TextureHandle::getID(void) const {
+  const TextureLoader& loader = TextureLoader::instance();
+  if (slot == NO_SLOT || loader.shutDown) {
+    return 0;
+  }
+  return loader.entries[slot].textureID;
+}
+
+GLenum TextureHandle::getTarget(void) const {
+  const TextureLoader& loader = TextureLoader::instance();
+  if (slot == NO_SLOT || loader.shutDown) {
+    return GL_TEXTURE_2D;
+  }
+  return loader.entries[slot].target;
+}
+
+TextureLoader::TextureLoader(void) = default;
+
+TextureLoader::~TextureLoader(void) {
+  /* By now the context is long gone, so only what the workers produced is
+   * left to free; `shutdown` deleted the textures. */
+  decodePool.reset();
+}
+
+TextureHandle TextureLoader::loadTexture(const std::string& path) {
+  auto it = cache.find(path);
+  if (it != cache.end()) {
+    /* Referenced first, so uploading can't make it an eviction candidate. */
+    uint32_t slot = it->second;
+    TextureHandle handle(slot);
+    /* An asynchronous load of the same image may still be in flight, or
+     * have only its coarsest levels uploaded; the caller expects the real
+     * contents. */
+    waitForDecodedImage(handle.getID());
+    if (entries[slot].stream != NO_STREAM) {
+      finishStreaming(entries[slot].stream);
+    }
+    return handle;
+  }
+
+  uint32_t slot = loadCookedTexture(path, false);
+  if (slot != TextureHandle::NO_SLOT) {
+    return TextureHandle(slot);
+  }
+
+  /* Load and generate the texture. */
+  int width, height, nrChannels;
+  unsigned char* pixels;
+  if (!decodeImage(path, width, height, nrChannels, pixels)) {
+    return TextureHandle();
+  }
+
+  GLuint textureID;
+  glGenTextures(1, &textureID);
+  size_t size = uploadImage(textureID, width, height, nrChannels, pixels);
+  stbi_image_free(pixels);
+
+  return TextureHandle(addEntry(path, textureID, size));
+}
+
+TextureHandle TextureLoader::loadTextureAsync(const std::string& path) {
+  auto it = cache.find(path);
+  if (it != cache.end()) {
+    return TextureHandle(it->second);
+  }
+
+  /* Cooked textures need no decoding: the mip chain is uploaded straight from
+   * the mapped file, so there is nothing to gain from a worker thread. */
+  uint32_t slot = loadCookedTexture(path, true);
+  if (slot != TextureHandle::NO_SLOT) {
+    return TextureHandle(slot);
+  }
+
+  GLuint textureID;
+  glGenTextures(1, &textureID);
+
+  /* A mid-grey texel keeps lit surfaces readable while the real image is on
+   * its way. */
+  static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+  GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  TextureHandle handle(addEntry(path, textureID, sizeof placeholder));
+  pending.insert(textureID);
+
+  getDecodePool().submit([this, textureID, path](void) {
+    ProfileScope profileScope("Texture decode");
+    DecodedImage image = { textureID, path, 0, 0, 0, {} };
+    /* On failure the missing levels tell the GL thread to keep the
+     * placeholder. */
+    unsigned char* pixels;
+    if (decodeImage(path, image.width, image.height, image.nrChannels, pixels)) {
+      buildMipChain(pixels, image.width, image.height, image.nrChannels, image.levels);
+      stbi_image_free(pixels);
+    }
+    {
+      std::lock_guard<std::mutex> lock(decodedMutex);
+      decoded.push_back(std::move(image));
+    }
+    decodedCondition.notify_one();
+  });
+
+  return handle;
+}
+
+uint32_t TextureLoader::loadCookedTexture(const std::string& path, bool streamed) {
+  std::shared_ptr<const CookedTexture> cookedTexture = CookedTexture::openFor(path);
+  if (!cookedTexture) {
+    return TextureHandle::NO_SLOT;
+  }
+
+  GLenum internalFormat;
+  if (!blockFormatToGL(cookedTexture->getFormat(), internalFormat)) {
+    std::cerr << "Compressed format " << blockFormatName(cookedTexture->getFormat())
+              << " is not supported, falling back to " << path << std::endl;
+    return TextureHandle::NO_SLOT;
+  }
+
+  const auto& levels = cookedTexture->getLevels();
+
+  GLuint textureID;
+  glGenTextures(1, &textureID);
+  GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
+
+  /* The cooker stored every mip level, so there is nothing to generate.
+   * Streamed textures only get their storage here. */
+  GLsizei levelCount = static_cast<GLsizei>(levels.size());
+  if (streamed && GLExtensions::texStorage2D) {
+    GLExtensions::texStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, levels[0].width, levels[0].height);
+  } else {
+    for (GLsizei i = 0; i < levelCount; ++i) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, levels[i].width, levels[i].height, 0,
+                             static_cast<GLsizei>(levels[i].size), streamed ? NULL : levels[i].data);
+    }
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1));
+
+  bool hasAlpha = cookedTexture->getFormat() == BlockFormat::BC3;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, hasAlpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, hasAlpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  stbi_image_free(image);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  size_t compressedSize = cookedTexture->getSize();
+  size_t rawSize = uncompressedSize(*cookedTexture);
+  if (rawSize > compressedSize) {
+    compressedBytesSaved += rawSize - compressedSize;
+  }
+  std::cout << "Loaded cooked texture " << CookedTexture::pathFor(path) << " ("
+            << blockFormatName(cookedTexture->getFormat()) << ", " << levels.size() << " levels): "
+            << compressedSize << " bytes instead of " << rawSize << std::endl;
+
+  uint32_t slot = addEntry(path, textureID, compressedSize);
+  if (streamed) {
+    startStreaming({ slot, textureID, static_cast<int>(levels[0].width), static_cast<int>(levels[0].height), levelCount,
+                     levelCount, levelCount, 0.0f, 0.0f, GL_NONE, {}, cookedTexture, internalFormat });
+  }
+  return slot;
+}
+
+TextureHandle TextureLoader::loadCubemapTexture(const std::string& directory) {
+  auto it = cache.find(directory);
+  if (it != cache.end()) {
+    return TextureHandle(it->second);
+  }
+
+  ProfileScope profileScope("Cubemap load");
+  auto startTime = std::chrono::steady_clock::now();
+
+  static const std::pair<GLenum, const char*> faces[6] = {
+    { GL_TEXTURE_CUBE_MAP_POSITIVE_X,  "right.jpg" },
+    { GL_TEXTURE_CUBE_MAP_NEGATIVE_X,   "left.jpg" },
+    { GL_TEXTURE_CUBE_MAP_POSITIVE_Y,    "top.jpg" },
+    { GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, "bottom.jpg" },
+    { GL_TEXTURE_CUBE_MAP_POSITIVE_Z,  "front.jpg" },
+    { GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,   "back.jpg" },
+  };
+
+  struct Face {
+    int width;
+    int height;
+    int nrChannels;
+    unsigned char* pixels;
+  };
+  Face images[6] = {};
+  std::future<bool> decodes[6];
+  for (int i = 0; i < 6; ++i) {
+    std::string path = directory + "/" + faces[i].second;
+    decodes[i] = getDecodePool().submit([path, &image = images[i]](void) {
+      ProfileScope profileScope("Cubemap face decode");
+      /* Cubemap faces are looked at from the inside, in the orientation
+       * they are stored in. */
+      return decodeImage(path, image.width, image.height, image.nrChannels, image.pixels, false);
+    });
+  }
+  bool decoded = true;
+  for (auto& decode : decodes) {
+    decoded = decode.get() && decoded;
+  }
+  auto decodedTime = std::chrono::steady_clock::now();
+
+  for (const Face& image : images) {
+    if (decoded && (image.width != images[0].width || image.height != images[0].height || image.nrChannels != images[0].nrChannels)) {
+      std::cerr << "Cubemap faces differ in size or channels: " << directory << std::endl;
+      decoded = false;
+    }
+  }
+  if (!decoded) {
+    for (const Face& image : images) {
+      stbi_image_free(image.pixels);
+    }
+    return TextureHandle();
+  }
+
+  int width = images[0].width;
+  int height = images[0].height;
+  GLenum format = clientFormat(images[0].nrChannels);
+  GLenum internalFormat = images[0].nrChannels == 1 ? GL_R8 : (images[0].nrChannels == 3 ? GL_RGB8 : GL_RGBA8);
+  int levelCount = 1;
+  while (std::max(width, height) >> levelCount) {
+    ++levelCount;
+  }
 
-  cache[path] = textureID;
+  GLuint textureID;
+  glGenTextures(1, &textureID);
+  GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+  if (GLExtensions::texStorage2D) {
+    GLExtensions::texStorage2D(GL_TEXTURE_CUBE_MAP, levelCount, internalFormat, width, height);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (int i = 0; i < 6; ++i) {
+    if (GLExtensions::texStorage2D) {
+      glTexSubImage2D(faces[i].first, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, images[i].pixels);
+    } else {
+      glTexImage2D(faces[i].first, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, images[i].pixels);
+    }
+    stbi_image_free(images[i].pixels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  /* Filter across face edges, or the seams show once the smaller mips are
+   * sampled. This is global state, but no one wants it off. */
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+  std::chrono::duration<double, std::milli> decodeTime = decodedTime - startTime;
+  std::chrono::duration<double, std::milli> totalTime = std::chrono::steady_clock::now() - startTime;
+  std::cout << "Loaded cubemap '" << directory << "' (" << width << "x" << height << ", " << levelCount << " levels) in "
+            << totalTime.count() << " ms, of which decoding took " << decodeTime.count() << " ms" << std::endl;
+
+  size_t size = 6 * mipChainSize(width, height, images[0].nrChannels == 1 ? 1 : 4);
+  return TextureHandle(addEntry(directory, textureID, size, GL_TEXTURE_CUBE_MAP));
+}
+
+ThreadPool& TextureLoader::getDecodePool(void) {
+  if (!decodePool) {
+    decodePool = std::make_unique<ThreadPool>();
+  }
+  return *decodePool;
+}
+
+uint32_t TextureLoader::addEntry(const std::string& path, GLuint textureID, size_t size, GLenum target) {
+  uint32_t slot;
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(entries.size());
+    entries.emplace_back();
+  }
+  entries[slot] = { path, target, textureID, size, 0, unused.end(), NO_STREAM };
+  cache[path] = slot;
+  residentBytes += size;
+  /* Make room for it among the unreferenced textures. */
+  evictUnused();
+  return slot;
+}
+
+void TextureLoader::retain(uint32_t slot) {
+  if (shutDown) {
+    return;
+  }
+  Entry& entry = entries[slot];
+  if (entry.references++ == 0 && entry.unusedPosition != unused.end()) {
+    unused.erase(entry.unusedPosition);
+    entry.unusedPosition = unused.end();
+  }
+}
+
+void TextureLoader::release(uint32_t slot) {
+  if (shutDown) {
+    return;
+  }
+  Entry& entry = entries[slot];
+  if (--entry.references == 0) {
+    entry.unusedPosition = unused.insert(unused.end(), slot);
+    evictUnused();
+  }
+}
+
+void TextureLoader::resize(uint32_t slot, size_t size) {
+  residentBytes = residentBytes - entries[slot].size + size;
+  entries[slot].size = size;
+  evictUnused();
+}
 
-  return textureID;
+void TextureLoader::evictUnused(void) {
+  for (auto it = unused.begin(); it != unused.end() && residentBytes > budget;) {
+    Entry& entry = entries[*it];
+    /* The decode worker still expects to hand its image to this texture. */
+    if (pending.count(entry.textureID) != 0) {
+      ++it;
+      continue;
+    }
+    if (entry.stream != NO_STREAM) {
+      stopStreaming(entry.stream);
+    }
+    GLState::deleteTexture(entry.textureID);
+    residentBytes -= entry.size;
+    cache.erase(entry.path);
+    freeSlots.push_back(*it);
+    entry = { std::string(), GL_TEXTURE_2D, 0, 0, 0, unused.end(), NO_STREAM };
+    it = unused.erase(it);
+  }
+
+  if (residentBytes > budget && !overBudgetReported) {
+    std::cerr << "Textures in use take " << residentBytes << " bytes, more than the budget of " << budget << std::endl;
+  }
+  overBudgetReported = residentBytes > budget;
+}
+
+void TextureLoader::uploadDecodedImages(void) {
+  std::vector<DecodedImage> ready;
+  {
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    ready.swap(decoded);
+  }
+
+  for (auto& image : ready) {
+    if (image.levels.empty()) {
+      pending.erase(image.textureID);
+      continue;
+    }
+    ProfileScope profileScope("Texture upload");
+    /* Pending textures are never evicted, so the entry is still there. */
+    uint32_t slot = cache.at(image.path);
+    GLenum format = clientFormat(image.nrChannels);
+    GLenum internalFormat = image.nrChannels == 1 ? GL_R8 : (image.nrChannels == 3 ? GL_RGB8 : GL_RGBA8);
+    int levelCount = static_cast<int>(image.levels.size());
+
+    /* Storage for the whole chain replaces the placeholder. Immutable
+     * storage, where there is any, spares the driver from checking the
+     * levels for completeness each time the base level moves. */
+    GLState::bindTexture(0, GL_TEXTURE_2D, image.textureID);
+    if (GLExtensions::texStorage2D) {
+      GLExtensions::texStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, image.width, image.height);
+    } else {
+      for (int level = 0; level < levelCount; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelDimension(image.width, level), levelDimension(image.height, level), 0,
+                     format, GL_UNSIGNED_BYTE, NULL);
+      }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    setSampling(format == GL_RGBA);
+
+    startStreaming({ slot, image.textureID, image.width, image.height, levelCount, levelCount, levelCount, 0.0f, 0.0f, format,
+                     std::move(image.levels), nullptr, GL_NONE });
+    pending.erase(image.textureID);
+    resize(slot, mipChainSize(image.width, image.height, image.nrChannels == 1 ? 1 : 4));
+  }
+}
+
+void TextureLoader::waitForDecodedImage(GLuint textureID) {
+  while (pending.count(textureID) != 0) {
+    {
+      std::unique_lock<std::mutex> lock(decodedMutex);
+      decodedCondition.wait(lock, [this](void) { return !decoded.empty(); });
+    }
+    uploadDecodedImages();
+  }
+}
+
+void TextureLoader::waitForDecodedImages(void) {
+  while (!pending.empty()) {
+    {
+      std::unique_lock<std::mutex> lock(decodedMutex);
+      decodedCondition.wait(lock, [this](void) { return !decoded.empty(); });
+    }
+    uploadDecodedImages();
+  }
+  streamLevels(true);
+}
+
+void TextureLoader::releaseAll(void) {
+  /* Join the workers before touching what they produce. */
+  decodePool.reset();
+  decoded.clear();
+  pending.clear();
+  streams.clear();
+
+  for (const auto& entry : entries) {
+    if (entry.textureID != 0) {
+      GLState::deleteTexture(entry.textureID);
+    }
+  }
+  entries.clear();
+  freeSlots.clear();
+  cache.clear();
+  unused.clear();
+  residentBytes = 0;
+  shutDown = true;
+}
+
+void TextureLoader::startStreaming(StreamedTexture stream) {
+  /* Enough to show something sensible straight away. */
+  int level = stream.levelCount - 1;
+  uploadLevel(stream, level);
+  while (level > 0 && std::max(levelDimension(stream.width, level - 1), levelDimension(stream.height, level - 1)) <= INITIAL_LEVEL_SIZE) {
+    uploadLevel(stream, --level);
+  }
+  if (stream.residentLevel > 0) {
+    entries[stream.slot].stream = static_cast<uint32_t>(streams.size());
+    streams.push_back(std::move(stream));
+  }
+}
+
+void TextureLoader::stopStreaming(uint32_t stream) {
+  entries[streams[stream].slot].stream = NO_STREAM;
+  if (stream + 1 != streams.size()) {
+    streams[stream] = std::move(streams.back());
+    entries[streams[stream].slot].stream = stream;
+  }
+  streams.pop_back();
+}
+
+void TextureLoader::finishStreaming(uint32_t stream) {
+  StreamedTexture& texture = streams[stream];
+  while (texture.residentLevel > 0) {
+    uploadLevel(texture, texture.residentLevel - 1);
+  }
+  if (texture.minLod > 0.0f) {
+    texture.minLod = 0.0f;
+    GLState::bindTexture(0, GL_TEXTURE_2D, texture.textureID);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0.0f);
+  }
+  stopStreaming(stream);
+}
+
+void TextureLoader::uploadLevel(StreamedTexture& stream, int level) {
+  GLState::bindTexture(0, GL_TEXTURE_2D, stream.textureID);
+  if (stream.cooked) {
+    const CookedTexture::Level& data = stream.cooked->getLevels()[level];
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, data.width, data.height, stream.compressedFormat,
+                              static_cast<GLsizei>(data.size), data.data);
+  } else {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levelDimension(stream.width, level), levelDimension(stream.height, level),
+                    stream.format, GL_UNSIGNED_BYTE, stream.levels[level].data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    std::vector<unsigned char>().swap(stream.levels[level]);
+  }
+  /* Sampling never reaches below the base level, so the levels that
+   * haven't arrived yet are never read. */
+  stream.residentLevel = level;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+}
+
+void TextureLoader::requestTextureDetail(uint32_t slot, float screenSize) {
+  if (slot == TextureHandle::NO_SLOT || shutDown || entries[slot].stream == NO_STREAM) {
+    return;
+  }
+  StreamedTexture& stream = streams[entries[slot].stream];
+  /* About a texel per pixel; every level down halves the texels. */
+  float texels = static_cast<float>(std::max(stream.width, stream.height));
+  int level = screenSize >= texels ? 0 : static_cast<int>(std::log2(texels / std::max(screenSize, 1.0f)));
+  stream.requestedLevel = std::min(stream.requestedLevel, std::min(level, stream.levelCount - 1));
+  stream.screenSize = std::max(stream.screenSize, screenSize);
+}
+
+void TextureLoader::streamLevels(bool all) {
+  if (streams.empty()) {
+    return;
+  }
+  ProfileScope profileScope("Texture streaming");
+
+  /* Blend in the levels of earlier frames. */
+  for (auto& stream : streams) {
+    if (stream.minLod > 0.0f) {
+      stream.minLod = all ? 0.0f : std::max(stream.minLod - LEVEL_FADE_STEP, 0.0f);
+      GLState::bindTexture(0, GL_TEXTURE_2D, stream.textureID);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, stream.minLod);
+    }
+  }
+
+  /* Textures short of what was asked for first, the largest on screen
+   * first; then the rest, which sharpen as the rate allows. */
+  streamOrder.clear();
+  for (uint32_t i = 0; i < streams.size(); ++i) {
+    if (streams[i].residentLevel > 0) {
+      streamOrder.push_back(i);
+    }
+  }
+  std::sort(streamOrder.begin(), streamOrder.end(), [this](uint32_t a, uint32_t b) {
+    const StreamedTexture& lhs = streams[a];
+    const StreamedTexture& rhs = streams[b];
+    bool lhsShort = lhs.residentLevel > lhs.requestedLevel;
+    bool rhsShort = rhs.residentLevel > rhs.requestedLevel;
+    if (lhsShort != rhsShort) {
+      return lhsShort;
+    }
+    return lhs.screenSize > rhs.screenSize;
+  });
+
+  size_t uploaded = 0;
+  for (uint32_t index : streamOrder) {
+    if (!all && uploaded >= streamingRate) {
+      break;
+    }
+    StreamedTexture& stream = streams[index];
+    do {
+      int level = stream.residentLevel - 1;
+      uploaded += stream.cooked ? stream.cooked->getLevels()[level].size : stream.levels[level].size();
+      uploadLevel(stream, level);
+    } while (all && stream.residentLevel > 0);
+    /* Sampling from one level further down looks exactly like before the
+     * base level moved; fading that out blends the new level in. */
+    if (!all) {
+      stream.minLod += 1.0f;
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, stream.minLod);
+    }
+  }
+
+  for (size_t i = streams.size(); i-- > 0;) {
+    StreamedTexture& stream = streams[i];
+    stream.requestedLevel = stream.levelCount;
+    stream.screenSize = 0.0f;
+    if (stream.residentLevel == 0 && stream.minLod == 0.0f) {
+      stopStreaming(static_cast<uint32_t>(i));
+    }
+  }
 }
@@ -1,24 +1,286 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 
+class CookedTexture;
+class ThreadPool;
+
+/* A counted reference to a texture owned by `TextureLoader`. The texture
+ * stays resident while any handle to it is alive; once the last one goes,
+ * the texture is kept as a cache entry until the memory budget needs the
+ * room, and is loaded again if anyone asks for it afterwards.
+ *
+ * Handles must be copied and destroyed on the GL thread. */
+class TextureHandle {
+public:
+  TextureHandle(void) = default;
+  TextureHandle(const TextureHandle& other);
+  TextureHandle(TextureHandle&& other) noexcept
+    : slot(other.slot) {
+    other.slot = NO_SLOT;
+  }
+
+  TextureHandle& operator=(TextureHandle other) noexcept {
+    std::swap(slot, other.slot);
+    return *this;
+  }
+
+  ~TextureHandle(void);
+
+  /* False for failed loads. */
+  bool isValid(void) const {
+    return slot != NO_SLOT;
+  }
+
+  /* The texture name, which stays the same for as long as the handle is
+   * alive; 0 for an invalid handle. */
+  GLuint getID(void) const;
+
+  /* `GL_TEXTURE_2D` or `GL_TEXTURE_CUBE_MAP`. */
+  GLenum getTarget(void) const;
+
+private:
+  friend class TextureLoader;
+
+  static constexpr uint32_t NO_SLOT = ~0u;
+
+  /* Takes a reference. */
+  explicit TextureHandle(uint32_t slot);
+
+  uint32_t slot = NO_SLOT;
+};
+
 class TextureLoader {
 public:
-  static GLuint load(const std::string& path) {
-    static TextureLoader instance;
-    return instance.loadTexture(path);
+  static TextureHandle load(const std::string& path) {
+    return instance().loadTexture(path);
+  }
+
+  /* Returns a handle right away. Until the image has been decoded on a
+   * worker thread and handed to `processUploads`, the texture holds a 1x1
+   * placeholder, so it can be bound and drawn with immediately. From then on
+   * it is streamed: its smallest mip levels are uploaded at once, finer ones
+   * over the following frames, see `requestDetail`. */
+  static TextureHandle loadAsync(const std::string& path) {
+    return instance().loadTextureAsync(path);
+  }
+
+  /* Uploads every image whose decoding has finished, then streams in finer
+   * mip levels up to the streaming rate. Must be called on the thread that
+   * owns the GL context, once per frame. */
+  static void processUploads(void) {
+    instance().uploadDecodedImages();
+    instance().streamLevels(false);
+  }
+
+  /* Loads the six faces in `directory`, named `right`, `left`, `top`,
+   * `bottom`, `front` and `back` with a `.jpg` extension, into a mipmapped
+   * cubemap. The faces are decoded concurrently on the decode workers while
+   * the caller waits. Shares the cache and budget with 2D textures. */
+  static TextureHandle loadCubemap(const std::string& directory) {
+    return instance().loadCubemapTexture(directory);
+  }
+
+  /* Blocks until all asynchronous loads have been uploaded in full. */
+  static void finishUploads(void) {
+    instance().waitForDecodedImages();
+  }
+
+  static bool isReady(GLuint textureID) {
+    return instance().pending.count(textureID) == 0;
+  }
+
+  /* Asks for enough detail to cover `screenSize` pixels, for a texture
+   * mapped once across something that spans that much of the screen.
+   * Streaming textures short of the detail asked for get their next level
+   * first, the largest on screen before the rest; ask every frame the
+   * texture is visible. */
+  static void requestDetail(const TextureHandle& texture, float screenSize) {
+    instance().requestTextureDetail(texture.slot, screenSize);
+  }
+
+  /* Caps the bytes of mip levels streamed in per frame, though every frame
+   * uploads at least one level while any are missing. */
+  static void setStreamingRate(size_t bytesPerFrame) {
+    instance().streamingRate = bytesPerFrame;
+  }
+
+  /* Caps the GPU memory held by all textures, referenced or not. Only
+   * textures nobody references any more are evicted to stay within it, the
+   * least recently released first, so referenced ones can still push the
+   * total past the budget. */
+  static void setBudget(size_t bytes) {
+    instance().budget = bytes;
+    instance().evictUnused();
+  }
+
+  static size_t getBudget(void) {
+    return instance().budget;
+  }
+
+  /* Estimated GPU memory of every texture currently loaded, mip chains
+   * included. */
+  static size_t getResidentBytes(void) {
+    return instance().residentBytes;
+  }
+
+  /* How much GPU memory loading cooked, block-compressed textures has saved
+   * compared to uploading their source images. */
+  static size_t getCompressedBytesSaved(void) {
+    return instance().compressedBytesSaved;
+  }
+
+  /* Stops the decode workers and deletes every texture. Call while the
+   * context is still current: the loader itself is only destroyed with the
+   * other statics, long after the context is gone. Handles that outlive
+   * this refer to nothing. */
+  static void shutdown(void) {
+    instance().releaseAll();
   }
 
 private:
-  TextureLoader(void) = default;
+  friend class TextureHandle;
+
+  struct Entry {
+    std::string path;
+    GLenum target;
+    /* 0 while the slot is free. */
+    GLuint textureID;
+    size_t size;
+    uint32_t references;
+    /* Position in `unused` while unreferenced, otherwise its end. */
+    std::list<uint32_t>::iterator unusedPosition;
+    /* Index in `streams`, or `NO_STREAM`. */
+    uint32_t stream;
+  };
+
+  struct DecodedImage {
+    GLuint textureID;
+    std::string path;
+    int width;
+    int height;
+    int nrChannels;
+    /* The full mip chain, base level first; empty if decoding failed. */
+    std::vector<std::vector<unsigned char>> levels;
+  };
+
+  /* A texture with storage for its whole mip chain, of which only the
+   * coarsest levels have been uploaded so far. */
+  struct StreamedTexture {
+    uint32_t slot;
+    GLuint textureID;
+    /* Of the base level. */
+    int width;
+    int height;
+    int levelCount;
+    /* The finest level uploaded, which is the texture's base level. */
+    int residentLevel;
+    /* The finest level asked for this frame, or `levelCount`. */
+    int requestedLevel;
+    float screenSize;
+    /* Starts at 1 whenever the base level drops, so the new level blends in
+     * over a few frames instead of popping. */
+    float minLod;
+    /* Decoded images: the client format and the levels still to upload. */
+    GLenum format;
+    std::vector<std::vector<unsigned char>> levels;
+    /* Cooked textures upload straight from the mapped file. */
+    std::shared_ptr<const CookedTexture> cooked;
+    GLenum compressedFormat;
+  };
+
+  /* Generous enough for the sample scenes, small enough for integrated
+   * GPUs. */
+  static constexpr size_t DEFAULT_BUDGET = 512u << 20;
+  /* About a millisecond of uploading on a desktop GPU. */
+  static constexpr size_t DEFAULT_STREAMING_RATE = 4u << 20;
+  static constexpr uint32_t NO_STREAM = ~0u;
+
+  TextureLoader(void);
   TextureLoader(const TextureLoader&) = delete;
 
   ~TextureLoader(void);
 
-  GLuint loadTexture(const std::string& path);
+  static TextureLoader& instance(void) {
+    static TextureLoader instance;
+    return instance;
+  }
+
+  TextureHandle loadTexture(const std::string& path);
+  TextureHandle loadTextureAsync(const std::string& path);
+  /* Returns the new entry's slot, or `TextureHandle::NO_SLOT`. */
+  uint32_t loadCookedTexture(const std::string& path, bool streamed);
+  TextureHandle loadCubemapTexture(const std::string& directory);
+
+  ThreadPool& getDecodePool(void);
+
+  /* Registers a freshly created texture, unreferenced until the caller
+   * wraps the slot in a handle. */
+  uint32_t addEntry(const std::string& path, GLuint textureID, size_t size, GLenum target = GL_TEXTURE_2D);
+  void retain(uint32_t slot);
+  void release(uint32_t slot);
+  void resize(uint32_t slot, size_t size);
+  void evictUnused(void);
+
+  /* Uploads the coarsest levels and, unless that was all of them, queues
+   * the texture for streaming. Its storage must already be allocated. */
+  void startStreaming(StreamedTexture stream);
+  void stopStreaming(uint32_t stream);
+  /* Uploads every level the texture still lacks, at once, and stops
+   * streaming it. */
+  void finishStreaming(uint32_t stream);
+  /* Uploads `level` and makes it the base level. */
+  void uploadLevel(StreamedTexture& stream, int level);
+  void requestTextureDetail(uint32_t slot, float screenSize);
+  /* Uploads the next level of the textures that need it most, within the
+   * streaming rate, or every level left if `all`. */
+  void streamLevels(bool all);
+
+  void uploadDecodedImages(void);
+  /* Uploads images as they finish decoding until `textureID`'s is among
+   * them; other textures keep streaming as usual. */
+  void waitForDecodedImage(GLuint textureID);
+  void waitForDecodedImages(void);
+  void releaseAll(void);
+
+  std::vector<Entry> entries;
+  std::vector<uint32_t> freeSlots;
+  /* Path to slot, for the textures currently loaded. */
+  std::unordered_map<std::string, uint32_t> cache;
+  /* Unreferenced entries, least recently released first. */
+  std::list<uint32_t> unused;
+
+  std::vector<StreamedTexture> streams;
+  std::vector<uint32_t> streamOrder;
+  size_t streamingRate = DEFAULT_STREAMING_RATE;
+
+  size_t budget = DEFAULT_BUDGET;
+  size_t residentBytes = 0;
+  bool overBudgetReported = false;
+  /* Set by `shutdown`, after which handles are inert. */
+  bool shutDown = false;
+
+  /* Textures still showing the placeholder. Only touched on the GL thread. */
+  std::unordered_set<GLuint> pending;
+
+  /* Created on the first asynchronous load. */
+  std::unique_ptr<ThreadPool> decodePool;
+
+  /* Filled by the decode workers, drained on the GL thread. */
+  std::mutex decodedMutex;
+  std::condition_variable decodedCondition;
+  std::vector<DecodedImage> decoded;
 
-  std::unordered_map<std::string, GLuint> cache;
+  size_t compressedBytesSaved = 0;
 };
@@ -0,0 +1,41 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount)
+  : stopping(false) {
+  workers.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool(void) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::defaultThreadCount(void) {
+  unsigned int hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+void ThreadPool::workerLoop(void) {
+  for (;;) {
+    std::function<void(void)> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this](void) { return stopping || !tasks.empty(); });
+      if (tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/* A fixed-size pool of worker threads consuming a FIFO of tasks. Tasks must
+ * not touch OpenGL: the context is only current on the main thread. */
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threadCount = defaultThreadCount());
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /* Finishes the queued tasks, then joins the workers. */
+  ~ThreadPool(void);
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& task);
+
+  size_t size(void) const {
+    return workers.size();
+  }
+
+  /* One worker per hardware thread, leaving one for the render loop. */
+  static size_t defaultThreadCount(void);
+
+private:
+  void workerLoop(void);
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void(void)>> tasks;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::submit(F&& task) {
+  using R = std::invoke_result_t<F>;
+
+  /* `std::function` needs a copyable target, `std::packaged_task` is move
+   * only. */
+  auto packagedTask = std::make_shared<std::packaged_task<R(void)>>(std::forward<F>(task));
+  std::future<R> future = packagedTask->get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.emplace_back([packagedTask](void) { (*packagedTask)(); });
+  }
+  condition.notify_one();
+  return future;
+}
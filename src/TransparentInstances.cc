@@ -0,0 +1,116 @@
+#include "TransparentInstances.h"
+
+#include <chrono>
+
+#include "Profiler.h"
+#include "RadixSort.h"
+
+namespace {
+
+/* Work the insertion sort may do, in places moved per instance, before the
+ * order counts as lost and a radix sort takes over. Radix sorting costs
+ * about as much as moving every instance this many places. */
+constexpr size_t MOVES_PER_INSTANCE = 8;
+
+}
+
+TransparentInstances::Instance TransparentInstances::add(const InstanceTRS& instance) {
+  Instance id = static_cast<Instance>(ids.size());
+  slots.push_back(static_cast<uint32_t>(instances.size()));
+  ids.push_back(id);
+  instances.push_back(instance);
+  return id;
+}
+
+void TransparentInstances::set(Instance instance, const InstanceTRS& value) {
+  instances[slots[instance]] = value;
+}
+
+void TransparentInstances::sort(const glm::mat4& viewMatrix) {
+  ProfileScope profileScope("Transparency sort");
+  auto start = std::chrono::steady_clock::now();
+
+  computeKeys(viewMatrix);
+  statistics.fullSort = !insertionSort();
+  if (statistics.fullSort) {
+    radixSort(order, scratch);
+  }
+  if (statistics.fullSort || statistics.moves > 0) {
+    applyOrder();
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  statistics.instances = instances.size();
+  statistics.sortTime = elapsed.count();
+}
+
+void TransparentInstances::sortFromScratch(const glm::mat4& viewMatrix) {
+  ProfileScope profileScope("Transparency sort");
+  auto start = std::chrono::steady_clock::now();
+
+  computeKeys(viewMatrix);
+  radixSort(order, scratch);
+  applyOrder();
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  statistics.instances = instances.size();
+  statistics.moves = 0;
+  statistics.fullSort = true;
+  statistics.sortTime = elapsed.count();
+}
+
+void TransparentInstances::computeKeys(const glm::mat4& viewMatrix) {
+  /* The view depth of a point is minus its view-space z. */
+  glm::vec3 axis(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2]);
+  float offset = viewMatrix[3][2];
+
+  /* Farther instances get smaller keys, so that increasing keys are back to
+   * front. Those behind the camera all get the largest key. */
+  order.resize(instances.size());
+  for (size_t i = 0; i < instances.size(); ++i) {
+    glm::vec3 translation(instances[i].translationScale);
+    order[i] = { ~depthBits(-(glm::dot(axis, translation) + offset)), static_cast<uint32_t>(i) };
+  }
+}
+
+bool TransparentInstances::insertionSort(void) {
+  /* The budget grows with the instances sorted so far, so that a hopeless
+   * order is given up on early rather than after most of the budget went
+   * into it. The part that is there from the start evens out instances
+   * bunched together. */
+  size_t budget = MOVES_PER_INSTANCE * order.size() / 16;
+  size_t moves = 0;
+
+  for (size_t i = 1; i < order.size(); ++i) {
+    SortEntry entry = order[i];
+    size_t j = i;
+    while (j > 0 && order[j - 1].key > entry.key) {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = entry;
+
+    moves += i - j;
+    budget += MOVES_PER_INSTANCE;
+    if (moves > budget) {
+      statistics.moves = moves;
+      return false;
+    }
+  }
+
+  statistics.moves = moves;
+  return true;
+}
+
+void TransparentInstances::applyOrder(void) {
+  reorderedInstances.resize(instances.size());
+  reorderedIds.resize(ids.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    uint32_t slot = order[i].slot;
+    reorderedInstances[i] = instances[slot];
+    reorderedIds[i] = ids[slot];
+    slots[ids[slot]] = static_cast<uint32_t>(i);
+  }
+  instances.swap(reorderedInstances);
+  ids.swap(reorderedIds);
+}
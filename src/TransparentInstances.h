@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+/* Translucent instances of one mesh, kept from frame to frame in back to
+ * front order for a single instanced draw, which the GPU blends in instance
+ * order. Sorting moves the instances themselves, so working out depths and
+ * handing the array to `Mesh::setInstances` both read it front to back.
+ *
+ * Sorting is incremental: each frame starts from the last frame's order, and
+ * as the camera moves only a few instances change places, which an insertion
+ * sort fixes in about linear time. When the camera jumps and the order is
+ * far off, the insertion sort gives up after a fixed amount of work per
+ * instance, and a radix sort orders everything from scratch. */
+class TransparentInstances {
+public:
+  using Instance = uint32_t;
+
+  struct Statistics {
+    size_t instances;
+    /* Of the last `sort`: places the insertion sort moved instances by, and
+     * whether it gave up and a radix sort took over. */
+    size_t moves;
+    bool fullSort;
+    /* In milliseconds, including moving the instances into order. */
+    double sortTime;
+  };
+
+  Instance add(const InstanceTRS& instance);
+  void set(Instance instance, const InstanceTRS& value);
+
+  const InstanceTRS& get(Instance instance) const {
+    return instances[slots[instance]];
+  }
+
+  size_t size(void) const {
+    return instances.size();
+  }
+
+  /* Orders the instances back to front by the view depth of their
+   * translations. */
+  void sort(const glm::mat4& viewMatrix);
+
+  /* Always sorts from scratch, for comparison. Gives the same order as
+   * `sort`, except among instances at exactly the same depth. */
+  void sortFromScratch(const glm::mat4& viewMatrix);
+
+  /* Back to front as of the last sort, followed by the instances added
+   * since. */
+  const std::vector<InstanceTRS>& getInstances(void) const {
+    return instances;
+  }
+
+  const Statistics& getStatistics(void) const {
+    return statistics;
+  }
+
+private:
+  struct SortEntry {
+    /* Increases from back to front. */
+    uint32_t key;
+    /* Where the instance is in `instances`. */
+    uint32_t slot;
+  };
+
+  void computeKeys(const glm::mat4& viewMatrix);
+  /* False if it gave up, leaving `order` a permutation still. */
+  bool insertionSort(void);
+  /* Moves the instances into the order of `order`. */
+  void applyOrder(void);
+
+  std::vector<InstanceTRS> instances;
+  /* The instance in each slot, and the slot of each instance. */
+  std::vector<Instance> ids;
+  std::vector<uint32_t> slots;
+
+  std::vector<SortEntry> order;
+  std::vector<SortEntry> scratch;
+  std::vector<InstanceTRS> reorderedInstances;
+  std::vector<Instance> reorderedIds;
+
+  Statistics statistics = {};
+};
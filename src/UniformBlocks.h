@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/* The uniform blocks shared by all shaders, and the binding points they are
+ * bound to. The structs mirror the std140 declarations in the shaders under
+ * `assets/shaders/`; keep the two in sync. */
+
+constexpr GLuint FRAME_DATA_BINDING = 0;
+constexpr GLuint OBJECT_DATA_BINDING = 1;
+constexpr GLuint LIGHT_GRID_BINDING = 2;
+constexpr GLuint SHADOW_CASCADE_BINDING = 3;
+constexpr GLuint SHADOW_DATA_BINDING = 4;
+
+/* Set once per frame. */
+struct FrameData {
+  glm::mat4 viewMatrix;
+  glm::mat4 projectionMatrix;
+  glm::mat4 viewProjectionMatrix;
+  /* A vec3 followed by a float packs into one std140 vec4 slot. */
+  glm::vec3 cameraPosition;
+  float time;
+};
+
+/* Set per draw. */
+struct ObjectData {
+  glm::mat4 modelMatrix;
+  /* The inverse transpose of the model matrix; shaders use its upper 3x3,
+   * since std140 pads mat3 columns anyway. */
+  glm::mat4 normalMatrix;
+};
+
+/* Set once per frame, by `LightGrid::upload`. */
+struct LightGridData {
+  /* Clusters per pixel, in x and y. */
+  glm::vec2 tileScale;
+  /* The slice at a view-space depth d is log(d) * sliceScale - sliceBias. */
+  float sliceScale;
+  float sliceBias;
+  glm::uvec3 clusterCount;
+  GLuint lightCount;
+};
+
+/* Set per shadow cascade, while drawing its casters. */
+struct ShadowCascadeData {
+  glm::mat4 viewProjectionMatrix;
+};
+
+/* Set once per frame, by `CascadedShadowMap::render`. */
+struct ShadowData {
+  /* From world space to shadow map coordinates in [0, 1], per cascade; as
+   * many as `CascadedShadowMap::MAX_CASCADES`. */
+  glm::mat4 shadowMatrices[4];
+  /* The view-space depth where each cascade ends. */
+  glm::vec4 splitDepths;
+  /* The size of a texel of each cascade, in world units. */
+  glm::vec4 texelSizes;
+  /* Where the light shines, normalized. */
+  glm::vec3 lightDirection;
+  GLuint cascadeCount;
+  glm::vec3 lightColor;
+  float padding;
+};
+
+static_assert(sizeof(FrameData) == 3 * 64 + 16, "FrameData must match its std140 layout");
+static_assert(sizeof(ObjectData) == 2 * 64, "ObjectData must match its std140 layout");
+static_assert(sizeof(LightGridData) == 32, "LightGridData must match its std140 layout");
+static_assert(sizeof(ShadowCascadeData) == 64, "ShadowCascadeData must match its std140 layout");
+static_assert(sizeof(ShadowData) == 4 * 64 + 4 * 16, "ShadowData must match its std140 layout");
+
+struct UniformBlock {
+  const char* name;
+  GLuint binding;
+};
+
+/* `ShaderProgram::create` binds every block of these names it finds. */
+constexpr UniformBlock UNIFORM_BLOCKS[] = {
+  { "FrameData", FRAME_DATA_BINDING },
+  { "ObjectData", OBJECT_DATA_BINDING },
+  { "LightGrid", LIGHT_GRID_BINDING },
+  { "ShadowCascade", SHADOW_CASCADE_BINDING },
+  { "ShadowData", SHADOW_DATA_BINDING },
+};
+
+/* Texture units of data shared by all programs, kept clear of the low units
+ * `Mesh::bindTextures` hands out to materials. */
+constexpr GLuint SHADOW_MAP_UNIT = 12;
+constexpr GLuint LIGHT_DATA_UNIT = 13;
+constexpr GLuint LIGHT_CLUSTERS_UNIT = 14;
+constexpr GLuint LIGHT_INDICES_UNIT = 15;
+
+struct SharedSampler {
+  const char* name;
+  GLuint unit;
+};
+
+/* `ShaderProgram::create` points every sampler of these names it finds at
+ * its unit. */
+constexpr SharedSampler SHARED_SAMPLERS[] = {
+  { "shadowMap", SHADOW_MAP_UNIT },
+  { "lightData", LIGHT_DATA_UNIT },
+  { "lightClusters", LIGHT_CLUSTERS_UNIT },
+  { "lightIndices", LIGHT_INDICES_UNIT },
+};
+
+inline ObjectData makeObjectData(const glm::mat4& modelMatrix) {
+  return { modelMatrix, glm::transpose(glm::inverse(modelMatrix)) };
+}
@@ -0,0 +1,41 @@
+#include "UniformBuffer.h"
+
+#include <algorithm>
+
+std::unique_ptr<UniformBuffer> UniformBuffer::create(GLuint binding, size_t size) {
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+  return std::unique_ptr<UniformBuffer>(new UniformBuffer(binding, buffer, size));
+}
+
+UniformBuffer::UniformBuffer(GLuint binding, GLuint buffer, size_t size)
+  : binding(binding)
+  , buffer(buffer)
+  , size(size) {}
+
+UniformBuffer::~UniformBuffer(void) {
+  glDeleteBuffers(1, &buffer);
+}
+
+void UniformBuffer::update(const void* data, size_t dataSize) {
+  size = std::max(size, dataSize);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, dataSize, data);
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+void UniformBuffer::bindRange(size_t offset, size_t rangeSize) const {
+  glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, rangeSize);
+}
+
+size_t UniformBuffer::getOffsetAlignment(void) {
+  static GLint alignment = 0;
+  if (alignment == 0) {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  }
+  return static_cast<size_t>(alignment);
+}
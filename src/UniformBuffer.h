@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <glad/glad.h>
+
+/* A uniform buffer attached to a fixed binding point, which shaders pick up
+ * through the uniform block bound to the same point. */
+class UniformBuffer {
+public:
+  static std::unique_ptr<UniformBuffer> create(GLuint binding, size_t size);
+
+  UniformBuffer(const UniformBuffer&) = delete;
+  UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+  ~UniformBuffer(void);
+
+  /* Replaces the contents, growing the buffer if needed. The old storage is
+   * orphaned, so draws still reading it don't stall the upload. Leaves the
+   * whole buffer bound. */
+  void update(const void* data, size_t size);
+
+  /* Binds `size` bytes from `offset`, which must be a multiple of
+   * `getOffsetAlignment`, so that one buffer can hold the blocks of many
+   * draws. */
+  void bindRange(size_t offset, size_t size) const;
+
+  /* The implementation's `GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT`. */
+  static size_t getOffsetAlignment(void);
+
+private:
+  UniformBuffer(GLuint binding, GLuint buffer, size_t size);
+
+  GLuint binding;
+  GLuint buffer;
+  size_t size;
+};
@@ -0,0 +1,126 @@
+#include "UniformTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+bool isSampler(GLenum type) {
+  switch (type) {
+  case GL_SAMPLER_1D:
+  case GL_SAMPLER_2D:
+  case GL_SAMPLER_3D:
+  case GL_SAMPLER_CUBE:
+  case GL_SAMPLER_1D_SHADOW:
+  case GL_SAMPLER_2D_SHADOW:
+  case GL_SAMPLER_1D_ARRAY:
+  case GL_SAMPLER_2D_ARRAY:
+  case GL_SAMPLER_1D_ARRAY_SHADOW:
+  case GL_SAMPLER_2D_ARRAY_SHADOW:
+  case GL_SAMPLER_CUBE_SHADOW:
+  case GL_SAMPLER_2D_RECT:
+  case GL_SAMPLER_2D_RECT_SHADOW:
+  case GL_SAMPLER_BUFFER:
+  case GL_SAMPLER_2D_MULTISAMPLE:
+  case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+  case GL_INT_SAMPLER_2D:
+  case GL_INT_SAMPLER_3D:
+  case GL_INT_SAMPLER_CUBE:
+  case GL_INT_SAMPLER_2D_ARRAY:
+  case GL_INT_SAMPLER_BUFFER:
+  case GL_UNSIGNED_INT_SAMPLER_2D:
+  case GL_UNSIGNED_INT_SAMPLER_3D:
+  case GL_UNSIGNED_INT_SAMPLER_CUBE:
+  case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+  case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isCompatible(GLenum actual, GLenum expected) {
+  if (actual == expected) {
+    return true;
+  }
+  return expected == GL_INT && (actual == GL_BOOL || isSampler(actual));
+}
+
+} // namespace
+
+void UniformTable::add(const std::string& name, GLint location, GLenum type) {
+  /* Keep the load at most one half, so probes stay short. */
+  if (2 * (count + 1) > entries.size()) {
+    grow();
+  }
+
+  uint64_t hash = fnv1a64(name);
+  size_t mask = entries.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    Entry& entry = entries[slot];
+    if (entry.type == 0) {
+      entry = { hash, location, type, 0, false };
+      names[slot] = name;
+      ++count;
+      return;
+    }
+    if (entry.hash == hash) {
+      return;
+    }
+  }
+}
+
+void UniformTable::clear(void) {
+  entries.clear();
+  names.clear();
+  count = 0;
+}
+
+bool UniformTable::shadow(UniformHandle<GLint> handle, GLint value) {
+  if (!handle.isValid()) {
+    return false;
+  }
+  Entry& entry = entries[handle.slot];
+  if (entry.hasValue && entry.value == value) {
+    return false;
+  }
+  entry.value = value;
+  entry.hasValue = true;
+  return true;
+}
+
+uint32_t UniformTable::findSlot(UniformName name, GLenum type) const {
+  if (entries.empty()) {
+    return UniformHandle<GLint>::NO_SLOT;
+  }
+
+  size_t mask = entries.size() - 1;
+  for (size_t slot = name.hash & mask;; slot = (slot + 1) & mask) {
+    const Entry& entry = entries[slot];
+    if (entry.type == 0) {
+      return UniformHandle<GLint>::NO_SLOT;
+    }
+    if (entry.hash == name.hash) {
+      if (!isCompatible(entry.type, type)) {
+        std::cerr << "Uniform '" << names[slot] << "' has type 0x" << std::hex << entry.type
+                  << ", not 0x" << type << std::dec << std::endl;
+        return UniformHandle<GLint>::NO_SLOT;
+      }
+      return static_cast<uint32_t>(slot);
+    }
+  }
+}
+
+void UniformTable::grow(void) {
+  std::vector<Entry> previousEntries = std::move(entries);
+  std::vector<std::string> previousNames = std::move(names);
+  entries.assign(std::max<size_t>(2 * previousEntries.size(), 16), Entry{ 0, -1, 0, 0, false });
+  names.assign(entries.size(), std::string());
+  count = 0;
+  for (size_t i = 0; i < previousEntries.size(); ++i) {
+    if (previousEntries[i].type != 0) {
+      add(previousNames[i], previousEntries[i].location, previousEntries[i].type);
+    }
+  }
+}
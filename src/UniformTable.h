@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+
+/* A uniform name, reduced to its hash. Declared `constexpr`, a literal is
+ * hashed at compile time; a name built at run time should be hashed once,
+ * when it is built, and the `UniformName` kept. */
+struct UniformName {
+  uint64_t hash;
+
+  constexpr UniformName(const char* name) : hash(fnv1a64(name)) {}
+
+  explicit UniformName(const std::string& name) : hash(fnv1a64(name)) {}
+};
+
+/* The GL type a uniform must have to be set from a `T`. Integers also set
+ * booleans and samplers. */
+template <typename T>
+struct UniformType;
+
+template <>
+struct UniformType<GLint> {
+  static constexpr GLenum TYPE = GL_INT;
+};
+
+template <>
+struct UniformType<GLfloat> {
+  static constexpr GLenum TYPE = GL_FLOAT;
+};
+
+template <>
+struct UniformType<glm::vec3> {
+  static constexpr GLenum TYPE = GL_FLOAT_VEC3;
+};
+
+template <>
+struct UniformType<glm::mat3> {
+  static constexpr GLenum TYPE = GL_FLOAT_MAT3;
+};
+
+template <>
+struct UniformType<glm::mat4> {
+  static constexpr GLenum TYPE = GL_FLOAT_MAT4;
+};
+
+/* A uniform of one program, checked to hold a `T`. Only valid with the
+ * program it came from. A default-constructed handle refers to nothing, and
+ * setting it does nothing. */
+template <typename T>
+class UniformHandle {
+  friend class UniformTable;
+
+public:
+  static constexpr uint32_t NO_SLOT = ~0u;
+
+  UniformHandle(void) = default;
+
+  bool isValid(void) const {
+    return slot != NO_SLOT;
+  }
+
+private:
+  explicit UniformHandle(uint32_t slot) : slot(slot) {}
+
+  uint32_t slot = NO_SLOT;
+};
+
+/* The active uniforms of a program, as an open-addressed table keyed by the
+ * hash of their names. Finding a uniform is a probe into a flat array with a
+ * hash computed ahead of time, and a handle indexes the array directly. */
+class UniformTable {
+public:
+  /* Later additions of the same name are ignored. */
+  void add(const std::string& name, GLint location, GLenum type);
+
+  void clear(void);
+
+  size_t size(void) const {
+    return count;
+  }
+
+  /* An invalid handle if the program has no such uniform, or reports the
+   * mismatch and returns an invalid handle if it has one of another type. */
+  template <typename T>
+  UniformHandle<T> find(UniformName name) const {
+    return UniformHandle<T>(findSlot(name, UniformType<T>::TYPE));
+  }
+
+  template <typename T>
+  GLint getLocation(UniformHandle<T> handle) const {
+    return handle.isValid() ? entries[handle.slot].location : -1;
+  }
+
+  /* Records `value` as the uniform's current value, and returns whether it
+   * differs from the previous one. */
+  bool shadow(UniformHandle<GLint> handle, GLint value);
+
+private:
+  struct Entry {
+    uint64_t hash;
+    GLint location;
+    /* 0 for an empty slot. */
+    GLenum type;
+    GLint value;
+    bool hasValue;
+  };
+
+  uint32_t findSlot(UniformName name, GLenum type) const;
+  void grow(void);
+
+  std::vector<Entry> entries;
+  /* Per slot, for diagnostics only. */
+  std::vector<std::string> names;
+  size_t count = 0;
+};
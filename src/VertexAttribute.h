@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <boost/pfr.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+/* Compact vertex field types. Declaring a vertex struct with these instead of
+ * `glm::vec*` trades precision for bandwidth; the shader still sees floats,
+ * since OpenGL converts them when fetching. */
+
+/* IEEE half-precision floats. */
+struct Half2 {
+  uint16_t x, y;
+};
+
+struct Half4 {
+  uint16_t x, y, z, w;
+};
+
+/* Integers mapped to [-1, 1] (signed) or [0, 1] (unsigned) on fetch, e.g.
+ * `Normalized<glm::i8vec4>` or `Normalized<glm::u16vec2>`. */
+template <typename T>
+struct Normalized {
+  T value;
+};
+
+/* Three signed 10-bit components and a 2-bit one in a single word, normalized
+ * to [-1, 1]. Good enough for unit normals and tangents. */
+struct PackedSnorm3x10_1x2 {
+  uint32_t value;
+};
+
+inline Half2 toHalf2(const glm::vec2& v) {
+  return { glm::packHalf1x16(v.x), glm::packHalf1x16(v.y) };
+}
+
+inline Half4 toHalf4(const glm::vec4& v) {
+  return { glm::packHalf1x16(v.x), glm::packHalf1x16(v.y), glm::packHalf1x16(v.z), glm::packHalf1x16(v.w) };
+}
+
+inline PackedSnorm3x10_1x2 toPackedSnorm3x10_1x2(const glm::vec4& v) {
+  return { glm::packSnorm3x10_1x2(v) };
+}
+
+inline glm::vec2 toVec2(const Half2& h) {
+  return glm::vec2(glm::unpackHalf1x16(h.x), glm::unpackHalf1x16(h.y));
+}
+
+inline glm::vec4 toVec4(const Half4& h) {
+  return glm::vec4(glm::unpackHalf1x16(h.x), glm::unpackHalf1x16(h.y), glm::unpackHalf1x16(h.z), glm::unpackHalf1x16(h.w));
+}
+
+/* How `Mesh` describes a vertex field to `glVertexAttribPointer`. Matrices
+ * take up one attribute location per column. */
+template <typename T>
+struct VertexAttributeTraits {
+  static_assert(sizeof(T) == 0, "Unsupported vertex attribute type");
+};
+
+template <GLint Size, GLenum Type, GLboolean Normalized, GLuint Locations = 1>
+struct VertexAttributeFormat {
+  static constexpr GLint size = Size;
+  static constexpr GLenum type = Type;
+  static constexpr GLboolean normalized = Normalized;
+  static constexpr GLuint locations = Locations;
+};
+
+template <> struct VertexAttributeTraits<float> : VertexAttributeFormat<1, GL_FLOAT, GL_FALSE> {};
+template <> struct VertexAttributeTraits<glm::vec2> : VertexAttributeFormat<2, GL_FLOAT, GL_FALSE> {};
+template <> struct VertexAttributeTraits<glm::vec3> : VertexAttributeFormat<3, GL_FLOAT, GL_FALSE> {};
+template <> struct VertexAttributeTraits<glm::vec4> : VertexAttributeFormat<4, GL_FLOAT, GL_FALSE> {};
+template <> struct VertexAttributeTraits<glm::mat3> : VertexAttributeFormat<3, GL_FLOAT, GL_FALSE, 3> {};
+template <> struct VertexAttributeTraits<glm::mat4> : VertexAttributeFormat<4, GL_FLOAT, GL_FALSE, 4> {};
+
+template <> struct VertexAttributeTraits<Half2> : VertexAttributeFormat<2, GL_HALF_FLOAT, GL_FALSE> {};
+template <> struct VertexAttributeTraits<Half4> : VertexAttributeFormat<4, GL_HALF_FLOAT, GL_FALSE> {};
+
+template <> struct VertexAttributeTraits<PackedSnorm3x10_1x2> : VertexAttributeFormat<4, GL_INT_2_10_10_10_REV, GL_TRUE> {};
+
+template <typename T>
+struct NormalizedComponentType {
+  static_assert(sizeof(T) == 0, "Normalized attributes must have 8- or 16-bit integer components");
+};
+
+template <> struct NormalizedComponentType<int8_t> { static constexpr GLenum type = GL_BYTE; };
+template <> struct NormalizedComponentType<uint8_t> { static constexpr GLenum type = GL_UNSIGNED_BYTE; };
+template <> struct NormalizedComponentType<int16_t> { static constexpr GLenum type = GL_SHORT; };
+template <> struct NormalizedComponentType<uint16_t> { static constexpr GLenum type = GL_UNSIGNED_SHORT; };
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct VertexAttributeTraits<Normalized<glm::vec<L, T, Q>>>
+  : VertexAttributeFormat<L, NormalizedComponentType<T>::type, GL_TRUE> {};
+
+/* Describes every field of `VertexType`, in declaration order, as consecutive
+ * vertex attributes of the buffer bound to `GL_ARRAY_BUFFER`, starting at
+ * location `firstLocation`. A non-zero `divisor` makes them advance per
+ * instance rather than per vertex. Returns the first location left unused. */
+template <typename VertexType>
+GLuint setupVertexAttributes(GLuint firstLocation = 0, GLuint divisor = 0) {
+  constexpr size_t stride = sizeof(VertexType);
+  const VertexType vertex{};
+  GLuint location = firstLocation;
+
+  boost::pfr::for_each_field(vertex, [&](const auto& field, auto) {
+    using T = std::decay_t<decltype(field)>;
+    using Traits = VertexAttributeTraits<T>;
+
+    /* Take the offset from the field's address rather than summing sizes, so
+     * any padding the compiler inserted is accounted for. */
+    size_t offset = reinterpret_cast<const char*>(&field) - reinterpret_cast<const char*>(&vertex);
+
+    for (GLuint column = 0; column < Traits::locations; ++column) {
+      /* We can tell OpenGL how it should interpret the vertex data (per
+       * vertex attribute) using `glVertexAttribPointer`. */
+      glVertexAttribPointer(location, Traits::size, Traits::type, Traits::normalized, stride,
+                            (void*)(offset + column * (sizeof(T) / Traits::locations)));
+
+      /* Enable the vertex attribute with `glEnableVertexAttribArray` as
+       * vertex attributes are disabled by default. */
+      glEnableVertexAttribArray(location);
+
+      glVertexAttribDivisor(location, divisor);
+      ++location;
+    }
+  });
+
+  return location;
+}
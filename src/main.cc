@@ -1,19 +1,40 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <random>
 
 #include <assimp/version.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h>
 
 #include "Camera.h"
+#include "CameraPath.h"
+#include "CascadedShadowMap.h"
+#include "FrameBenchmark.h"
+#include "Frustum.h"
+#include "FrustumCuller.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "HeadlessContext.h"
+#include "LightGrid.h"
 #include "Mesh.h"
 #include "Model.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
 #include "ShaderProgram.h"
+#include "ShaderVariants.h"
 #include "TextureLoader.h"
+#include "TransparentInstances.h"
+#include "UniformBlocks.h"
+#include "UniformBuffer.h"
 
 float lastFrame = 0.0f;
 float deltaTime = 0.0f; /* Time between current frame and last frame. */
@@ -77,6 +98,25 @@ void printSystemInfo(void) {
   std::cout << "Assimp version: " << aiGetVersionMajor() << "." << aiGetVersionMinor() << std::endl;
 }
 
+/* Shows how many state-changing GL calls the last frame issued and how many
+ * were dropped as redundant, and how many objects passed frustum culling.
+ * Updated twice a second to stay readable. */
+void updateWindowTitle(GLFWwindow* window, float currentTime) {
+  static float lastUpdate = 0.0f;
+  if (currentTime - lastUpdate < 0.5f) {
+    return;
+  }
+  lastUpdate = currentTime;
+
+  const GLState::Statistics& statistics = GLState::getFrameStatistics();
+  const FrustumCuller::Statistics& culling = FrustumCuller::getFrameStatistics();
+  std::string title = "Learn OpenGL - GL state calls: " + std::to_string(statistics.issued) + " issued, "
+                    + std::to_string(statistics.skipped) + " skipped - objects: "
+                    + std::to_string(culling.visible) + " visible, " + std::to_string(culling.culled) + " culled - triangles: "
+                    + std::to_string(statistics.triangles);
+  glfwSetWindowTitle(window, title.c_str());
+}
+
 void processInput(GLFWwindow* window) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
     glfwSetWindowShouldClose(window, GLFW_TRUE);
@@ -97,49 +137,128 @@ void processInput(GLFWwindow* window) {
   }
 }
 
-GLuint loadCubemap(const std::string& directory) {
-  const static std::vector<std::pair<GLenum, std::string>> faces = {
-    { GL_TEXTURE_CUBE_MAP_POSITIVE_X,  "right.jpg" },
-    { GL_TEXTURE_CUBE_MAP_NEGATIVE_X,   "left.jpg" },
-    { GL_TEXTURE_CUBE_MAP_POSITIVE_Y,    "top.jpg" },
-    { GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, "bottom.jpg" },
-    { GL_TEXTURE_CUBE_MAP_POSITIVE_Z,  "front.jpg" },
-    { GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,   "back.jpg" },
-  };
-
-  GLuint textureID;
-  glGenTextures(1, &textureID);
-
-  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-  stbi_set_flip_vertically_on_load(false);
+/* Set from the command line; see `printUsage`. */
+struct Options {
+  bool headless = false;
+  int width = 800;
+  int height = 600;
+  int frames = 600;
+  int warmupFrames = 30;
+  std::string outputPath = "frame_benchmark.json";
+  /* Empty unless profiling. */
+  std::string profilePath;
+  /* In MiB; 0 keeps the loader's default. */
+  int textureBudget = 0;
+  /* A define of `screenShader.fs`, or empty to draw straight to the
+   * screen. */
+  std::string postEffect;
+  /* Moving point lights over the grass, shaded with clustered lighting. */
+  int lights = 0;
+  /* Width and height of each shadow cascade; 0 for no shadows. */
+  int shadowMapSize = 0;
+  /* Transparent windows over the grass, and whether they are blended in
+   * order or with weighted blended transparency, which needs no sorting. */
+  int windows = 0;
+  bool weightedTransparency = false;
+};
+
+void printUsage(const char* program) {
+  std::cerr << "Usage: " << program << " [--headless] [--size WIDTHxHEIGHT] [--frames N] [--warmup N] [--output FILE] [--profile FILE] [--texture-budget MB] [--post-effect NAME] [--lights N] [--shadows SIZE] [--windows N] [--transparency MODE]\n"
+            << "  --headless        render offscreen along a fixed camera path and print frame statistics as JSON\n"
+            << "  --size            resolution of the window or offscreen framebuffer (default 800x600)\n"
+            << "  --frames          measured frames in headless mode (default 600)\n"
+            << "  --warmup          unmeasured frames before them (default 30)\n"
+            << "  --output          where to write the JSON (default frame_benchmark.json)\n"
+            << "  --profile         record CPU and GPU timings and write them to FILE as a Chrome trace on exit\n"
+            << "  --texture-budget  GPU memory for all textures, in MiB; only ones no longer in use are evicted to stay within it\n"
+            << "  --post-effect     render offscreen and apply inversion, grayscale or kernel on the way to the screen\n"
+            << "  --lights          light the scene with N moving point lights, up to 65536\n"
+            << "  --shadows         light the scene with a sun casting shadows into cascades of SIZExSIZE texels\n"
+            << "  --windows         scatter N transparent windows over the grass\n"
+            << "  --transparency    blend the windows sorted back to front every frame, or weighted, in any order (default sorted)" << std::endl;
+}
 
-  int width, height, nrChannels;
-  stbi_uc* image;
-  for (const auto& pair : faces) {
-    std::string path = directory + "/" + pair.second;
-    image = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (image != NULL) {
-      glTexImage2D(pair.first, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-      stbi_image_free(image);
+bool parseOptions(int argc, char* argv[], Options& outOptions) {
+  for (int i = 1; i < argc; ++i) {
+    const char* argument = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (std::strcmp(argument, "--headless") == 0) {
+      outOptions.headless = true;
+      continue;
+    }
+    if (value == nullptr) {
+      return false;
+    }
+    ++i;
+    if (std::strcmp(argument, "--size") == 0) {
+      char* end;
+      outOptions.width = static_cast<int>(std::strtol(value, &end, 10));
+      if (*end != 'x') {
+        return false;
+      }
+      outOptions.height = static_cast<int>(std::strtol(end + 1, &end, 10));
+      if (*end != '\0' || outOptions.width <= 0 || outOptions.height <= 0) {
+        return false;
+      }
+    } else if (std::strcmp(argument, "--frames") == 0) {
+      outOptions.frames = std::atoi(value);
+    } else if (std::strcmp(argument, "--warmup") == 0) {
+      outOptions.warmupFrames = std::atoi(value);
+    } else if (std::strcmp(argument, "--output") == 0) {
+      outOptions.outputPath = value;
+    } else if (std::strcmp(argument, "--profile") == 0) {
+      outOptions.profilePath = value;
+    } else if (std::strcmp(argument, "--texture-budget") == 0) {
+      outOptions.textureBudget = std::atoi(value);
+    } else if (std::strcmp(argument, "--lights") == 0) {
+      outOptions.lights = std::atoi(value);
+    } else if (std::strcmp(argument, "--shadows") == 0) {
+      outOptions.shadowMapSize = std::atoi(value);
+    } else if (std::strcmp(argument, "--windows") == 0) {
+      outOptions.windows = std::atoi(value);
+    } else if (std::strcmp(argument, "--transparency") == 0) {
+      if (std::strcmp(value, "weighted") == 0) {
+        outOptions.weightedTransparency = true;
+      } else if (std::strcmp(value, "sorted") != 0) {
+        return false;
+      }
+    } else if (std::strcmp(argument, "--post-effect") == 0) {
+      if (std::strcmp(value, "inversion") == 0) {
+        outOptions.postEffect = "INVERSION";
+      } else if (std::strcmp(value, "grayscale") == 0) {
+        outOptions.postEffect = "GRAYSCALE";
+      } else if (std::strcmp(value, "kernel") == 0) {
+        outOptions.postEffect = "KERNEL";
+      } else if (std::strcmp(value, "none") != 0) {
+        return false;
+      }
     } else {
-      std::cerr << "Cubemap texture failed to load at path: " << path << std::endl;
+      return false;
     }
   }
+  return outOptions.frames > 0 && outOptions.warmupFrames >= 0 && outOptions.textureBudget >= 0 && outOptions.lights >= 0
+         && static_cast<size_t>(outOptions.lights) <= LightGrid::MAX_LIGHTS && outOptions.shadowMapSize >= 0
+         && outOptions.windows >= 0;
+}
 
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-  return textureID;
+/* Writes the trace asked for with `--profile`, if any. The context must
+ * still be current. */
+void writeProfile(const Options& options) {
+  if (options.profilePath.empty()) {
+    return;
+  }
+  Profiler::finish();
+  if (Profiler::writeChromeTrace(options.profilePath)) {
+    std::cout << "Wrote profile to " << options.profilePath << std::endl;
+  }
 }
 
-int main(void) {
+/* Creates the window, makes its context current and loads GL. Null on
+ * failure, with GLFW already terminated. */
+GLFWwindow* createWindow(void) {
   if (!glfwInit()) {
     std::cerr << "Failed to initialize GLFW" << std::endl;
-    return -1;
+    return nullptr;
   }
 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -153,7 +272,7 @@ int main(void) {
   if (window == NULL) {
     std::cerr << "Failed to create GLFW window" << std::endl;
     glfwTerminate();
-    return -1;
+    return nullptr;
   }
 
   /* Tell GLFW to make the context of our window the main context on the
@@ -176,29 +295,121 @@ int main(void) {
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     std::cerr << "Failed to initialize GLAD" << std::endl;
     glfwTerminate();
+    return nullptr;
+  }
+
+  GLExtensions::load((GLADloadproc)glfwGetProcAddress);
+  return window;
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
     return -1;
   }
+  windowWidth = options.width;
+  windowHeight = options.height;
+  Profiler::setThreadName("Main");
+  Profiler::setEnabled(!options.profilePath.empty());
+
+  /* Headless runs draw into the context's offscreen framebuffer instead of
+   * a window. GLFW calls made without it initialised are harmless. */
+  GLFWwindow* window = nullptr;
+  std::unique_ptr<HeadlessContext> headlessContext;
+  if (options.headless) {
+    headlessContext = HeadlessContext::create(options.width, options.height);
+    if (!headlessContext) {
+      return -1;
+    }
+    GLExtensions::load(reinterpret_cast<GLADloadproc>(HeadlessContext::getProcAddress));
+  } else {
+    window = createWindow();
+    if (window == nullptr) {
+      return -1;
+    }
+  }
 
   printSystemInfo();
 
-  glEnable(GL_DEPTH_TEST);
+  GLState::setDepthTest(true);
+  if (options.textureBudget > 0) {
+    TextureLoader::setBudget(static_cast<size_t>(options.textureBudget) << 20);
+  }
 
+  std::vector<std::string> litDefines;
+  if (options.lights > 0) {
+    litDefines.push_back("CLUSTERED_LIGHTING");
+  }
+  if (options.shadowMapSize > 0) {
+    litDefines.push_back("SHADOWS");
+  }
   std::unique_ptr<ShaderProgram> shaderProgram = ShaderProgram::create(
-    "assets/shaders/defaultShader.vs", "assets/shaders/defaultShader.fs");
+    "assets/shaders/defaultShader.vs", "assets/shaders/defaultShader.fs", litDefines);
   std::unique_ptr<ShaderProgram> skyboxShaderProgram = ShaderProgram::create(
     "assets/shaders/skyboxShader.vs", "assets/shaders/skyboxShader.fs");
-  if (!shaderProgram || !skyboxShaderProgram) {
+  std::unique_ptr<ShaderProgram> grassShaderProgram = ShaderProgram::create(
+    "assets/shaders/grassInstancedShader.vs", "assets/shaders/grassShader.fs", litDefines);
+  if (!shaderProgram || !skyboxShaderProgram || !grassShaderProgram) {
+    glfwTerminate();
+    return -1;
+  }
+
+  ShaderVariants screenShaders("assets/shaders/screenShader.vs", "assets/shaders/screenShader.fs");
+  const ShaderProgram* postEffectProgram = nullptr;
+  if (!options.postEffect.empty()) {
+    postEffectProgram = screenShaders.get({ options.postEffect });
+    if (!postEffectProgram) {
+      glfwTerminate();
+      return -1;
+    }
+    postEffectProgram->use();
+    postEffectProgram->uniform<glm::mat3>("transform", glm::mat3(1.0f));
+  }
+
+  /* Windows are blended back to front, or with weighted blended
+   * transparency, whose sums are composited over the scene afterwards. */
+  bool weightedWindows = options.windows > 0 && options.weightedTransparency;
+  ShaderVariants blendingShaders("assets/shaders/blendingShader.vs", "assets/shaders/blendingShader.fs");
+  const ShaderProgram* windowProgram = nullptr;
+  std::unique_ptr<ShaderProgram> compositeProgram;
+  TextureHandle windowTexture;
+  if (options.windows > 0) {
+    if (weightedWindows) {
+      windowProgram = blendingShaders.get({ "INSTANCED", "WEIGHTED_BLENDED" });
+      compositeProgram = ShaderProgram::create("assets/shaders/screenShader.vs",
+                                               "assets/shaders/transparencyComposite.fs");
+    } else {
+      windowProgram = blendingShaders.get({ "INSTANCED" });
+    }
+    windowTexture = TextureLoader::load("assets/textures/blending_transparent_window.png");
+    if (!windowProgram || (weightedWindows && !compositeProgram) || !windowTexture.isValid()) {
+      glfwTerminate();
+      return -1;
+    }
+    if (compositeProgram) {
+      compositeProgram->use();
+      compositeProgram->uniform<glm::mat3>("transform", glm::mat3(1.0f));
+    }
+  }
+
+  TextureHandle cubeTexture = TextureLoader::load("assets/textures/container.jpg");
+  if (!cubeTexture.isValid()) {
     glfwTerminate();
     return -1;
   }
 
-  GLuint cubeTextureID = TextureLoader::load("assets/textures/container.jpg");
-  if (cubeTextureID == 0) {
+  TextureHandle grassTexture = TextureLoader::load("assets/textures/grass.png");
+  if (!grassTexture.isValid()) {
     glfwTerminate();
     return -1;
   }
 
-  GLuint cubemapTextureID = loadCubemap("assets/textures/skybox");
+  TextureHandle skyboxTexture = TextureLoader::loadCubemap("assets/textures/skybox");
+  if (!skyboxTexture.isValid()) {
+    glfwTerminate();
+    return -1;
+  }
 
   struct SkyboxVertex {
     glm::vec3 position;
@@ -247,7 +458,7 @@ int main(void) {
     { { -1.0f, -1.0f,  1.0f } },
     { {  1.0f, -1.0f,  1.0f } },
   }, {
-    { cubemapTextureID, "skybox" }
+    { std::move(skyboxTexture), "skybox" }
   });
 
   struct Vertex {
@@ -298,45 +509,386 @@ int main(void) {
     { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f} },
     { { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f} },
   }, {
-    { cubeTextureID, "texture0" }
+    { cubeTexture, "texture0" }
   });
 
-  while (!glfwWindowShouldClose(window)) {
-    float currentFrame = static_cast<float>(glfwGetTime());
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+  /* A unit grass blade standing on its base. */
+  Mesh grass(std::vector<Vertex>{
+    { { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
+    { {  0.5f, 0.0f, 0.0f }, { 1.0f, 0.0f } },
+    { {  0.5f, 1.0f, 0.0f }, { 1.0f, 1.0f } },
+    { {  0.5f, 1.0f, 0.0f }, { 1.0f, 1.0f } },
+    { { -0.5f, 1.0f, 0.0f }, { 0.0f, 1.0f } },
+    { { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
+  }, {
+    { grassTexture, "material.diffuse0" }
+  });
 
-    processInput(window);
+  /* Scatter a field of grass blades below the cube. They are all drawn with
+   * a single instanced call. */
+  constexpr int GRASS_BLADE_COUNT = 100000;
+  constexpr float GRASS_FIELD_SIZE = 100.0f;
+  {
+    std::vector<InstanceTRS> blades(GRASS_BLADE_COUNT);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-0.5f * GRASS_FIELD_SIZE, 0.5f * GRASS_FIELD_SIZE);
+    std::uniform_real_distribution<float> scale(0.2f, 0.5f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::pi<float>());
+    for (auto& blade : blades) {
+      float halfAngle = 0.5f * angle(random);
+      blade.translationScale = glm::vec4(position(random), -0.5f, position(random), scale(random));
+      blade.rotation = glm::vec4(0.0f, std::sin(halfAngle), 0.0f, std::cos(halfAngle));
+    }
+    grass.setInstances(blades);
+  }
+
+  /* A unit window standing on its base. */
+  Mesh windowMesh(std::vector<Vertex>{
+    { { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
+    { {  0.5f, 0.0f, 0.0f }, { 1.0f, 0.0f } },
+    { {  0.5f, 1.0f, 0.0f }, { 1.0f, 1.0f } },
+    { {  0.5f, 1.0f, 0.0f }, { 1.0f, 1.0f } },
+    { { -0.5f, 1.0f, 0.0f }, { 0.0f, 1.0f } },
+    { { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
+  }, {
+    { windowTexture, "texture0" }
+  });
+
+  /* Scatter the windows among the grass. Blended back to front, they are
+   * sorted again every frame, starting from the last frame's order. */
+  constexpr float WINDOW_MAX_SCALE = 1.5f;
+  TransparentInstances transparentWindows;
+  if (options.windows > 0) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-0.5f * GRASS_FIELD_SIZE, 0.5f * GRASS_FIELD_SIZE);
+    std::uniform_real_distribution<float> scale(0.5f, WINDOW_MAX_SCALE);
+    std::uniform_real_distribution<float> angle(0.0f, glm::pi<float>());
+    for (int i = 0; i < options.windows; ++i) {
+      float halfAngle = 0.5f * angle(random);
+      transparentWindows.add({ glm::vec4(position(random), -0.5f, position(random), scale(random)),
+                               glm::vec4(0.0f, std::sin(halfAngle), 0.0f, std::cos(halfAngle)) });
+    }
+    windowMesh.setInstances(transparentWindows.getInstances());
+  }
+
+  struct ScreenVertex {
+    glm::vec2 position;
+    glm::vec2 texCoord;
+  };
+
+  Mesh screenQuad(std::vector<ScreenVertex>{
+    { { -1.0f,  1.0f }, { 0.0f, 1.0f } },
+    { { -1.0f, -1.0f }, { 0.0f, 0.0f } },
+    { {  1.0f, -1.0f }, { 1.0f, 0.0f } },
+    { { -1.0f,  1.0f }, { 0.0f, 1.0f } },
+    { {  1.0f, -1.0f }, { 1.0f, 0.0f } },
+    { {  1.0f,  1.0f }, { 1.0f, 1.0f } },
+  });
+  /* Points at the scene's color attachment, which the render graph picks. */
+  std::vector<Texture> screenTextures = { { 0, "screenTexture" } };
+
+  /* Lights circling above the grass, each at its own speed. */
+  struct LightOrbit {
+    glm::vec3 center;
+    float radius;
+    float speed;
+    float phase;
+  };
+  std::vector<PointLight> lights(options.lights);
+  std::vector<LightOrbit> lightOrbits(options.lights);
+  {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-0.5f * GRASS_FIELD_SIZE, 0.5f * GRASS_FIELD_SIZE);
+    std::uniform_real_distribution<float> height(-0.3f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < options.lights; ++i) {
+      lightOrbits[i] = { glm::vec3(position(random), height(random), position(random)), 0.5f + 2.0f * unit(random),
+                         0.2f + unit(random), glm::two_pi<float>() * unit(random) };
+      lights[i].radius = 1.5f + 2.5f * unit(random);
+      lights[i].color = glm::vec3(unit(random), unit(random), unit(random));
+      lights[i].intensity = 4.0f;
+    }
+  }
+  std::unique_ptr<LightGrid> lightGrid = options.lights > 0 ? std::make_unique<LightGrid>() : nullptr;
+
+  glm::mat4 cubeModelMatrix(1.0f);
+  RenderQueue renderQueue;
+  /* Weighted windows, which go into their own attachments after the
+   * scene. */
+  RenderQueue transparentQueue;
+
+  BoundingBox cubeBounds = transform(cube.getBounds().box, cubeModelMatrix);
+  BoundingBox grassBounds = { glm::vec3(-0.5f * GRASS_FIELD_SIZE - 0.5f, -0.5f, -0.5f * GRASS_FIELD_SIZE - 0.5f),
+                              glm::vec3(0.5f * GRASS_FIELD_SIZE + 0.5f, 0.0f, 0.5f * GRASS_FIELD_SIZE + 0.5f) };
+  float windowReach = 0.5f * GRASS_FIELD_SIZE + 0.5f * WINDOW_MAX_SCALE;
+  BoundingBox windowBounds = { glm::vec3(-windowReach, -0.5f, -windowReach),
+                               glm::vec3(windowReach, WINDOW_MAX_SCALE - 0.5f, windowReach) };
+
+  /* A sun casting the shadows of the cube and the grass, which never move,
+   * so cascades are only drawn again when the camera leaves them. */
+  ShaderVariants shadowShaders("assets/shaders/shadowDepth.vs", "assets/shaders/shadowDepth.fs");
+  std::unique_ptr<CascadedShadowMap> shadowMap;
+  if (options.shadowMapSize > 0) {
+    const ShaderProgram* shadowProgram = shadowShaders.get({});
+    const ShaderProgram* grassShadowProgram = shadowShaders.get({ "INSTANCED", "ALPHA_TEST" });
+    shadowMap = CascadedShadowMap::create(options.shadowMapSize);
+    if (!shadowProgram || !grassShadowProgram || !shadowMap) {
+      glfwTerminate();
+      return -1;
+    }
+    shadowMap->setLightDirection(glm::vec3(-0.4f, -1.0f, -0.3f));
+    shadowMap->setLightColor(glm::vec3(1.0f, 0.95f, 0.85f));
+    shadowMap->addCaster(cubeBounds, { RenderLayer::SOLID, shadowProgram, 0, 0.0f, &cubeModelMatrix,
+                                       [](const void* object, const ShaderProgram& program) {
+                                         static_cast<const Mesh*>(object)->draw(program);
+                                       },
+                                       &cube }, false);
+    shadowMap->addCaster(grassBounds, { RenderLayer::SOLID, grassShadowProgram, grassTexture.getID(), 0.0f, nullptr,
+                                        [](const void* object, const ShaderProgram& program) {
+                                          static_cast<const Mesh*>(object)->drawInstanced(program);
+                                        },
+                                        &grass }, false);
+  }
 
+  /* The scene is drawn straight into the output, or into offscreen
+   * attachments first when weighted windows are composited over it or a
+   * post effect reads it. */
+  RenderGraph renderGraph;
+  RenderGraph::Pass scenePass = renderGraph.addPass("Scene", [&](void) {
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderQueue.submit();
+  });
+  /* Sampler names of the composite, pointing at attachments the render
+   * graph picks. */
+  std::vector<Texture> compositeTextures = {
+    { 0, "sceneTexture" }, { 0, "accumulationTexture" }, { 0, "revealageTexture" }
+  };
+  if (postEffectProgram || weightedWindows) {
+    RenderGraph::Resource sceneColor = renderGraph.createTexture("Scene color", GL_RGBA8);
+    RenderGraph::Resource sceneDepth = renderGraph.createRenderbuffer("Scene depth", GL_DEPTH24_STENCIL8);
+    renderGraph.write(scenePass, sceneColor, GL_COLOR_ATTACHMENT0);
+    renderGraph.write(scenePass, sceneDepth, GL_DEPTH_STENCIL_ATTACHMENT);
+    RenderGraph::Resource color = sceneColor;
+
+    if (weightedWindows) {
+      /* The windows are tested against the scene's depth, without writing
+       * it. */
+      RenderGraph::Resource accumulation = renderGraph.createTexture("Transparency accumulation", GL_RGBA16F);
+      RenderGraph::Resource revealage = renderGraph.createTexture("Transparency revealage", GL_R16F);
+      RenderGraph::Pass accumulatePass = renderGraph.addPass("Transparency accumulation", [&](void) {
+        static const GLfloat ZERO[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, ZERO);
+        glClearBufferfv(GL_COLOR, 1, ZERO);
+        transparentQueue.submit();
+      });
+      renderGraph.write(accumulatePass, accumulation, GL_COLOR_ATTACHMENT0);
+      renderGraph.write(accumulatePass, revealage, GL_COLOR_ATTACHMENT1);
+      renderGraph.write(accumulatePass, sceneDepth, GL_DEPTH_STENCIL_ATTACHMENT);
+
+      RenderGraph::Resource composited = postEffectProgram
+        ? renderGraph.createTexture("Composited color", GL_RGBA8) : RenderGraph::OUTPUT;
+      RenderGraph::Pass compositePass = renderGraph.addPass("Transparency composite",
+                                                            [&, color, accumulation, revealage](void) {
+        compositeTextures[0].id = renderGraph.getTexture(color);
+        compositeTextures[1].id = renderGraph.getTexture(accumulation);
+        compositeTextures[2].id = renderGraph.getTexture(revealage);
+        GLState::setDepthTest(false);
+        compositeProgram->use();
+        Mesh::bindTextures(*compositeProgram, compositeTextures);
+        screenQuad.draw(*compositeProgram);
+        GLState::setDepthTest(true);
+      });
+      renderGraph.read(compositePass, color);
+      renderGraph.read(compositePass, accumulation);
+      renderGraph.read(compositePass, revealage);
+      renderGraph.write(compositePass, composited, GL_COLOR_ATTACHMENT0);
+      color = composited;
+    }
+
+    if (postEffectProgram) {
+      RenderGraph::Pass postEffectPass = renderGraph.addPass("Post effect", [&, color](void) {
+        screenTextures[0].id = renderGraph.getTexture(color);
+        GLState::setDepthTest(false);
+        postEffectProgram->use();
+        Mesh::bindTextures(*postEffectProgram, screenTextures);
+        screenQuad.draw(*postEffectProgram);
+        GLState::setDepthTest(true);
+      });
+      renderGraph.read(postEffectPass, color);
+      renderGraph.write(postEffectPass, RenderGraph::OUTPUT, GL_NONE);
+    }
+  } else {
+    renderGraph.write(scenePass, RenderGraph::OUTPUT, GL_NONE);
+  }
+  GLuint outputFramebuffer = headlessContext ? headlessContext->getFramebuffer() : 0;
 
-    glm::mat4 projectionMatrix = camera.getProjectionMatrix(
-      static_cast<float>(windowWidth) / windowHeight, 0.1f, 100.0f);
+  /* Camera data every program reads, uploaded once per frame. */
+  std::unique_ptr<UniformBuffer> frameDataBuffer = UniformBuffer::create(FRAME_DATA_BINDING, sizeof(FrameData));
+
+  /* World-space bounds of everything the frustum can cull. The skybox is
+   * always visible. */
+  enum SceneObject : uint32_t {
+    SCENE_CUBE,
+    SCENE_GRASS,
+    SCENE_WINDOWS,
+  };
+  BoundingBoxList sceneBounds;
+  sceneBounds.add(cubeBounds);
+  sceneBounds.add(grassBounds);
+  if (options.windows > 0) {
+    sceneBounds.add(windowBounds);
+  }
+  std::vector<uint32_t> visibleObjects;
+
+  auto renderFrame = [&](float currentFrame) {
+    ProfileScope profileScope("Frame");
+
+    /* Finish any textures whose images were decoded in the background. */
+    TextureLoader::processUploads();
+
+    constexpr float NEAR_PLANE = 0.1f;
+    constexpr float FAR_PLANE = 100.0f;
+    float aspect = static_cast<float>(windowWidth) / windowHeight;
+    glm::mat4 projectionMatrix = camera.getProjectionMatrix(aspect, NEAR_PLANE, FAR_PLANE);
     glm::mat4 viewMatrix = camera.getViewMatrix();
 
-    shaderProgram->use();
-    shaderProgram->uniform("projectionMatrix", projectionMatrix);
-    shaderProgram->uniform("viewMatrix", viewMatrix);
-    shaderProgram->uniform("modelMatrix", glm::mat4(1.0f));
-    cube.draw(*shaderProgram);
+    FrameData frameData;
+    frameData.viewMatrix = viewMatrix;
+    frameData.projectionMatrix = projectionMatrix;
+    frameData.viewProjectionMatrix = projectionMatrix * viewMatrix;
+    frameData.cameraPosition = camera.getPosition();
+    frameData.time = currentFrame;
+    frameDataBuffer->update(&frameData, sizeof frameData);
+
+    if (lightGrid) {
+      for (size_t i = 0; i < lights.size(); ++i) {
+        const LightOrbit& orbit = lightOrbits[i];
+        float angle = orbit.phase + orbit.speed * currentFrame;
+        lights[i].position = orbit.center + orbit.radius * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+      }
+      lightGrid->assign(lights, viewMatrix, projectionMatrix, NEAR_PLANE, FAR_PLANE);
+      lightGrid->upload(lights, windowWidth, windowHeight);
+    }
 
+    visibleObjects.clear();
+    FrustumCuller::cull(Frustum::fromMatrix(frameData.viewProjectionMatrix), sceneBounds, visibleObjects);
+
+    renderQueue.clear();
+    transparentQueue.clear();
+    for (uint32_t object : visibleObjects) {
+      if (object == SCENE_CUBE) {
+        renderQueue.push(RenderLayer::SOLID, *shaderProgram, cube, &cubeModelMatrix,
+                         RenderQueue::viewDepth(viewMatrix, glm::vec3(cubeModelMatrix[3])));
+      } else if (object == SCENE_GRASS) {
+        /* Grass is alpha-tested rather than blended, so it can go with the
+         * solid geometry. */
+        renderQueue.push({ RenderLayer::SOLID, grassShaderProgram.get(), grassTexture.getID(), 0.0f, nullptr,
+                           [](const void* object, const ShaderProgram& program) {
+                             static_cast<const Mesh*>(object)->drawInstanced(program);
+                           },
+                           &grass });
+      } else if (object == SCENE_WINDOWS && weightedWindows) {
+        transparentQueue.push({ RenderLayer::ACCUMULATE, windowProgram, windowTexture.getID(), 0.0f, nullptr,
+                                [](const void* object, const ShaderProgram& program) {
+                                  static_cast<const Mesh*>(object)->drawInstanced(program);
+                                },
+                                &windowMesh });
+      } else if (object == SCENE_WINDOWS) {
+        /* Instances of one draw are blended in the order they come in. */
+        transparentWindows.sort(viewMatrix);
+        windowMesh.setInstances(transparentWindows.getInstances());
+        renderQueue.push({ RenderLayer::TRANSLUCENT, windowProgram, windowTexture.getID(),
+                           RenderQueue::viewDepth(viewMatrix, 0.5f * (windowBounds.min + windowBounds.max)), nullptr,
+                           [](const void* object, const ShaderProgram& program) {
+                             static_cast<const Mesh*>(object)->drawInstanced(program);
+                           },
+                           &windowMesh });
+      }
+    }
     /* So to give us a slight performance boost we're going to render the skybox
-     * last. This way, the depth buffer is completely filled with all the
-     * scene's depth values so we only have to render the skybox's fragments
-     * wherever the early depth test passes, greatly reducing the number of
-     * fragment shader calls. */
-    skyboxShaderProgram->use();
-    skyboxShaderProgram->uniform("projectionMatrix", projectionMatrix);
-    skyboxShaderProgram->uniform("viewMatrix", viewMatrix);
-    /* We do have to change the depth function a little by setting it to
-     * `GL_LEQUAL` instead of the default `GL_LESS`. The depth buffer will be
-     * filled with values of 1.0 for the skybox, so we need to make sure the
-     * skybox passes the depth tests with values *less than or equal* to the
-     * depth buffer instead of *less than*. */
-    glDepthFunc(GL_LEQUAL);
-    skybox.draw(*skyboxShaderProgram);
-    glDepthFunc(GL_LESS);
+     * after the solid geometry. This way, the depth buffer is completely filled
+     * with all the scene's depth values so we only have to render the skybox's
+     * fragments wherever the early depth test passes, greatly reducing the
+     * number of fragment shader calls. Its layer changes the depth function to
+     * `GL_LEQUAL`, since the skybox sits at the far plane. */
+    renderQueue.push(RenderLayer::SKYBOX, *skyboxShaderProgram, skybox, nullptr, 0.0f);
+    renderQueue.sort();
+    transparentQueue.sort();
+
+    if (shadowMap) {
+      shadowMap->render(camera, aspect, NEAR_PLANE, FAR_PLANE);
+    }
+    renderGraph.setOutput(outputFramebuffer, windowWidth, windowHeight);
+    renderGraph.execute();
+
+    GLState::endFrame();
+    FrustumCuller::endFrame();
+    Profiler::endFrame();
+  };
+
+  if (options.headless) {
+    /* Deterministic: every texture is in place before the first frame, and
+     * frames advance a fixed step along the path regardless of how long they
+     * take. */
+    constexpr float FRAME_STEP = 1.0f / 60.0f;
+    TextureLoader::finishUploads();
+    CameraPath path = CameraPath::orbit(glm::vec3(0.0f), 4.0f, 1.0f, options.frames * FRAME_STEP);
+
+    FrameBenchmark benchmark;
+    for (int frame = -options.warmupFrames; frame < options.frames; ++frame) {
+      float time = std::max(frame, 0) * FRAME_STEP;
+      path.apply(time, camera);
+      if (frame == 0) {
+        benchmark.reset();
+      }
+      benchmark.beginFrame();
+      renderFrame(time);
+      const GLState::Statistics& statistics = GLState::getFrameStatistics();
+      benchmark.endFrame(statistics.draws, statistics.triangles);
+      if (lightGrid) {
+        benchmark.record("lightAssignmentMs", lightGrid->getStatistics().assignmentTime);
+        benchmark.record("lightIndices", static_cast<double>(lightGrid->getStatistics().lightIndices));
+      }
+      if (shadowMap) {
+        const CascadedShadowMap::Statistics& shadows = shadowMap->getStatistics();
+        benchmark.record("shadowCascadesRendered", static_cast<double>(shadows.renderedCascades));
+        benchmark.record("shadowDraws", static_cast<double>(shadows.draws));
+        benchmark.record("shadowCpuMs", shadows.cpuTime);
+        benchmark.record("shadowGpuMs", shadows.gpuTime);
+      }
+      if (options.windows > 0 && !weightedWindows) {
+        const TransparentInstances::Statistics& transparency = transparentWindows.getStatistics();
+        benchmark.record("transparencySortMs", transparency.sortTime);
+        benchmark.record("transparencyFullSorts", transparency.fullSort ? 1.0 : 0.0);
+      }
+    }
+    benchmark.finish();
+
+    const GLchar* renderer = (const GLchar*)glGetString(GL_RENDERER);
+    std::ofstream output(options.outputPath);
+    benchmark.writeJson(output, renderer ? renderer : "unknown", options.width, options.height);
+    output.close();
+    bool written = static_cast<bool>(output);
+    if (written) {
+      std::cout << "Wrote frame statistics to " << options.outputPath << std::endl;
+    } else {
+      std::cerr << "Failed to write frame statistics: " << options.outputPath << std::endl;
+    }
+
+    writeProfile(options);
+    TextureLoader::shutdown();
+    return written ? 0 : -1;
+  }
+
+  while (!glfwWindowShouldClose(window)) {
+    float currentFrame = static_cast<float>(glfwGetTime());
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+
+    processInput(window);
+    renderFrame(currentFrame);
+    updateWindowTitle(window, currentFrame);
 
     glfwSwapBuffers(window);
     /* The `glfwPollEvents` function checks if any events are triggered,
@@ -345,7 +897,8 @@ int main(void) {
     glfwPollEvents();
   }
 
-  glDeleteTextures(1, &cubemapTextureID);
+  writeProfile(options);
+  TextureLoader::shutdown();
 
   glfwTerminate();
 
@@ -0,0 +1,144 @@
+/* Offline texture cooker: compresses images into block-compressed `.ctex`
+ * files with a full mip chain, which `TextureLoader` picks up instead of the
+ * source image.
+ *
+ * Usage: texture_cooker [--format bc1|bc3|bc4|bc5] <image>...
+ *
+ * Without `--format`, the format follows the image's channel count: BC4 for
+ * one channel, BC1 for three, and BC3 for two or four, since grey with alpha
+ * is loaded as RGBA and needs its alpha kept. */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "BlockCompression.h"
+#include "CookedTexture.h"
+
+/* 2x2 box filter. Odd dimensions repeat the last row/column. */
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height) {
+  uint32_t nextWidth = std::max(width / 2, 1u);
+  uint32_t nextHeight = std::max(height / 2, 1u);
+  std::vector<unsigned char> result(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+  for (uint32_t y = 0; y < nextHeight; ++y) {
+    uint32_t y0 = std::min(y * 2, height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, height - 1);
+    for (uint32_t x = 0; x < nextWidth; ++x) {
+      uint32_t x0 = std::min(x * 2, width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, width - 1);
+      for (uint32_t c = 0; c < 4; ++c) {
+        unsigned int sum = rgba[(static_cast<size_t>(y0) * width + x0) * 4 + c]
+                         + rgba[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                         + rgba[(static_cast<size_t>(y1) * width + x0) * 4 + c]
+                         + rgba[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+        result[(static_cast<size_t>(y) * nextWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+      }
+    }
+  }
+
+  return result;
+}
+
+static bool parseFormat(const char* name, BlockFormat& outFormat) {
+  static const std::pair<const char*, BlockFormat> formats[] = {
+    { "bc1", BlockFormat::BC1 },
+    { "bc3", BlockFormat::BC3 },
+    { "bc4", BlockFormat::BC4 },
+    { "bc5", BlockFormat::BC5 },
+  };
+  for (const auto& pair : formats) {
+    if (std::strcmp(name, pair.first) == 0) {
+      outFormat = pair.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool cook(const std::string& path, const BlockFormat* requestedFormat) {
+  /* Match the orientation `TextureLoader` uploads uncompressed images in. */
+  stbi_set_flip_vertically_on_load_thread(true);
+
+  int width, height, nrChannels;
+  stbi_uc* image = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
+  if (image == NULL) {
+    std::cerr << "Failed to load image: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+    return false;
+  }
+
+  BlockFormat format;
+  if (requestedFormat != nullptr) {
+    format = *requestedFormat;
+  } else if (nrChannels == 1) {
+    format = BlockFormat::BC4;
+  } else if (nrChannels == 3) {
+    format = BlockFormat::BC1;
+  } else {
+    format = BlockFormat::BC3;
+  }
+
+  std::vector<unsigned char> level(image, image + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(image);
+
+  std::vector<std::vector<unsigned char>> levels;
+  uint32_t levelWidth = static_cast<uint32_t>(width);
+  uint32_t levelHeight = static_cast<uint32_t>(height);
+  size_t compressedSize = 0;
+  for (;;) {
+    levels.push_back(compressImage(level.data(), levelWidth, levelHeight, format));
+    compressedSize += levels.back().size();
+    if (levelWidth == 1 && levelHeight == 1) {
+      break;
+    }
+    level = downsample(level, levelWidth, levelHeight);
+    levelWidth = std::max(levelWidth / 2, 1u);
+    levelHeight = std::max(levelHeight / 2, 1u);
+  }
+
+  std::string cookedPath = CookedTexture::pathFor(path);
+  if (!CookedTexture::write(cookedPath, format, static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels)) {
+    std::cerr << "Failed to write cooked texture: " << cookedPath << std::endl;
+    return false;
+  }
+
+  std::cout << path << ": " << width << "x" << height << ", " << blockFormatName(format) << ", "
+            << levels.size() << " levels, " << compressedSize << " bytes" << std::endl;
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  BlockFormat format;
+  const BlockFormat* requestedFormat = nullptr;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (!parseFormat(argv[++i], format)) {
+        std::cerr << "Unknown format: " << argv[i] << std::endl;
+        return 1;
+      }
+      requestedFormat = &format;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+
+  if (paths.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--format bc1|bc3|bc4|bc5] <image>..." << std::endl;
+    return 1;
+  }
+
+  int failures = 0;
+  for (const auto& path : paths) {
+    if (!cook(path, requestedFormat)) {
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}